@@ -10,6 +10,8 @@
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 /******************************************************************************
@@ -30,6 +32,33 @@ enum {FLIP_NONE, FLIP_FLIP};
 * Helper functions
 ******************************************************************************/
 int binom(int n, int k);
+int inverse_move(int move);
+
+/******************************************************************************
+* Packed representation of a complete cube state, used as a hash key
+******************************************************************************/
+struct CubeKey
+{
+    uint64_t corners;
+    uint64_t edges;
+};
+
+bool operator==(const CubeKey& key_1, const CubeKey& key_2);
+bool operator<(const CubeKey& key_1, const CubeKey& key_2);
+
+struct CubeKeyHash
+{
+    size_t operator()(const CubeKey& key) const;
+};
+
+/******************************************************************************
+* The coordinates of a cube position which the solver starts from
+******************************************************************************/
+struct CubeCoords
+{
+    int co, eo, cp;
+    int ud_sorted, rl_sorted, fb_sorted;
+};
 
 /******************************************************************************
 * Cube class declarations
@@ -47,6 +76,9 @@ public:
     Cube(std::vector<int> corner_perm, std::vector<int> corner_orient,
          std::vector<int> edge_perm,   std::vector<int> edge_orient);
     Cube perform_move(int move);
+    Cube multiply(Cube other);
+    Cube inverse();
+    CubeKey key();
     int coord_corner_orientation();
     int coord_edge_orientation();
     int coord_corner_permutation();
@@ -59,6 +91,7 @@ public:
     int coord_edge_permutation();
     int coord_ud_unsorted();
     int coord_ud_permutation();
+    CubeCoords coords();
 };
 
 #endif
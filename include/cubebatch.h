@@ -0,0 +1,77 @@
+#ifndef CUBEBATCH_INCLUDED
+#define CUBEBATCH_INCLUDED
+
+/******************************************************************************
+* Header:  cubebatch.h
+*
+* Purpose: Declaration of the CubeBatch class, which solves many cubes at
+*          once by searching phase 1 for several of them in lockstep.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <vector>
+
+#include <cube.h>
+#include <cubesolver.h>
+#include <cubewalker.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define CUBE_BATCH_LANES 8
+
+/******************************************************************************
+* CubeBatch class declaration
+******************************************************************************/
+class CubeBatch
+{
+private:
+    int target_length;
+    int next_cube;
+    uint64_t num_phase1_nodes;
+    uint64_t num_phase2_nodes;
+    std::vector<std::vector<int>> results;
+    CubeCancel cancel_token;
+
+    // The state of each lane. Each lane's walker holds the stack of its
+    // phase 1 search, and its solver searches phase 2 and keeps the best
+    // solution.
+    CubeSolver lane_solver[CUBE_BATCH_LANES];
+    CubeWalker lane_walker[CUBE_BATCH_LANES];
+    int lane_cube[CUBE_BATCH_LANES];
+
+    // The position which each lane will expand next.
+    int node_co[CUBE_BATCH_LANES];
+    int node_eo[CUBE_BATCH_LANES];
+    int node_ud_pos[CUBE_BATCH_LANES];
+    int node_state[CUBE_BATCH_LANES];
+
+    // The children of the positions being expanded, for all lanes together.
+    int child_lane[CUBE_BATCH_LANES * NUM_MOVES];
+    int child_move[CUBE_BATCH_LANES * NUM_MOVES];
+    int parent_co[CUBE_BATCH_LANES * NUM_MOVES];
+    int parent_eo[CUBE_BATCH_LANES * NUM_MOVES];
+    int parent_ud_pos[CUBE_BATCH_LANES * NUM_MOVES];
+    int child_co[CUBE_BATCH_LANES * NUM_MOVES];
+    int child_eo[CUBE_BATCH_LANES * NUM_MOVES];
+    int child_ud_pos[CUBE_BATCH_LANES * NUM_MOVES];
+    int co_eo_bound[CUBE_BATCH_LANES * NUM_MOVES];
+    int co_ud_bound[CUBE_BATCH_LANES * NUM_MOVES];
+    int eo_ud_bound[CUBE_BATCH_LANES * NUM_MOVES];
+
+    void start_lane(int lane, std::vector<Cube>& cubes);
+    void finish_lane(int lane, std::vector<Cube>& cubes);
+    bool next_node(int lane, std::vector<Cube>& cubes);
+public:
+    CubeBatch();
+    void set_target_length(int length);
+    void set_cancel(const CubeCancel& token);
+    std::vector<std::vector<int>> solve(std::vector<Cube>& cubes);
+    uint64_t phase1_nodes();
+    uint64_t phase2_nodes();
+};
+
+#endif
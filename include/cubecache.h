@@ -0,0 +1,54 @@
+#ifndef CUBECACHE_INCLUDED
+#define CUBECACHE_INCLUDED
+
+/******************************************************************************
+* Header:  cubecache.h
+*
+* Purpose: Declaration of the CubeCache class, a bounded cache of solutions
+*          which sits in front of the CubeSolver.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cube.h>
+
+/******************************************************************************
+* CubeCache class declaration
+******************************************************************************/
+class CubeCache
+{
+private:
+    typedef std::list<std::pair<CubeKey, std::vector<int>>> EntryList;
+
+    struct Shard
+    {
+        std::mutex lock;
+        EntryList entries;
+        std::unordered_map<CubeKey, EntryList::iterator, CubeKeyHash> index;
+    };
+
+    int shard_capacity;
+    int target_length;
+    std::vector<Shard> shards;
+    std::atomic<uint64_t> num_hits;
+    std::atomic<uint64_t> num_misses;
+
+    bool lookup(Shard& shard, CubeKey key, std::vector<int>& solution);
+    void insert(Shard& shard, CubeKey key, std::vector<int>& solution);
+public:
+    CubeCache(int capacity, int num_shards, int target_len);
+    std::vector<int> solve(Cube cube);
+    uint64_t hits();
+    uint64_t misses();
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef CUBECOORD_INCLUDED
+#define CUBECOORD_INCLUDED
+
+/******************************************************************************
+* Header:  cubecoord.h
+*
+* Purpose: Definitions of the coordinates of the cube which have transition
+*          tables. Each coordinate is a type with the number of values it
+*          takes, the type used to store one of those values, and a function
+*          which works out its value for a cube, so that the tables built
+*          from it are specialised for it at compile time.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <type_traits>
+
+#include <cube.h>
+
+/******************************************************************************
+* Storage type for the values of a coordinate
+*
+* The smallest unsigned type which can hold every value from 0 to range - 1.
+******************************************************************************/
+template <int Range>
+struct CubeStorage
+{
+    typedef typename std::conditional<(Range <= 256), uint8_t,
+            typename std::conditional<(Range <= 65536), uint16_t,
+                                      uint32_t>::type>::type type;
+};
+
+/******************************************************************************
+* Macro to define a coordinate type
+******************************************************************************/
+#define CUBE_COORD(name, func, num_values)                                    \
+    struct name                                                               \
+    {                                                                         \
+        static constexpr int range = num_values;                              \
+        typedef CubeStorage<num_values>::type storage;                        \
+        static int value(Cube& cube) { return cube.func(); }                  \
+    }
+
+/******************************************************************************
+* Coordinate definitions
+******************************************************************************/
+CUBE_COORD(CubeCoordCO, coord_corner_orientation, 2187);
+CUBE_COORD(CubeCoordEO, coord_edge_orientation, 2048);
+CUBE_COORD(CubeCoordCP, coord_corner_permutation, 40320);
+CUBE_COORD(CubeCoordUDSorted, coord_ud_sorted, 11880);
+CUBE_COORD(CubeCoordRLSorted, coord_rl_sorted, 11880);
+CUBE_COORD(CubeCoordFBSorted, coord_fb_sorted, 11880);
+CUBE_COORD(CubeCoordEP, coord_edge_permutation, 40320);
+CUBE_COORD(CubeCoordUDUnsorted, coord_ud_unsorted, 495);
+CUBE_COORD(CubeCoordUDPerm, coord_ud_permutation, 24);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CUBEENDGAME_INCLUDED
+#define CUBEENDGAME_INCLUDED
+
+/******************************************************************************
+* Header:  cubeendgame.h
+*
+* Purpose: Declaration of the CubeEndgame class.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <cubememory.h>
+
+/******************************************************************************
+* CubeEndgame class declaration.
+******************************************************************************/
+class CubeEndgame
+{
+private:
+    std::vector<uint64_t, CubeAllocator<uint64_t>> table;
+    size_t num_entries;
+    int max_depth;
+
+    size_t find_slot(uint64_t key);
+    void grow();
+public:
+    CubeEndgame();
+    int depth();
+    size_t size();
+    size_t bytes();
+    static size_t fill_bytes(int depth_limit);
+    void placement(std::vector<size_t>& node_bytes);
+    int operator()(int cp, int ep, int ud_perm);
+    int fill(int depth_limit, size_t budget_bytes);
+};
+
+#endif
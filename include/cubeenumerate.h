@@ -0,0 +1,55 @@
+#ifndef CUBEENUMERATE_INCLUDED
+#define CUBEENUMERATE_INCLUDED
+
+/******************************************************************************
+* Header:  cubeenumerate.h
+*
+* Purpose: Declaration of the CubeEnumerator class, which finds every
+*          solution of a given length to a cube, using a pool of threads
+*          which share out the phase 1 search between them.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <cube.h>
+#include <cubesolver.h>
+
+/******************************************************************************
+* CubeEnumerator class declaration
+******************************************************************************/
+class CubeEnumerator
+{
+private:
+    Cube cube;
+    int num_threads;
+    size_t max_solutions;
+    int length;
+
+    std::atomic<int> next_item;
+    std::atomic<uint64_t> num_phase1_nodes;
+    std::atomic<uint64_t> num_phase2_nodes;
+    CubeCancel cancel;
+    std::mutex found_lock;
+    size_t num_found;
+    std::function<void(std::vector<int>&)> process_sol;
+
+    void record_sol(std::vector<int>& solution);
+    void search(int id);
+public:
+    CubeEnumerator(Cube scrambled_cube, int threads);
+    void set_max_solutions(size_t count);
+    size_t enumerate(int solution_length,
+                     std::function<void(std::vector<int>&)> callback);
+    uint64_t phase1_nodes();
+    uint64_t phase2_nodes();
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef CUBEMEMORY_INCLUDED
+#define CUBEMEMORY_INCLUDED
+
+/******************************************************************************
+* Header:  cubememory.h
+*
+* Purpose: Allocation of memory for the tables.
+*
+*          Large tables are mapped on 2MB huge pages where the system has any
+*          to spare, and are otherwise advised to the kernel as candidates
+*          for transparent huge pages, so that the random lookups made by the
+*          searches miss in the TLB less often. On hosts with more than one
+*          NUMA node, the tables can either be interleaved across the nodes
+*          or copied onto every node, with each thread of a pool reading the
+*          copy on its own node.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/******************************************************************************
+* Constants
+*
+* Ways of placing the tables on the NUMA nodes of the host. With
+* CUBE_NUMA_LOCAL, each page is placed on the node of the thread which first
+* writes it, which is the default behaviour of the kernel.
+******************************************************************************/
+#define CUBE_NUMA_LOCAL      0
+#define CUBE_NUMA_INTERLEAVE 1
+#define CUBE_NUMA_REPLICATE  2
+
+#define CUBE_MAX_NUMA_NODES  64
+#define CUBE_HUGE_PAGE_SIZE  ((size_t)2 << 20)
+
+/******************************************************************************
+* The NUMA node whose copies of the tables this thread reads
+******************************************************************************/
+extern __thread int cube_numa_node;
+
+/******************************************************************************
+* Memory placement functions
+******************************************************************************/
+void cube_set_memory_policy(bool huge_pages, int numa_policy);
+int cube_numa_policy();
+int cube_numa_nodes();
+int cube_numa_bind_thread(int index);
+void* cube_allocate(size_t bytes, int node);
+void cube_deallocate(void* data, size_t bytes);
+void cube_memory_placement(const void* data, size_t bytes,
+                           std::vector<size_t>& node_bytes);
+size_t cube_hugetlb_bytes();
+size_t cube_advised_bytes();
+
+/******************************************************************************
+* CubeAllocator class template
+*
+* An allocator for standard containers which takes its memory from
+* cube_allocate, either under the NUMA policy or bound to one node.
+******************************************************************************/
+template <class T>
+struct CubeAllocator
+{
+    typedef T value_type;
+
+    int node;
+
+    CubeAllocator(int bind_node = -1) : node(bind_node) {}
+
+    template <class U>
+    CubeAllocator(const CubeAllocator<U>& other) : node(other.node) {}
+
+    T* allocate(size_t count)
+    {
+        void* data = cube_allocate(count * sizeof(T), node);
+        if (data == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return (T*)data;
+    }
+
+    void deallocate(T* data, size_t count)
+    {
+        cube_deallocate(data, count * sizeof(T));
+    }
+};
+
+template <class T, class U>
+bool operator==(const CubeAllocator<T>& lhs, const CubeAllocator<U>& rhs)
+{
+    return lhs.node == rhs.node;
+}
+
+template <class T, class U>
+bool operator!=(const CubeAllocator<T>& lhs, const CubeAllocator<U>& rhs)
+{
+    return lhs.node != rhs.node;
+}
+
+/******************************************************************************
+* CubeReplicated class template declaration
+*
+* The entries of a table, with a copy on each NUMA node when the tables are
+* replicated. Indexing reads the copy on the node of the calling thread.
+******************************************************************************/
+template <class T>
+class CubeReplicated
+{
+private:
+    typedef std::vector<T, CubeAllocator<T>> Copy;
+
+    std::vector<Copy> copies;
+    T* node_data[CUBE_MAX_NUMA_NODES];
+public:
+    CubeReplicated();
+    T& operator[](size_t index);
+    T* data();
+    bool empty();
+    size_t bytes();
+    void assign(size_t count, const T& value);
+    void replicate();
+    void placement(std::vector<size_t>& node_bytes);
+};
+
+/******************************************************************************
+* Inline CubeReplicated member definitions
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeReplicated::operator[]
+*
+* Purpose:   Returns an entry of the table.
+*
+* Params:    index - The index of the entry.
+*
+* Returns:   A reference to the entry in the copy read by this thread.
+*
+* Operation: Indexes the copy for the node of the thread. Before the table is
+*            replicated, every node is given the primary copy, so writes made
+*            while filling the table go to it.
+******************************************************************************/
+template <class T>
+inline T& CubeReplicated<T>::operator[](size_t index)
+{
+    return node_data[cube_numa_node][index];
+}
+
+/******************************************************************************
+* Function:  CubeReplicated::data
+*
+* Purpose:   Returns the start of the table.
+*
+* Params:    None.
+*
+* Returns:   A pointer to the first entry of the copy read by this thread.
+*
+* Operation: Simply return the pointer for the node of the thread.
+******************************************************************************/
+template <class T>
+inline T* CubeReplicated<T>::data()
+{
+    return node_data[cube_numa_node];
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CUBENEAR_INCLUDED
+#define CUBENEAR_INCLUDED
+
+/******************************************************************************
+* Header:  cubenear.h
+*
+* Purpose: Declaration of the CubeNear class.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <cubememory.h>
+
+/******************************************************************************
+* CubeNear class declaration.
+******************************************************************************/
+class CubeNear
+{
+private:
+    struct Entry
+    {
+        uint64_t lo;
+        uint32_t hi;
+        uint8_t move;
+        uint8_t depth;
+    };
+
+    std::vector<Entry, CubeAllocator<Entry>> table;
+    size_t num_entries;
+    int max_depth;
+
+    static void pack(int co, int eo, int cp,
+                     int ud_sorted, int rl_sorted, int fb_sorted,
+                     uint64_t& lo, uint32_t& hi);
+    size_t find_slot(uint64_t lo, uint32_t hi);
+    void grow();
+public:
+    CubeNear();
+    int depth();
+    size_t size();
+    size_t bytes();
+    static size_t fill_bytes(int depth_limit);
+    void placement(std::vector<size_t>& node_bytes);
+    int lookup(int co, int eo, int cp,
+               int ud_sorted, int rl_sorted, int fb_sorted, int& move);
+    bool path_to_solved(int co, int eo, int cp,
+                        int ud_sorted, int rl_sorted, int fb_sorted,
+                        std::vector<int>& moves);
+    int fill(int depth_limit, size_t budget_bytes);
+};
+
+#endif
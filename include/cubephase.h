@@ -4,32 +4,156 @@
 /******************************************************************************
 * Header:  cubephase.h
 *
-* Purpose: Declarations of constants which determine the moves allowed in each
+* Purpose: Definitions of constants which determine the moves allowed in each
 *          phase of the two-phase algorithm.
+*
+*          A set of moves is held as a mask with bit n set if move n is in the
+*          set, so membership is a single AND and the moves in a set are
+*          visited by repeatedly taking the lowest set bit.
+*
+*          Also declares the CubeAutomaton class, a finite automaton over
+*          sequences of moves which the searches walk in order to find the
+*          moves allowed next.
 ******************************************************************************/
 
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
+#include <cstdint>
 #include <vector>
 
+#include <cube.h>
+
 /******************************************************************************
 * Constants
 ******************************************************************************/
 #define PHASE_1 1
 #define PHASE_2 2
 
+#define CUBE_MOVE_BIT(move) (1u << (move))
+#define CUBE_FACE_U         (7u << MOVE_U)
+#define CUBE_FACE_L         (7u << MOVE_L)
+#define CUBE_FACE_F         (7u << MOVE_F)
+#define CUBE_FACE_R         (7u << MOVE_R)
+#define CUBE_FACE_B         (7u << MOVE_B)
+#define CUBE_FACE_D         (7u << MOVE_D)
+#define CUBE_P1_MOVES       ((1u << NUM_MOVES) - 1)
+#define CUBE_P2_MOVES       (CUBE_FACE_U | CUBE_FACE_D |                      \
+                             CUBE_MOVE_BIT(MOVE_L2) | CUBE_MOVE_BIT(MOVE_F2) | \
+                             CUBE_MOVE_BIT(MOVE_R2) | CUBE_MOVE_BIT(MOVE_B2))
+
+/******************************************************************************
+* Allowed moves constant definitions
+*
+* Entry n of each table is the set of moves which may follow move n, and entry
+* NUM_MOVES is the set of moves which may start a sequence. No face can be
+* turned twice in a row, and, since RL = LR, FB = BF, UD = DU, we do not allow
+* a turn of the R face to follow a turn of the L face, or a turn of the F face
+* to follow a turn of the B face, or a turn of the U face to follow a turn of
+* the D face. In phase 1, any move is allowed, and in phase 2, only the turns
+* of U and D and the half turns of R, L, F, B are allowed.
+******************************************************************************/
+constexpr uint32_t cube_p1_allowed_moves[NUM_MOVES + 1] =
+{
+    CUBE_P1_MOVES & ~CUBE_FACE_U,
+    CUBE_P1_MOVES & ~CUBE_FACE_U,
+    CUBE_P1_MOVES & ~CUBE_FACE_U,
+    CUBE_P1_MOVES & ~CUBE_FACE_L & ~CUBE_FACE_R,
+    CUBE_P1_MOVES & ~CUBE_FACE_L & ~CUBE_FACE_R,
+    CUBE_P1_MOVES & ~CUBE_FACE_L & ~CUBE_FACE_R,
+    CUBE_P1_MOVES & ~CUBE_FACE_F,
+    CUBE_P1_MOVES & ~CUBE_FACE_F,
+    CUBE_P1_MOVES & ~CUBE_FACE_F,
+    CUBE_P1_MOVES & ~CUBE_FACE_R,
+    CUBE_P1_MOVES & ~CUBE_FACE_R,
+    CUBE_P1_MOVES & ~CUBE_FACE_R,
+    CUBE_P1_MOVES & ~CUBE_FACE_B & ~CUBE_FACE_F,
+    CUBE_P1_MOVES & ~CUBE_FACE_B & ~CUBE_FACE_F,
+    CUBE_P1_MOVES & ~CUBE_FACE_B & ~CUBE_FACE_F,
+    CUBE_P1_MOVES & ~CUBE_FACE_D & ~CUBE_FACE_U,
+    CUBE_P1_MOVES & ~CUBE_FACE_D & ~CUBE_FACE_U,
+    CUBE_P1_MOVES & ~CUBE_FACE_D & ~CUBE_FACE_U,
+    CUBE_P1_MOVES
+};
+
+constexpr uint32_t cube_p2_allowed_moves[NUM_MOVES + 1] =
+{
+    CUBE_P2_MOVES & ~CUBE_FACE_U,
+    CUBE_P2_MOVES & ~CUBE_FACE_U,
+    CUBE_P2_MOVES & ~CUBE_FACE_U,
+    CUBE_P2_MOVES & ~CUBE_FACE_L & ~CUBE_FACE_R,
+    CUBE_P2_MOVES & ~CUBE_FACE_L & ~CUBE_FACE_R,
+    CUBE_P2_MOVES & ~CUBE_FACE_L & ~CUBE_FACE_R,
+    CUBE_P2_MOVES & ~CUBE_FACE_F,
+    CUBE_P2_MOVES & ~CUBE_FACE_F,
+    CUBE_P2_MOVES & ~CUBE_FACE_F,
+    CUBE_P2_MOVES & ~CUBE_FACE_R,
+    CUBE_P2_MOVES & ~CUBE_FACE_R,
+    CUBE_P2_MOVES & ~CUBE_FACE_R,
+    CUBE_P2_MOVES & ~CUBE_FACE_B & ~CUBE_FACE_F,
+    CUBE_P2_MOVES & ~CUBE_FACE_B & ~CUBE_FACE_F,
+    CUBE_P2_MOVES & ~CUBE_FACE_B & ~CUBE_FACE_F,
+    CUBE_P2_MOVES & ~CUBE_FACE_D & ~CUBE_FACE_U,
+    CUBE_P2_MOVES & ~CUBE_FACE_D & ~CUBE_FACE_U,
+    CUBE_P2_MOVES & ~CUBE_FACE_D & ~CUBE_FACE_U,
+    CUBE_P2_MOVES
+};
+
+/******************************************************************************
+* Function:  cube_next_move
+*
+* Purpose:   Takes the next move out of a set of moves.
+*
+* Params:    moves - The set of moves, which must not be empty. The move
+*                    returned is removed from it.
+*
+* Returns:   The lowest numbered move in the set.
+*
+* Operation: Counts the trailing zeros of the mask and then clears the lowest
+*            set bit.
+******************************************************************************/
+inline int cube_next_move(uint32_t& moves)
+{
+    int move = __builtin_ctz(moves);
+    moves &= moves - 1;
+    return move;
+}
+
+/******************************************************************************
+* CubeAutomaton class declaration
+*
+* Each state of the automaton has its own set of moves allowed next, and the
+* state after each of those moves. The automaton starts out equivalent to the
+* allowed moves constants above, with one state for each last move, and can
+* then be generated again to also forbid longer redundant sequences.
+******************************************************************************/
+class CubeAutomaton
+{
+private:
+    int phase;
+    std::vector<uint32_t> state_moves;
+    std::vector<int> transitions;
+
+    std::vector<int> letters();
+    uint64_t encode(std::vector<int>& word);
+public:
+    CubeAutomaton(int phase_desc);
+    int start();
+    int size();
+    uint32_t moves(int state);
+    int next(int state, int move);
+    void generate(int depth);
+};
+
 /******************************************************************************
-* Allowed moves constant declarations
+* Automata for the two phases
 ******************************************************************************/
-extern std::vector<std::vector<int>> cube_p1_allowed_moves;
-extern std::vector<std::vector<int>> cube_p2_allowed_moves;
+extern CubeAutomaton cube_p1_automaton;
+extern CubeAutomaton cube_p2_automaton;
 
 /******************************************************************************
-* Functions which populate the above vectors with the actual allowed moves
+* Function to generate the above automata
 ******************************************************************************/
-void cube_create_p1_allowed_moves();
-void cube_create_p2_allowed_moves();
-void cube_create_allowed_moves();
+void cube_create_automata(int p1_depth, int p2_depth);
 
 #endif
@@ -0,0 +1,108 @@
+#ifndef CUBEPIPELINE_INCLUDED
+#define CUBEPIPELINE_INCLUDED
+
+/******************************************************************************
+* Header:  cubepipeline.h
+*
+* Purpose: Declaration of the CubePipeline class, which solves a cube with
+*          separate pools of threads for the two phases of the search.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <cube.h>
+#include <cubesolver.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define CUBE_PIPELINE_MAX_PREFIX 26
+#define CUBE_PIPELINE_BATCH      16
+#define CUBE_PIPELINE_PADDING    64
+#define CUBE_PIPELINE_SPINS      16
+#define CUBE_PIPELINE_SLEEP_US   1000
+
+/******************************************************************************
+* CubePipeline class declaration
+******************************************************************************/
+class CubePipeline
+{
+    friend class CubeSolver;
+
+private:
+    // A phase 1 solution waiting for a phase 2 search, packed into 32 bytes.
+    struct Entry
+    {
+        uint16_t cp;
+        uint16_t ep;
+        uint8_t ud_perm;
+        uint8_t length;
+        uint8_t moves[CUBE_PIPELINE_MAX_PREFIX];
+    };
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        Entry entry;
+    };
+
+    Cube cube;
+    int num_producers;
+    int num_consumers;
+    int target_length;
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    char pad_1[CUBE_PIPELINE_PADDING];
+    std::atomic<size_t> head;
+    char pad_2[CUBE_PIPELINE_PADDING];
+    std::atomic<size_t> tail;
+    char pad_3[CUBE_PIPELINE_PADDING];
+
+    std::atomic<int> bound;
+    std::atomic<bool> done;
+    CubeCancel cancel_token;
+    std::atomic<int> producers_left;
+    std::atomic<int> num_waiting;
+    std::mutex wait_lock;
+    std::condition_variable wait_cond;
+    std::atomic<uint64_t> num_phase1_nodes;
+    std::atomic<uint64_t> num_phase2_nodes;
+    std::mutex best_lock;
+    std::vector<int> best;
+    std::function<void(std::vector<int>&)> process_sol;
+
+    bool try_push(Entry& entry);
+    bool try_pop(Entry& entry);
+    void wake_consumers(bool all);
+    void wait_for_entries(int spins);
+    int pop_batch(Entry* batch);
+    void push(CubeSolver& solver);
+    void record_sol(std::vector<int>& solution);
+    int max_length();
+    bool finished();
+    void produce(int id);
+    void search_entry(CubeSolver& solver, Entry& entry);
+    void consume(int id);
+public:
+    CubePipeline(Cube scrambled_cube, int producers, int consumers,
+                 int capacity);
+    void set_target_length(int length);
+    void set_cancel(const CubeCancel& token);
+    void solve(std::function<void(std::vector<int>&)> callback);
+    std::vector<int> best_solution();
+    uint64_t phase1_nodes();
+    uint64_t phase2_nodes();
+};
+
+#endif
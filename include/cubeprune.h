@@ -4,32 +4,155 @@
 /******************************************************************************
 * Header:  cubeprune.h
 *
-* Purpose: Declaration of the CubePrune class.
+* Purpose: Declaration of the CubePrune class template.
+*
+*          A pruning table is specialised at compile time for the types of
+*          the two transition tables it is built from, which fixes the size
+*          of the table, and for one phase, which fixes the moves it is
+*          filled for. The lookups are defined here so that they are inlined
+*          into the searches, and the rest is explicitly instantiated in
+*          cubeprune.cpp for the tables declared in cubetables.h.
 ******************************************************************************/
 
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <vector>
 
+#include <cube.h>
+#include <cubememory.h>
+#include <cubephase.h>
 #include <cubetrans.h>
 
 /******************************************************************************
-* CubePrune class declaration.
+* Constants
+******************************************************************************/
+#define CUBE_PRUNE_EMPTY   UINT8_MAX
+#define CUBE_PRUNE_PADDING 3
+
+/******************************************************************************
+* CubePrune class template declaration.
 ******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
 class CubePrune
 {
+public:
+    static constexpr int size_1 = Trans1::size();
+    static constexpr int size_2 = Trans2::size();
+    static constexpr uint32_t allowed_moves = (Phase == PHASE_1)
+                                              ? CUBE_P1_MOVES : CUBE_P2_MOVES;
+
 private:
-    int phase;
-    std::vector<int> allowed_moves;
-    CubeTrans* transition_table_1;
-    CubeTrans* transition_table_2;
-    std::vector<std::vector<int>> table;
+    Trans1& transition_table_1;
+    Trans2& transition_table_2;
+    CubeReplicated<uint8_t> table;
+    CubeReplicated<uint8_t> child_table;
+    std::once_flag filled;
 public:
-    CubePrune(int phase_desc,
-              CubeTrans* trans_table_1, CubeTrans* trans_table_2);
+    CubePrune(Trans1& trans_table_1, Trans2& trans_table_2);
     int operator()(int coord_value_1, int coord_value_2);
+    void gather(const int* coords_1, const int* coords_2, int count,
+                int* values);
+    const uint8_t* children(int coord_value_1, int coord_value_2);
+    bool has_children();
+    size_t bytes();
+    void placement(std::vector<size_t>& node_bytes);
+    void prefetch(int coord_value_1, int coord_value_2);
+    void prefetch_children(int coord_value_1, int coord_value_2);
     void fill();
+    void fill_once();
+    void fill_children();
 };
 
+/******************************************************************************
+* Inline CubePrune member definitions
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubePrune::operator()
+*
+* Purpose:   Returns an entry in the pruning table.
+*
+* Params:    coord_value_1 - The coordinate values of the position to look up.
+*            coord_value_2
+*
+* Returns:   The value stored in the table for that combination of coordinates.
+*
+* Operation: Simply return the value from the private table. The size of the
+*            second coordinate is a constant, so the index is worked out
+*            without loading it.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+inline int CubePrune<Trans1, Trans2, Phase>::operator()(int coord_value_1,
+                                                        int coord_value_2)
+{
+    return table[(size_t)coord_value_1 * size_2 + coord_value_2];
+}
+
+/******************************************************************************
+* Function:  CubePrune::children
+*
+* Purpose:   Returns a row of the fused child table.
+*
+* Params:    coord_value_1 - The coordinate values of the parent position.
+*            coord_value_2
+*
+* Returns:   A pointer to NUM_MOVES bytes, where entry n is the value stored
+*            in the pruning table for the position reached by move n.
+*
+* Operation: The rows are stored contiguously, so the pruning values of all
+*            the children of a position are read from one or two cache lines
+*            instead of with a separate random access each.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+inline const uint8_t* CubePrune<Trans1, Trans2, Phase>::children(
+                                       int coord_value_1, int coord_value_2)
+{
+    return &child_table[((size_t)coord_value_1 * size_2 + coord_value_2) *
+                        NUM_MOVES];
+}
+
+/******************************************************************************
+* Function:  CubePrune::prefetch
+*
+* Purpose:   Hints that an entry in the pruning table will be needed soon.
+*
+* Params:    coord_value_1 - The coordinate values of the position which will
+*            coord_value_2   be looked up.
+*
+* Returns:   Nothing.
+*
+* Operation: Issues a prefetch for the cache line holding the entry, so that
+*            the lookup itself does not have to wait for memory.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+inline void CubePrune<Trans1, Trans2, Phase>::prefetch(int coord_value_1,
+                                                       int coord_value_2)
+{
+    __builtin_prefetch(&table[(size_t)coord_value_1 * size_2 + coord_value_2]);
+}
+
+/******************************************************************************
+* Function:  CubePrune::prefetch_children
+*
+* Purpose:   Hints that a row of the fused child table will be needed soon.
+*
+* Params:    coord_value_1 - The coordinate values of the position whose row
+*            coord_value_2   will be read.
+*
+* Returns:   Nothing.
+*
+* Operation: Issues a prefetch for the cache line holding the start of the
+*            row.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+inline void CubePrune<Trans1, Trans2, Phase>::prefetch_children(
+                                       int coord_value_1, int coord_value_2)
+{
+    __builtin_prefetch(children(coord_value_1, coord_value_2));
+}
+
 #endif
@@ -0,0 +1,48 @@
+#ifndef CUBESOLUTIONS_INCLUDED
+#define CUBESOLUTIONS_INCLUDED
+
+/******************************************************************************
+* Header:  cubesolutions.h
+*
+* Purpose: Declaration of the CubeSolutions class, which hands out the
+*          solutions to a cube one at a time as the caller asks for them.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <cube.h>
+#include <cubesolver.h>
+#include <cubewalker.h>
+
+/******************************************************************************
+* CubeSolutions class declaration
+******************************************************************************/
+class CubeSolutions
+{
+private:
+    CubeSolver solver;
+    bool started;
+    bool done;
+    std::deque<std::vector<int>> pending;
+
+    CubeWalker walker;
+
+    void start();
+    bool step();
+public:
+    CubeSolutions(Cube cube);
+    CubeSolutions(const CubeCoords& coords);
+    void set_target_length(int length);
+    void set_cancel(const CubeCancel& token);
+    bool next(std::vector<int>& solution);
+    uint64_t phase1_nodes();
+    uint64_t phase2_nodes();
+};
+
+#endif
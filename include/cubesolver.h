@@ -4,37 +4,125 @@
 /******************************************************************************
 * Header:  cubesolver.h
 *
-* Purpose: Declarations for the CubeSolver class
+* Purpose: Declarations for the CubeSolver class, and for the CubeCancel
+*          tokens which stop a search from another thread.
 ******************************************************************************/
 
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
 #include <vector>
 
 #include <cube.h>
+#include <cubetrace.h>
+
+class CubeBatch;
+class CubeEnumerator;
+class CubePipeline;
+class CubeSolutions;
+
+/******************************************************************************
+* Constants
+*
+* The number of nodes which each phase searches between checks of the
+* cancellation token. This must be a power of 2.
+******************************************************************************/
+#define CUBE_CANCEL_INTERVAL 4096
+
+/******************************************************************************
+* CubeCancel class declaration
+*
+* A token which cancels the searches it has been given to. Copies of a token
+* share the same state, so one token can be given to several solvers, for
+* example to abandon the others once the first has finished.
+******************************************************************************/
+class CubeCancel
+{
+    friend class CubeSolver;
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+public:
+    CubeCancel();
+    void cancel();
+    bool cancelled() const;
+};
 
 /******************************************************************************
 * CubeSolver class declaration
 ******************************************************************************/
 class CubeSolver
 {
+    friend class CubeEnumerator;
+    friend class CubePipeline;
+    friend class CubeWalker;
+
 private:
     int max_length;
+    int target_length;
+    int enumerate_length;
+    bool finished;
+    bool was_cancelled;
+    bool use_fused_prune;
+    bool use_prefetch;
+    bool use_child_ordering;
+    uint64_t num_phase1_nodes;
+    uint64_t num_phase2_nodes;
+    uint64_t num_phase1_leaves;
+    std::vector<uint64_t> transpositions;
+    int transposition_shift;
     std::vector<int> solution;
+    std::vector<int> best;
     int last_move;
+    int p1_state, p2_state;
+    std::function<void(std::vector<int>&)> process_sol;
+    CubePipeline* pipeline;
+    std::shared_ptr<std::atomic<bool>> cancel_flag;
+    CubeTrace* trace;
 
     int curr_co, curr_eo, curr_ud_pos;
     int curr_cp, curr_ep, curr_ud_perm;
     int start_ud_sorted, start_rl_sorted, start_fb_sorted, start_cp;
 
     void phase1_search(int depth);
+    void phase1_leaf();
+    void phase2_start(int ud_sorted, int rl_sorted, int fb_sorted);
+    void phase2_root();
     void phase2_search(int depth);
+    void prefetch_phase1(int co, int eo, int ud_pos);
+    uint64_t transposition_key(int depth);
+    size_t transposition_slot(uint64_t key);
+    bool poll_cancel();
+    void trace_event(int type, int value);
+    bool start_search(std::function<void(std::vector<int>&)> callback);
+    void record_sol();
     void print_sol();
 public:
     CubeSolver();
     CubeSolver(Cube cube);
+    CubeSolver(const CubeCoords& coords);
+    void set_target_length(int length);
+    void set_prefetch(bool enabled);
+    void set_child_ordering(bool enabled);
+    void set_transposition_table(int log2_entries);
+    void set_cancel(const CubeCancel& token);
+    void set_trace(CubeTrace* event_trace);
     void solve();
+    void solve(std::function<void(std::vector<int>&)> callback);
+    void solve_phase2(std::function<void(std::vector<int>&)> callback);
+    std::future<std::vector<int>> solve_async(
+        std::function<void(std::vector<int>&)> callback);
+    bool cancelled();
+    bool in_phase2();
+    std::vector<int> best_solution();
+    uint64_t phase1_nodes();
+    uint64_t phase2_nodes();
 };
 
 #endif
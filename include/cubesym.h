@@ -0,0 +1,39 @@
+#ifndef CUBESYM_INCLUDED
+#define CUBESYM_INCLUDED
+
+/******************************************************************************
+* Header:  cubesym.h
+*
+* Purpose: Declarations of the symmetries of the cube, and of functions which
+*          reduce a cube state to a canonical representative under symmetry
+*          and inversion.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <vector>
+
+#include <cube.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define NUM_SYMMETRIES 48
+
+/******************************************************************************
+* Symmetry table declarations
+******************************************************************************/
+extern std::vector<Cube> cube_sym_cubes;
+extern std::vector<int> cube_sym_inverse;
+extern std::vector<std::vector<int>> cube_sym_move;
+
+/******************************************************************************
+* Functions which populate the above tables and make use of them
+******************************************************************************/
+void cube_create_symmetries();
+int cube_canonical(Cube cube, Cube& canonical);
+std::vector<int> cube_uncanonical_solution(std::vector<int> solution,
+                                           int transform);
+
+#endif
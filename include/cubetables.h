@@ -10,36 +10,100 @@
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
+#include <cstddef>
+#include <string>
+#include <vector>
+
 #include <cube.h>
+#include <cubecoord.h>
+#include <cubeendgame.h>
+#include <cubememory.h>
+#include <cubenear.h>
+#include <cubephase.h>
 #include <cubetrans.h>
 #include <cubeprune.h>
 
+/******************************************************************************
+* Constants
+*
+* Tiers of tables, from the smallest set which the solver can run with to the
+* largest set which it can make use of.
+******************************************************************************/
+#define CUBE_TIER_MINIMAL 0
+#define CUBE_TIER_MEDIUM  1
+#define CUBE_TIER_LARGE   2
+#define NUM_CUBE_TIERS    3
+
+/******************************************************************************
+* Memory used by one table, in total and on each NUMA node
+******************************************************************************/
+struct CubeTableUsage
+{
+    std::string name;
+    size_t bytes;
+    std::vector<size_t> node_bytes;
+};
+
 /******************************************************************************
 * Transition tables
 ******************************************************************************/
-extern CubeTrans cube_co_trans;
-extern CubeTrans cube_eo_trans;
-extern CubeTrans cube_cp_trans;
-extern CubeTrans cube_ud_sorted_trans;
-extern CubeTrans cube_rl_sorted_trans;
-extern CubeTrans cube_fb_sorted_trans;
-extern CubeTrans cube_ep_trans;
-extern CubeTrans cube_ud_unsorted_trans;
-extern CubeTrans cube_ud_perm_trans;
+extern CubeTrans<CubeCoordCO, PHASE_1> cube_co_trans;
+extern CubeTrans<CubeCoordEO, PHASE_1> cube_eo_trans;
+extern CubeTrans<CubeCoordCP, PHASE_1> cube_cp_trans;
+extern CubeTrans<CubeCoordUDSorted, PHASE_1> cube_ud_sorted_trans;
+extern CubeTrans<CubeCoordRLSorted, PHASE_1> cube_rl_sorted_trans;
+extern CubeTrans<CubeCoordFBSorted, PHASE_1> cube_fb_sorted_trans;
+extern CubeTrans<CubeCoordEP, PHASE_2> cube_ep_trans;
+extern CubeTrans<CubeCoordUDUnsorted, PHASE_1> cube_ud_unsorted_trans;
+extern CubeTrans<CubeCoordUDPerm, PHASE_2> cube_ud_perm_trans;
 
 /******************************************************************************
 * Pruning tables
 ******************************************************************************/
-extern CubePrune cube_co_eo_prune;
-extern CubePrune cube_co_ud_prune;
-extern CubePrune cube_eo_ud_prune;
-extern CubePrune cube_ep_ud_prune;
-extern CubePrune cube_cp_ud_prune;
+extern CubePrune<decltype(cube_co_trans), decltype(cube_eo_trans), PHASE_1>
+    cube_co_eo_prune;
+extern CubePrune<decltype(cube_co_trans), decltype(cube_ud_unsorted_trans),
+                 PHASE_1> cube_co_ud_prune;
+extern CubePrune<decltype(cube_eo_trans), decltype(cube_ud_unsorted_trans),
+                 PHASE_1> cube_eo_ud_prune;
+extern CubePrune<decltype(cube_ep_trans), decltype(cube_ud_perm_trans),
+                 PHASE_2> cube_ep_ud_prune;
+extern CubePrune<decltype(cube_cp_trans), decltype(cube_ud_perm_trans),
+                 PHASE_2> cube_cp_ud_prune;
+
+/******************************************************************************
+* Optional table of positions close to solved
+******************************************************************************/
+extern CubeNear cube_near_table;
+
+/******************************************************************************
+* Optional table of exact phase 2 distances close to solved
+******************************************************************************/
+extern CubeEndgame cube_endgame_table;
 
 /******************************************************************************
 * Functions to populate the tables.
 ******************************************************************************/
 void cube_fill_all_trans_tables();
 void cube_fill_all_pruning_tables();
+void cube_fill_phase1_tables();
+void cube_fill_phase2_tables();
+void cube_fill_fused_pruning_tables();
+int cube_fill_near_table(int depth, size_t budget_bytes);
+int cube_fill_endgame_table(int depth, size_t budget_bytes);
+
+/******************************************************************************
+* Functions to choose and populate a tier of tables, and to report the memory
+* used by the tables.
+******************************************************************************/
+size_t cube_tier_bytes(int tier);
+size_t cube_tier_peak_bytes(int tier);
+size_t cube_near_bytes(int depth);
+size_t cube_endgame_bytes(int depth);
+int cube_tier_for_budget(size_t budget_bytes);
+void cube_fill_tier(int tier);
+int cube_fill_for_budget(size_t budget_bytes);
+std::vector<CubeTableUsage> cube_table_usage();
+size_t cube_budget_left(size_t budget_bytes, const std::string& name);
 
 #endif
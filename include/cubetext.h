@@ -0,0 +1,44 @@
+#ifndef CUBETEXT_INCLUDED
+#define CUBETEXT_INCLUDED
+
+/******************************************************************************
+* Header:  cubetext.h
+*
+* Purpose: Conversion between cubes and text. Scrambles are read either as a
+*          string of moves in the usual notation, such as "R U2 F' D", or as
+*          a string of 54 facelets, and solutions are written as a string of
+*          moves. The functions read from and write to caller's buffers, so
+*          that a large file of scrambles can be processed in place.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <cube.h>
+
+/******************************************************************************
+* Constants
+*
+* The number of facelets in a facelet string. The facelets are given face by
+* face in the order U, R, F, D, L, B, each face read row by row as it is
+* seen from outside the cube, with the U face seen with B at the top and the
+* D face seen with F at the top. Any six characters can be used for the
+* colours, as each is identified by the centre facelet of its face.
+******************************************************************************/
+#define NUM_FACELETS 54
+
+/******************************************************************************
+* Text conversion functions
+******************************************************************************/
+bool cube_parse_moves(const char* text, size_t length,
+                      std::vector<int>& moves);
+bool cube_parse_coords(const char* text, size_t length, CubeCoords& coords);
+bool cube_parse_facelets(const char* text, size_t length, Cube& cube);
+bool cube_is_facelets(const char* text, size_t length);
+void cube_format_moves(const std::vector<int>& moves, std::string& text);
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef CUBETRACE_INCLUDED
+#define CUBETRACE_INCLUDED
+
+/******************************************************************************
+* Header:  cubetrace.h
+*
+* Purpose: Declaration of the CubeTrace class, a log of timestamped events
+*          from the searches of a solver, held in a ring buffer which is
+*          allocated up front so that recording an event never allocates.
+*          The log can be written out in the Chrome trace event format, to
+*          be viewed as a timeline in chrome://tracing or Perfetto.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/******************************************************************************
+* Constants
+*
+* The types of event. The value recorded with each is, in turn: unused;
+* unused; the phase 1 depth being searched; the length of the phase 1
+* solution which phase 2 is starting from; the length of the solution found;
+* unused; the length of the best solution, or -1 if none was found; and the
+* phase 2 depth being searched from the end of that phase 1 solution.
+******************************************************************************/
+#define CUBE_TRACE_SOLVE_START   0
+#define CUBE_TRACE_TABLES_READY  1
+#define CUBE_TRACE_PHASE1_DEPTH  2
+#define CUBE_TRACE_PHASE2_START  3
+#define CUBE_TRACE_SOLUTION      4
+#define CUBE_TRACE_CANCELLED     5
+#define CUBE_TRACE_FINISH        6
+#define CUBE_TRACE_PHASE2_DEPTH  7
+
+/******************************************************************************
+* CubeTrace class declaration
+*
+* Events are recorded by a single thread. Once the buffer is full, each new
+* event overwrites the oldest.
+******************************************************************************/
+class CubeTrace
+{
+private:
+    struct Event
+    {
+        uint64_t ticks;
+        int32_t type;
+        int32_t value;
+    };
+
+    std::vector<Event> events;
+    size_t mask;
+    uint64_t count;
+    uint64_t start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+
+    static uint64_t ticks();
+public:
+    CubeTrace(int log2_events);
+    void record(int type, int value);
+    void clear();
+    size_t size();
+    uint64_t dropped();
+    bool write_json(const char* path, int thread_id);
+};
+
+/******************************************************************************
+* Inline CubeTrace member definitions
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeTrace::ticks
+*
+* Purpose:   Reads the clock used to timestamp events.
+*
+* Params:    None.
+*
+* Returns:   The current time, in units which are converted to real time
+*            when the trace is written out.
+*
+* Operation: Reads the time stamp counter where there is one, which takes a
+*            few nanoseconds, and otherwise the monotonic clock in
+*            nanoseconds.
+******************************************************************************/
+inline uint64_t CubeTrace::ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/******************************************************************************
+* Function:  CubeTrace::record
+*
+* Purpose:   Records an event.
+*
+* Params:    type  - One of the CUBE_TRACE constants.
+*            value - The value which goes with the event.
+*
+* Returns:   Nothing.
+*
+* Operation: Writes the event into the next slot of the ring buffer.
+******************************************************************************/
+inline void CubeTrace::record(int type, int value)
+{
+    Event& event = events[count++ & mask];
+    event.ticks = ticks();
+    event.type = type;
+    event.value = value;
+}
+
+#endif
@@ -4,34 +4,99 @@
 /******************************************************************************
 * Header:  cubetrans.h
 *
-* Purpose: Declarations for the CubeTrans class.
+* Purpose: Declarations for the CubeTrans class template.
+*
+*          A transition table is specialised at compile time for one
+*          coordinate, which fixes the number of positions and the width of
+*          each entry, and for one phase, which fixes the moves it is filled
+*          for. The lookups are defined here so that they are inlined into
+*          the searches, and the rest is explicitly instantiated in
+*          cubetrans.cpp for the tables declared in cubetables.h.
 ******************************************************************************/
 
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
-#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
 #include <vector>
 
 #include <cube.h>
+#include <cubecoord.h>
+#include <cubememory.h>
+#include <cubephase.h>
 
 /******************************************************************************
-* CubeTrans class declaration.
+* CubeTrans class template declaration.
 ******************************************************************************/
+template <class Coord, int Phase>
 class CubeTrans
 {
+public:
+    typedef typename Coord::storage Entry;
+
+    static constexpr uint32_t allowed_moves = (Phase == PHASE_1)
+                                              ? CUBE_P1_MOVES : CUBE_P2_MOVES;
+
+    // Entries past the end of the table, so that a four-byte read at the
+    // start of the last entry stays in bounds.
+    static constexpr int padding = 4 / sizeof(Entry) - 1;
+
 private:
-    int phase;
-    std::function<int(Cube&)> coord_func;
-    std::vector<std::vector<int>> table;
+    CubeReplicated<Entry> table;
     int _solved_pos;
-    std::vector<int> allowed_moves;
+    std::once_flag filled;
 public:
-    CubeTrans(int phase_desc, std::function<int(Cube&)> func, int range);
+    CubeTrans();
     int solved_pos();
-    int size();
+    static constexpr int size() { return Coord::range; }
+    size_t bytes();
+    void placement(std::vector<size_t>& node_bytes);
     int operator()(int position, int move);
+    void gather(const int* positions, const int* moves, int count,
+                int* results);
     void fill();
+    void fill_once();
 };
 
+/******************************************************************************
+* Inline CubeTrans member definitions
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeTrans::solved_pos
+*
+* Purpose:   Getter for the private _solved_pos member variable
+*
+* Params:    None.
+*
+* Returns:   The value of the _solved_pos member.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+template <class Coord, int Phase>
+inline int CubeTrans<Coord, Phase>::solved_pos()
+{
+    return _solved_pos;
+}
+
+/******************************************************************************
+* Function:  CubeTrans::operator()
+*
+* Purpose:   Returns an entry in the transition table.
+*
+* Params:    position - The coordinate value of the 'from' position
+*            move     - The move to be performed.
+*
+* Returns:   The coordinate value of the resulting position.
+*
+* Operation: Simply return the value from the private table.
+******************************************************************************/
+template <class Coord, int Phase>
+inline int CubeTrans<Coord, Phase>::operator()(int position, int move)
+{
+    return table[position * NUM_MOVES + move];
+}
+
 #endif
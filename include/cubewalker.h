@@ -0,0 +1,62 @@
+#ifndef CUBEWALKER_INCLUDED
+#define CUBEWALKER_INCLUDED
+
+/******************************************************************************
+* Header:  cubewalker.h
+*
+* Purpose: Declaration of the CubeWalker class, which runs the phase 1 search
+*          of one cube with an explicit stack, so that it can be advanced
+*          one position at a time.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <cube.h>
+#include <cubesolver.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define CUBE_WALKER_MAX_DEPTH 32
+
+/******************************************************************************
+* CubeWalker class declaration
+******************************************************************************/
+class CubeWalker
+{
+private:
+    CubeSolver* solver;
+
+    // Frame n of the stack holds the children of the position after n moves
+    // of the current phase 1 path which survived the pruning, and how many
+    // of them have been visited.
+    int limit;
+    int level;
+    int node_level;
+    int frame_count[CUBE_WALKER_MAX_DEPTH];
+    int frame_next[CUBE_WALKER_MAX_DEPTH];
+    int frame_co[CUBE_WALKER_MAX_DEPTH][NUM_MOVES];
+    int frame_eo[CUBE_WALKER_MAX_DEPTH][NUM_MOVES];
+    int frame_ud_pos[CUBE_WALKER_MAX_DEPTH][NUM_MOVES];
+    int frame_move[CUBE_WALKER_MAX_DEPTH][NUM_MOVES];
+    int frame_state[CUBE_WALKER_MAX_DEPTH][NUM_MOVES];
+
+    void visit_leaf(int index);
+public:
+    CubeWalker();
+    bool start(CubeSolver& search,
+               std::function<void(std::vector<int>&)> callback);
+    bool next_node(int& co, int& eo, int& ud_pos, int& state);
+    int child_depth();
+    void count_children(uint32_t moves);
+    void begin_frame();
+    void push_child(int co, int eo, int ud_pos, int move, int state);
+    void expand(int co, int eo, int ud_pos, int state);
+};
+
+#endif
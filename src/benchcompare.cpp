@@ -0,0 +1,598 @@
+/******************************************************************************
+* File:    benchcompare.cpp
+*
+* Purpose: Compares the results of the benchmark, as written by its --json
+*          option, against a baseline, and fails if the solver has got
+*          worse.
+*
+*          The nodes visited and the lengths of the solutions found by the
+*          deterministic runs depend only on the scrambles and the settings,
+*          so they are compared exactly, and any increase is a regression.
+*          Those of the pipeline depend on the timing of its threads, so
+*          only its mean length is compared, within the tolerance. Speed is
+*          compared by the solves per second at the median time. The noise
+*          in each median is estimated from the median absolute deviation
+*          of the times, which a few outlying times barely move, and a fall
+*          in speed only counts as a regression if it is more than the
+*          tolerance, or more than three times the combined noise of the two
+*          files if that is larger, up to a cap of 15%, so that very noisy
+*          times cannot hide a large regression. Times are only comparable
+*          when both files come from the same host, so they are skipped if
+*          the host name, CPU model or number of CPUs recorded in the files
+*          differ, and --no-time skips them in any case. With
+*          --advise-time, times are compared and reported, but a fall in
+*          speed is only a warning, since on a busy host the times of runs
+*          made minutes apart can differ by more than any useful threshold.
+*
+*          The baseline in bench/baseline.json was made with:
+*
+*              make bench-baseline
+*
+*          and is checked with:
+*
+*              make bench-check
+*
+*          which runs the benchmark with the same settings into
+*          build/bench.json, and then:
+*
+*              benchcompare --advise-time bench/baseline.json build/bench.json
+*
+*          so that it fails only on the node counts and solution lengths,
+*          which are exact.
+*
+*          Usage: benchcompare [--tolerance F] [--no-time | --advise-time]
+*                              BASELINE CURRENT
+*
+*          The exit status is 0 if there are no regressions, 1 if there
+*          are, and 2 if the files cannot be read or were made with
+*          different settings.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define COMPARE_DEFAULT_TOLERANCE 0.05
+#define COMPARE_NOISE_FACTOR      3.0
+#define COMPARE_MAX_THRESHOLD     0.15
+
+/******************************************************************************
+* Scale factors for normally distributed times: the standard deviation is
+* about 1.4826 times the median absolute deviation, and the standard error of
+* the median of n times is about 1.2533 times the standard deviation divided
+* by the square root of n.
+******************************************************************************/
+#define COMPARE_MAD_SCALE         1.4826
+#define COMPARE_MEDIAN_SCALE      1.2533
+
+/******************************************************************************
+* The values in a JSON file, keyed by their path, such as "runs.0.name"
+******************************************************************************/
+typedef std::map<std::string, std::string> CompareValues;
+
+/******************************************************************************
+* Function:  compare_skip_space
+*
+* Purpose:   Skips white space in a JSON file.
+*
+* Params:    text - The contents of the file.
+*            pos  - The position to start from, which is moved past any
+*                   white space.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply advance over spaces, tabs and line breaks.
+******************************************************************************/
+static void compare_skip_space(const std::string& text, size_t& pos)
+{
+    while (pos < text.size() && strchr(" \t\r\n", text[pos]) != nullptr)
+    {
+        ++pos;
+    }
+}
+
+/******************************************************************************
+* Function:  compare_parse_string
+*
+* Purpose:   Reads a string from a JSON file.
+*
+* Params:    text  - The contents of the file.
+*            pos   - The position of the opening quote, which is moved past
+*                    the closing quote.
+*            value - Output parameter holding the string.
+*
+* Returns:   True if the string was read, and false otherwise.
+*
+* Operation: Copies the characters up to the closing quote, taking the
+*            character after each backslash as it is. The benchmark never
+*            writes any other escapes.
+******************************************************************************/
+static bool compare_parse_string(const std::string& text, size_t& pos,
+                                 std::string& value)
+{
+    if (pos >= text.size() || text[pos] != '"')
+    {
+        return false;
+    }
+
+    value.clear();
+    for (++pos; pos < text.size() && text[pos] != '"'; ++pos)
+    {
+        if (text[pos] == '\\')
+        {
+            ++pos;
+        }
+        if (pos < text.size())
+        {
+            value += text[pos];
+        }
+    }
+
+    ++pos;
+    return pos <= text.size();
+}
+
+/******************************************************************************
+* Function:  compare_parse_value
+*
+* Purpose:   Reads a value from a JSON file, together with everything inside
+*            it.
+*
+* Params:    text   - The contents of the file.
+*            pos    - The position of the value, which is moved past it.
+*            path   - The path of the value.
+*            values - The values read, which each value which is not an
+*                     object or an array is added to.
+*
+* Returns:   True if the value was read, and false otherwise.
+*
+* Operation: Recurses into the members of objects, whose paths have the name
+*            of the member added, and the items of arrays, whose paths have
+*            the index of the item added. Numbers and the literals true,
+*            false and null are stored as they are written.
+******************************************************************************/
+static bool compare_parse_value(const std::string& text, size_t& pos,
+                                const std::string& path,
+                                CompareValues& values)
+{
+    std::string prefix = path.empty() ? "" : path + ".";
+    compare_skip_space(text, pos);
+    if (pos >= text.size())
+    {
+        return false;
+    }
+
+    if (text[pos] == '{' || text[pos] == '[')
+    {
+        char close = (text[pos] == '{') ? '}' : ']';
+        bool object = (close == '}');
+        int index = 0;
+
+        ++pos;
+        compare_skip_space(text, pos);
+        if (pos < text.size() && text[pos] == close)
+        {
+            ++pos;
+            return true;
+        }
+
+        while (true)
+        {
+            std::string name = std::to_string(index++);
+            if (object)
+            {
+                compare_skip_space(text, pos);
+                if (!compare_parse_string(text, pos, name))
+                {
+                    return false;
+                }
+                compare_skip_space(text, pos);
+                if (pos >= text.size() || text[pos++] != ':')
+                {
+                    return false;
+                }
+            }
+
+            if (!compare_parse_value(text, pos, prefix + name, values))
+            {
+                return false;
+            }
+
+            compare_skip_space(text, pos);
+            if (pos >= text.size())
+            {
+                return false;
+            }
+            if (text[pos++] == close)
+            {
+                return true;
+            }
+            if (text[pos - 1] != ',')
+            {
+                return false;
+            }
+        }
+    }
+
+    if (text[pos] == '"')
+    {
+        return compare_parse_string(text, pos, values[path]);
+    }
+
+    size_t start = pos;
+    while (pos < text.size() &&
+           strchr(",]} \t\r\n", text[pos]) == nullptr)
+    {
+        ++pos;
+    }
+    values[path] = text.substr(start, pos - start);
+    return pos > start;
+}
+
+/******************************************************************************
+* Function:  compare_load
+*
+* Purpose:   Reads the results of the benchmark from a file.
+*
+* Params:    path   - The file to read.
+*            values - Output parameter holding the values in the file.
+*
+* Returns:   True if the file was read, and false otherwise.
+*
+* Operation: Reads the whole file, and parses it as a single JSON value.
+******************************************************************************/
+static bool compare_load(const char* path, CompareValues& values)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    std::string text;
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        text.append(buffer, length);
+    }
+    fclose(file);
+
+    size_t pos = 0;
+    return compare_parse_value(text, pos, "", values);
+}
+
+/******************************************************************************
+* Function:  compare_find_run
+*
+* Purpose:   Finds a run of the benchmark by its name.
+*
+* Params:    values - The values read from a file.
+*            name   - The name of the run.
+*
+* Returns:   The path of the run, or an empty string if there is no such run.
+*
+* Operation: Looks through the runs in order.
+******************************************************************************/
+static std::string compare_find_run(CompareValues& values,
+                                    const std::string& name)
+{
+    for (int ii = 0; values.count("runs." + std::to_string(ii) + ".name");
+         ++ii)
+    {
+        std::string run = "runs." + std::to_string(ii);
+        if (values[run + ".name"] == name)
+        {
+            return run;
+        }
+    }
+    return "";
+}
+
+/******************************************************************************
+* Function:  compare_median
+*
+* Purpose:   Finds the median of some values.
+*
+* Params:    values - The values, which are sorted.
+*
+* Returns:   The median, or the mean of the two middle values for an even
+*            number.
+*
+* Operation: Sorts the values and picks the middle.
+******************************************************************************/
+static double compare_median(std::vector<double>& values)
+{
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return (values.size() % 2 == 1) ?
+           values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+/******************************************************************************
+* Function:  compare_noise
+*
+* Purpose:   Works out how uncertain the median time of a run is.
+*
+* Params:    values - The values read from a file.
+*            run    - The path of the run.
+*
+* Returns:   The estimated standard error of the median time, as a fraction
+*            of it, or 0 if there are fewer than three times.
+*
+* Operation: Takes the median absolute deviation of the times from their
+*            median, and scales it to a standard error as for normally
+*            distributed times.
+******************************************************************************/
+static double compare_noise(CompareValues& values, const std::string& run)
+{
+    std::vector<double> seconds;
+    for (int ii = 0;
+         values.count(run + ".seconds." + std::to_string(ii)); ++ii)
+    {
+        seconds.push_back(atof(values[run + ".seconds." +
+                                      std::to_string(ii)].c_str()));
+    }
+    if (seconds.size() < 3)
+    {
+        return 0.0;
+    }
+
+    double median = compare_median(seconds);
+    std::vector<double> deviations;
+    for (double time : seconds)
+    {
+        deviations.push_back(fabs(time - median));
+    }
+    double deviation = compare_median(deviations);
+    return (median > 0.0) ? COMPARE_MEDIAN_SCALE * COMPARE_MAD_SCALE *
+                            deviation / median / sqrt(seconds.size())
+                          : 0.0;
+}
+
+/******************************************************************************
+* Function:  compare_exact
+*
+* Purpose:   Compares a count which must not go up.
+*
+* Params:    name     - The name of the run.
+*            field    - The name of the count.
+*            baseline - The values read from the baseline.
+*            base_run - The path of the run in the baseline.
+*            current  - The values read from the current results.
+*            curr_run - The path of the run in the current results.
+*            improved - Set to true if the count went down.
+*
+* Returns:   True if the count went up, which is a regression.
+*
+* Operation: Reads both counts as integers, and prints them and the verdict.
+******************************************************************************/
+static bool compare_exact(const std::string& name, const char* field,
+                          CompareValues& baseline, const std::string& base_run,
+                          CompareValues& current, const std::string& curr_run,
+                          bool& improved)
+{
+    unsigned long long base =
+        strtoull(baseline[base_run + "." + field].c_str(), nullptr, 10);
+    unsigned long long curr =
+        strtoull(current[curr_run + "." + field].c_str(), nullptr, 10);
+
+    const char* verdict = "ok";
+    if (curr > base)
+    {
+        verdict = "REGRESSION";
+    }
+    else if (curr < base)
+    {
+        verdict = "improved";
+        improved = true;
+    }
+
+    printf("%-12s %-18s %16llu %16llu  %+8.3f%%  %s\n", name.c_str(), field,
+           base, curr, base ? 100.0 * ((double)curr - base) / base : 0.0,
+           verdict);
+    return curr > base;
+}
+
+/******************************************************************************
+* Function:  compare_ratio
+*
+* Purpose:   Compares a measurement which may vary within a threshold.
+*
+* Params:    name            - The name of the run.
+*            field           - The name of the measurement.
+*            base            - The value in the baseline.
+*            curr            - The value in the current results.
+*            threshold       - The largest change, as a fraction of the
+*                              baseline, which is not a regression.
+*            higher_is_worse - True if an increase is a regression, and
+*                              false if a decrease is.
+*            advisory        - True if being worse is only to be reported.
+*
+* Returns:   True if the measurement is worse by more than the threshold,
+*            and that is not advisory.
+*
+* Operation: Prints both values, the change, the threshold and the verdict.
+******************************************************************************/
+static bool compare_ratio(const std::string& name, const char* field,
+                          double base, double curr, double threshold,
+                          bool higher_is_worse, bool advisory)
+{
+    double change = (base != 0.0) ? (curr - base) / base : 0.0;
+    bool regressed = higher_is_worse ? (change > threshold)
+                                     : (change < -threshold);
+
+    printf("%-12s %-18s %16.4f %16.4f  %+8.3f%%  %s (threshold %.1f%%)\n",
+           name.c_str(), field, base, curr, 100.0 * change,
+           !regressed ? "ok" : advisory ? "worse, advisory" : "REGRESSION",
+           100.0 * threshold);
+    return regressed && !advisory;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the comparison.
+*
+* Params:    argc, argv - The command line options described at the top of
+*                         this file.
+*
+* Returns:   0 if there are no regressions, 1 if there are, and 2 if the
+*            comparison cannot be made.
+*
+* Operation: Reads both files and checks that their settings match, and then
+*            compares each run of the baseline with the run of the same name
+*            in the current results. A run which is missing from the current
+*            results is a regression. Times are skipped if the files come
+*            from different hosts.
+******************************************************************************/
+int main(int argc, char** argv)
+{
+    double tolerance = COMPARE_DEFAULT_TOLERANCE;
+    bool compare_time = true;
+    bool advise_time = false;
+    std::vector<const char*> paths;
+
+    for (int ii = 1; ii < argc; ++ii)
+    {
+        if (ii + 1 < argc && strcmp(argv[ii], "--tolerance") == 0)
+        {
+            tolerance = atof(argv[++ii]);
+        }
+        else if (strcmp(argv[ii], "--no-time") == 0)
+        {
+            compare_time = false;
+        }
+        else if (strcmp(argv[ii], "--advise-time") == 0)
+        {
+            advise_time = true;
+        }
+        else if (argv[ii][0] != '-')
+        {
+            paths.push_back(argv[ii]);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[ii]);
+            return 2;
+        }
+    }
+
+    if (paths.size() != 2)
+    {
+        fprintf(stderr, "Usage: benchcompare [--tolerance F] "
+                        "[--no-time | --advise-time] BASELINE CURRENT\n");
+        return 2;
+    }
+
+    CompareValues baseline, current;
+    for (int ii = 0; ii < 2; ++ii)
+    {
+        if (!compare_load(paths[ii], (ii == 0) ? baseline : current))
+        {
+            fprintf(stderr, "Cannot read %s\n", paths[ii]);
+            return 2;
+        }
+    }
+
+    if (baseline["settings"] != current["settings"] ||
+        baseline["cubes"] != current["cubes"])
+    {
+        fprintf(stderr, "Settings differ:\n  %s: %s cubes %s\n"
+                        "  %s: %s cubes %s\n",
+                paths[0], baseline["settings"].c_str(),
+                baseline["cubes"].c_str(), paths[1],
+                current["settings"].c_str(), current["cubes"].c_str());
+        return 2;
+    }
+
+    if (compare_time &&
+        (baseline["host.name"] != current["host.name"] ||
+         baseline["host.cpu"] != current["host.cpu"] ||
+         baseline["host.cpus"] != current["host.cpus"]))
+    {
+        printf("Times not compared, since the files come from different "
+               "hosts:\n  %s: %s, %s, %s CPU(s)\n  %s: %s, %s, %s CPU(s)\n",
+               paths[0], baseline["host.name"].c_str(),
+               baseline["host.cpu"].c_str(), baseline["host.cpus"].c_str(),
+               paths[1], current["host.name"].c_str(),
+               current["host.cpu"].c_str(), current["host.cpus"].c_str());
+        compare_time = false;
+    }
+
+    printf("%-12s %-18s %16s %16s  %9s  %s\n", "run", "measure",
+           "baseline", "current", "change", "verdict");
+
+    int regressions = 0;
+    bool improved = false;
+    for (int ii = 0;
+         baseline.count("runs." + std::to_string(ii) + ".name"); ++ii)
+    {
+        std::string base_run = "runs." + std::to_string(ii);
+        std::string name = baseline[base_run + ".name"];
+        std::string curr_run = compare_find_run(current, name);
+        if (curr_run.empty())
+        {
+            printf("%-12s missing from the current results  REGRESSION\n",
+                   name.c_str());
+            ++regressions;
+            continue;
+        }
+
+        if (baseline[base_run + ".deterministic"] == "true")
+        {
+            regressions += compare_exact(name, "phase1_nodes", baseline,
+                                         base_run, current, curr_run,
+                                         improved);
+            regressions += compare_exact(name, "phase2_nodes", baseline,
+                                         base_run, current, curr_run,
+                                         improved);
+            regressions += compare_exact(name, "total_length", baseline,
+                                         base_run, current, curr_run,
+                                         improved);
+        }
+        else
+        {
+            regressions += compare_ratio(
+                name, "mean_length",
+                atof(baseline[base_run + ".mean_length"].c_str()),
+                atof(current[curr_run + ".mean_length"].c_str()),
+                tolerance, true, false);
+        }
+
+        if (compare_time)
+        {
+            double base_noise = compare_noise(baseline, base_run);
+            double curr_noise = compare_noise(current, curr_run);
+            double noise = sqrt(base_noise * base_noise +
+                                curr_noise * curr_noise);
+            regressions += compare_ratio(
+                name, "solves_per_second",
+                atof(baseline[base_run + ".solves_per_second"].c_str()),
+                atof(current[curr_run + ".solves_per_second"].c_str()),
+                std::max(tolerance, std::min(COMPARE_MAX_THRESHOLD,
+                                             COMPARE_NOISE_FACTOR * noise)),
+                false, advise_time);
+        }
+    }
+
+    if (improved)
+    {
+        printf("Some counts went down; if this is intended, update the "
+               "baseline.\n");
+    }
+    printf("%d regression(s)\n", regressions);
+    return (regressions > 0) ? 1 : 0;
+}
@@ -0,0 +1,1021 @@
+/******************************************************************************
+* File:    benchmark.cpp
+*
+* Purpose: Benchmark for the solver. A fixed set of scrambles is generated
+*          from a seed and solved with prefetching of pruning data switched
+*          off and then on, and the time taken and nodes visited are
+*          reported for each. The scrambles can also be solved by a
+*          CubePipeline with the given numbers of phase 1 and phase 2
+*          threads, and by a CubeBatch. With --phase2, the scrambles are
+*          made of phase 2 moves only and are solved with solve_phase2.
+*          With --budget, the largest tier of tables which fits in the given
+*          number of megabytes is filled first. The memory used by each
+*          table, and its placement on the NUMA nodes of the host, is
+*          reported before the scrambles are solved. The tables are put on
+*          huge pages unless --no-huge-pages is given, and --numa chooses
+*          how they are placed on the nodes. With --trace, the events of
+*          the solves with prefetching are logged and written to the given
+*          file in the Chrome trace event format.
+*
+*          Where the host allows it, hardware performance counters are read
+*          around the filling of the tables and around each solve, and are
+*          reported per solve and per node, so that changes to the layout
+*          of the tables can be judged by their cache and TLB misses as well
+*          as by time. Counters which cannot be opened are left out, and
+*          --no-counters leaves them all out.
+*
+*          With --repeat, the runs take turns until each has been made the
+*          given number of times, and the median time of each is reported.
+*          With --json, the settings, the host, and the results of every run
+*          are also written to the given file, to be compared against a
+*          baseline by benchcompare.
+*
+*          Usage: benchmark [--cubes N] [--seed S] [--target L] [--fused]
+*                           [--endgame K] [--near K] [--order]
+*                           [--pipeline P C] [--batch] [--tt B]
+*                           [--automaton D1 D2] [--phase2] [--budget MB]
+*                           [--no-huge-pages]
+*                           [--numa local|interleave|replicate]
+*                           [--trace FILE] [--no-counters]
+*                           [--repeat N] [--json FILE]
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cube.h>
+#include <cubebatch.h>
+#include <cubememory.h>
+#include <cubephase.h>
+#include <cubepipeline.h>
+#include <cubesolver.h>
+#include <cubetables.h>
+#include <cubetrace.h>
+
+/******************************************************************************
+* Performance counters
+*
+* The events counted, by the user space code of the benchmark and of any
+* threads it starts. The cache events count read misses. The file
+* descriptor of each counter is -1 if it could not be opened.
+******************************************************************************/
+#define BENCH_NUM_COUNTERS 7
+
+#define BENCH_CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+struct BenchCounter
+{
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+static const BenchCounter bench_counters[BENCH_NUM_COUNTERS] =
+{
+    {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"L1d-misses",    PERF_TYPE_HW_CACHE,
+                      BENCH_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    {"LLC-misses",    PERF_TYPE_HW_CACHE,
+                      BENCH_CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+    {"dTLB-misses",   PERF_TYPE_HW_CACHE,
+                      BENCH_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"page-faults",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}
+};
+
+static int bench_counter_fds[BENCH_NUM_COUNTERS] =
+{
+    -1, -1, -1, -1, -1, -1, -1
+};
+
+/******************************************************************************
+* Results of solving every scramble once
+******************************************************************************/
+struct BenchResult
+{
+    double seconds;
+    uint64_t phase1_nodes;
+    uint64_t phase2_nodes;
+    int total_length;
+    double counts[BENCH_NUM_COUNTERS];
+};
+
+/******************************************************************************
+* One run of the benchmark, which solves every scramble once with some
+* solver and settings
+******************************************************************************/
+struct BenchRun
+{
+    const char* name;
+    bool deterministic;
+    std::function<BenchResult()> run;
+};
+
+/******************************************************************************
+* Results of all the repeats of one run
+******************************************************************************/
+struct BenchSeries
+{
+    const char* name;
+    bool deterministic;
+    BenchResult result;
+    std::vector<double> seconds;
+};
+
+/******************************************************************************
+* The host the benchmark ran on, since times are only comparable between
+* results from the same one
+******************************************************************************/
+struct BenchHost
+{
+    std::string name;
+    std::string cpu;
+    unsigned cpus;
+};
+
+/******************************************************************************
+* Function:  bench_seconds
+*
+* Purpose:   Reads a monotonic clock.
+*
+* Params:    None.
+*
+* Returns:   The current time in seconds from some fixed point.
+*
+* Operation: Uses std::chrono::steady_clock.
+******************************************************************************/
+static double bench_seconds()
+{
+    return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/******************************************************************************
+* Function:  bench_open_counters
+*
+* Purpose:   Opens the performance counters.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Opens each counter on its own with perf_event_open, so that a
+*            host which lacks some of the events, or which only allows
+*            software events, still gives the rest. The counters are
+*            inherited by threads started later, such as those of a
+*            pipeline, and their counts are added in when the threads exit.
+*            Prints the counters which could not be opened, with the reason
+*            for the first failure.
+******************************************************************************/
+static void bench_open_counters()
+{
+    int first_error = 0;
+    std::string missing;
+
+    for (int ii = 0; ii < BENCH_NUM_COUNTERS; ++ii)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = bench_counters[ii].type;
+        attr.config = bench_counters[ii].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        bench_counter_fds[ii] = syscall(SYS_perf_event_open, &attr, 0, -1,
+                                        -1, 0);
+        if (bench_counter_fds[ii] < 0)
+        {
+            first_error = (first_error != 0) ? first_error : errno;
+            missing += missing.empty() ? "" : ", ";
+            missing += bench_counters[ii].name;
+        }
+    }
+
+    if (!missing.empty())
+    {
+        printf("Counters unavailable: %s (%s)\n", missing.c_str(),
+               strerror(first_error));
+    }
+}
+
+/******************************************************************************
+* Function:  bench_read_counters
+*
+* Purpose:   Reads the performance counters.
+*
+* Params:    counts - Output array holding the count of each counter, or 0
+*                     for a counter which is not open.
+*
+* Returns:   Nothing.
+*
+* Operation: Scales each count up by the fraction of the time for which the
+*            counter was actually running, in case the kernel has had to
+*            share the hardware counters between more events than it has.
+******************************************************************************/
+static void bench_read_counters(double* counts)
+{
+    for (int ii = 0; ii < BENCH_NUM_COUNTERS; ++ii)
+    {
+        uint64_t values[3];
+        counts[ii] = 0.0;
+        if (bench_counter_fds[ii] >= 0 &&
+            read(bench_counter_fds[ii], values, sizeof(values)) ==
+                                                         sizeof(values) &&
+            values[2] > 0)
+        {
+            counts[ii] = (double)values[0] * values[1] / values[2];
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  bench_add_counters
+*
+* Purpose:   Adds up the events counted since an earlier reading.
+*
+* Params:    start  - The counts read at the start.
+*            totals - The totals, which the events since then are added to.
+*
+* Returns:   Nothing.
+*
+* Operation: Reads the counters again, and adds the differences.
+******************************************************************************/
+static void bench_add_counters(double* start, double* totals)
+{
+    double end[BENCH_NUM_COUNTERS];
+    bench_read_counters(end);
+    for (int ii = 0; ii < BENCH_NUM_COUNTERS; ++ii)
+    {
+        totals[ii] += end[ii] - start[ii];
+    }
+}
+
+/******************************************************************************
+* Function:  bench_print_counters
+*
+* Purpose:   Prints the events counted during some part of the benchmark.
+*
+* Params:    label   - A description of what the counts are per.
+*            counts  - The total count of each counter.
+*            divisor - The number to divide each count by.
+*
+* Returns:   Nothing.
+*
+* Operation: Prints one line holding each counter which is open, and nothing
+*            if none are.
+******************************************************************************/
+static void bench_print_counters(const char* label, double* counts,
+                                 double divisor)
+{
+    bool any = false;
+    for (int ii = 0; ii < BENCH_NUM_COUNTERS; ++ii)
+    {
+        if (bench_counter_fds[ii] >= 0)
+        {
+            if (!any)
+            {
+                printf("  %-12s", label);
+                any = true;
+            }
+            printf("  %s %.4g", bench_counters[ii].name,
+                   counts[ii] / (divisor > 0.0 ? divisor : 1.0));
+        }
+    }
+    if (any)
+    {
+        printf("\n");
+    }
+}
+
+/******************************************************************************
+* Function:  bench_scrambles
+*
+* Purpose:   Generates the scrambles to be solved.
+*
+* Params:    num_cubes - The number of scrambles to generate.
+*            seed      - The seed for the random number generator.
+*            phase2    - Whether to use only phase 2 moves.
+*
+* Returns:   The scrambled cubes.
+*
+* Operation: Applies 30 random moves to a solved cube for each scramble. The
+*            raw output of std::mt19937 is used, so that the same seed gives
+*            the same scrambles on every platform.
+******************************************************************************/
+static std::vector<Cube> bench_scrambles(int num_cubes, unsigned seed,
+                                         bool phase2)
+{
+    std::mt19937 rng(seed);
+    std::vector<Cube> cubes;
+
+    std::vector<int> moves;
+    for (int move = 0; move < NUM_MOVES; ++move)
+    {
+        if (!phase2 || (CUBE_P2_MOVES & CUBE_MOVE_BIT(move)) != 0)
+        {
+            moves.push_back(move);
+        }
+    }
+
+    for (int ii = 0; ii < num_cubes; ++ii)
+    {
+        Cube cube;
+        for (int jj = 0; jj < 30; ++jj)
+        {
+            cube = cube.perform_move(moves[rng() % moves.size()]);
+        }
+        cubes.push_back(cube);
+    }
+
+    return cubes;
+}
+
+/******************************************************************************
+* Function:  bench_run
+*
+* Purpose:   Solves every scramble once with the given settings.
+*
+* Params:    cubes    - The scrambled cubes.
+*            target   - The target length passed to the solver.
+*            prefetch - Whether the solver should prefetch pruning data.
+*            order    - Whether the solver should order children in phase 1.
+*            tt_bits  - The base 2 logarithm of the size of the solver's
+*                       transposition table, or 0 for none.
+*            phase2   - Whether to use solve_phase2 instead of solve.
+*            trace    - The log to record the events of the solves in, or
+*                       nullptr for none.
+*
+* Returns:   The total time, nodes and solution length over all the cubes.
+*
+* Operation: Runs a CubeSolver on each cube in turn.
+******************************************************************************/
+static BenchResult bench_run(std::vector<Cube>& cubes, int target,
+                             bool prefetch, bool order, int tt_bits,
+                             bool phase2, CubeTrace* trace)
+{
+    BenchResult result = {};
+
+    for (Cube& cube : cubes)
+    {
+        CubeSolver solver(cube);
+        solver.set_target_length(target);
+        solver.set_prefetch(prefetch);
+        solver.set_child_ordering(order);
+        solver.set_transposition_table(tt_bits);
+        solver.set_trace(trace);
+
+        double counts[BENCH_NUM_COUNTERS];
+        bench_read_counters(counts);
+        double start = bench_seconds();
+        if (phase2)
+        {
+            solver.solve_phase2([](std::vector<int>&) {});
+        }
+        else
+        {
+            solver.solve([](std::vector<int>&) {});
+        }
+        result.seconds += bench_seconds() - start;
+        bench_add_counters(counts, result.counts);
+
+        result.phase1_nodes += solver.phase1_nodes();
+        result.phase2_nodes += solver.phase2_nodes();
+        result.total_length += solver.best_solution().size();
+    }
+
+    return result;
+}
+
+/******************************************************************************
+* Function:  bench_run_pipeline
+*
+* Purpose:   Solves every scramble once with a pipelined search.
+*
+* Params:    cubes     - The scrambled cubes.
+*            target    - The target length passed to the pipeline.
+*            producers - The number of phase 1 threads.
+*            consumers - The number of phase 2 threads.
+*
+* Returns:   The total time, nodes and solution length over all the cubes.
+*
+* Operation: Runs a CubePipeline on each cube in turn.
+******************************************************************************/
+static BenchResult bench_run_pipeline(std::vector<Cube>& cubes, int target,
+                                      int producers, int consumers)
+{
+    BenchResult result = {};
+
+    for (Cube& cube : cubes)
+    {
+        CubePipeline pipeline(cube, producers, consumers, 1024);
+        pipeline.set_target_length(target);
+
+        double counts[BENCH_NUM_COUNTERS];
+        bench_read_counters(counts);
+        double start = bench_seconds();
+        pipeline.solve([](std::vector<int>&) {});
+        result.seconds += bench_seconds() - start;
+        bench_add_counters(counts, result.counts);
+
+        result.phase1_nodes += pipeline.phase1_nodes();
+        result.phase2_nodes += pipeline.phase2_nodes();
+        result.total_length += pipeline.best_solution().size();
+    }
+
+    return result;
+}
+
+/******************************************************************************
+* Function:  bench_run_batch
+*
+* Purpose:   Solves all the scrambles together with a lane-parallel search.
+*
+* Params:    cubes  - The scrambled cubes.
+*            target - The target length passed to the batch solver.
+*
+* Returns:   The total time, nodes and solution length over all the cubes.
+*
+* Operation: Runs a single CubeBatch on the whole list of cubes.
+******************************************************************************/
+static BenchResult bench_run_batch(std::vector<Cube>& cubes, int target)
+{
+    BenchResult result = {};
+
+    CubeBatch batch;
+    batch.set_target_length(target);
+
+    double counts[BENCH_NUM_COUNTERS];
+    bench_read_counters(counts);
+    double start = bench_seconds();
+    std::vector<std::vector<int>> solutions = batch.solve(cubes);
+    result.seconds = bench_seconds() - start;
+    bench_add_counters(counts, result.counts);
+
+    result.phase1_nodes = batch.phase1_nodes();
+    result.phase2_nodes = batch.phase2_nodes();
+    for (std::vector<int>& solution : solutions)
+    {
+        result.total_length += solution.size();
+    }
+
+    return result;
+}
+
+/******************************************************************************
+* Function:  bench_report
+*
+* Purpose:   Prints the results of one run.
+*
+* Params:    name      - A description of the settings used.
+*            result    - The results of the run.
+*            num_cubes - The number of cubes solved.
+*
+* Returns:   Nothing.
+*
+* Operation: Prints the totals, together with the average time per solve and
+*            per node, and then the average counts per solve and per node of
+*            any counters which are open.
+******************************************************************************/
+static void bench_report(const char* name, BenchResult& result, int num_cubes)
+{
+    uint64_t nodes = result.phase1_nodes + result.phase2_nodes;
+    printf("%-12s %8.3f s  %8.3f ms/solve  %6.1f ns/node  "
+           "p1 %llu  p2 %llu  mean length %.2f\n",
+           name, result.seconds, 1000.0 * result.seconds / num_cubes,
+           1e9 * result.seconds / (nodes ? nodes : 1),
+           (unsigned long long)result.phase1_nodes,
+           (unsigned long long)result.phase2_nodes,
+           (double)result.total_length / num_cubes);
+    bench_print_counters("per solve", result.counts, num_cubes);
+    bench_print_counters("per node", result.counts, nodes);
+}
+
+/******************************************************************************
+* Function:  bench_repeat
+*
+* Purpose:   Makes a number of runs a number of times and reports the
+*            results.
+*
+* Params:    runs      - The runs to make.
+*            repeat    - The number of times to make each run.
+*            num_cubes - The number of cubes solved by each run.
+*            series    - List of results which the results of each run are
+*                        added to, in the same order.
+*
+* Returns:   Nothing.
+*
+* Operation: Makes every run once in turn, and then does so again until each
+*            has been made the given number of times, so that any drift in
+*            the speed of the host while the benchmark runs falls on every
+*            run alike, rather than on whichever runs last. Each run is then
+*            reported with the median of the times taken, or the lower of
+*            the two middle times for an even number. The nodes and lengths
+*            reported are those of the first time, and a warning is printed
+*            if a deterministic run visits different nodes on a later time.
+******************************************************************************/
+static void bench_repeat(std::vector<BenchRun>& runs, int repeat,
+                         int num_cubes, std::vector<BenchSeries>& series)
+{
+    size_t first = series.size();
+    for (int ii = 0; ii < repeat; ++ii)
+    {
+        for (size_t jj = 0; jj < runs.size(); ++jj)
+        {
+            BenchResult result = runs[jj].run();
+            if (ii == 0)
+            {
+                series.push_back({runs[jj].name, runs[jj].deterministic,
+                                  result, {}});
+            }
+
+            BenchSeries& times = series[first + jj];
+            times.seconds.push_back(result.seconds);
+            if (times.deterministic &&
+                (result.phase1_nodes != times.result.phase1_nodes ||
+                 result.phase2_nodes != times.result.phase2_nodes ||
+                 result.total_length != times.result.total_length))
+            {
+                printf("Warning: %s visited different nodes on repeat %d\n",
+                       times.name, ii + 1);
+            }
+        }
+    }
+
+    for (size_t jj = first; jj < series.size(); ++jj)
+    {
+        std::vector<double> sorted(series[jj].seconds);
+        std::sort(sorted.begin(), sorted.end());
+        series[jj].result.seconds = sorted[(sorted.size() - 1) / 2];
+        bench_report(series[jj].name, series[jj].result, num_cubes);
+    }
+}
+
+/******************************************************************************
+* Function:  bench_host
+*
+* Purpose:   Describes the host the benchmark is running on.
+*
+* Params:    None.
+*
+* Returns:   The host name, the model of the CPU, and the number of CPUs.
+*
+* Operation: Reads the model from the first "model name" line of
+*            /proc/cpuinfo, and leaves it empty if there is none.
+******************************************************************************/
+static BenchHost bench_host()
+{
+    BenchHost host;
+    char name[256] = "";
+    if (gethostname(name, sizeof(name) - 1) == 0)
+    {
+        host.name = name;
+    }
+    host.cpus = std::thread::hardware_concurrency();
+
+    FILE* file = fopen("/proc/cpuinfo", "r");
+    if (file != nullptr)
+    {
+        char line[512];
+        while (fgets(line, sizeof(line), file) != nullptr)
+        {
+            const char* colon = strchr(line, ':');
+            if (strncmp(line, "model name", 10) == 0 && colon != nullptr)
+            {
+                host.cpu = colon + 1 + strspn(colon + 1, " \t");
+                host.cpu.erase(host.cpu.find_last_not_of(" \t\r\n") + 1);
+                break;
+            }
+        }
+        fclose(file);
+    }
+
+    // The JSON file is written without escapes.
+    for (std::string* text : {&host.name, &host.cpu})
+    {
+        std::replace(text->begin(), text->end(), '"', '\'');
+        std::replace(text->begin(), text->end(), '\\', '/');
+    }
+    return host;
+}
+
+/******************************************************************************
+* Function:  bench_write_json
+*
+* Purpose:   Writes the settings and results of the benchmark to a file.
+*
+* Params:    path      - The file to write to.
+*            settings  - The settings which affect the nodes visited.
+*            host      - The host the benchmark ran on.
+*            num_cubes - The number of cubes solved by each run.
+*            series    - The results of each run.
+*
+* Returns:   True if the file was written, and false otherwise.
+*
+* Operation: Writes a JSON object holding the settings and the host, and for
+*            each run its
+*            node counts and total solution length, which are exact, and
+*            every time taken, together with the solves per second at the
+*            median time and the average counts of any open counters.
+******************************************************************************/
+static bool bench_write_json(const char* path, const char* settings,
+                             BenchHost& host, int num_cubes,
+                             std::vector<BenchSeries>& series)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"settings\": \"%s\",\n  \"cubes\": %d,\n"
+                  "  \"host\": {\"name\": \"%s\", \"cpu\": \"%s\", "
+                  "\"cpus\": %u},\n  \"runs\": [", settings, num_cubes,
+            host.name.c_str(), host.cpu.c_str(), host.cpus);
+    for (size_t ii = 0; ii < series.size(); ++ii)
+    {
+        BenchResult& result = series[ii].result;
+        fprintf(file, "%s\n    {\n      \"name\": \"%s\",\n"
+                      "      \"deterministic\": %s,\n"
+                      "      \"phase1_nodes\": %llu,\n"
+                      "      \"phase2_nodes\": %llu,\n"
+                      "      \"total_length\": %d,\n"
+                      "      \"mean_length\": %.4f,\n"
+                      "      \"solves_per_second\": %.4f,\n"
+                      "      \"seconds\": [",
+                (ii == 0) ? "" : ",", series[ii].name,
+                series[ii].deterministic ? "true" : "false",
+                (unsigned long long)result.phase1_nodes,
+                (unsigned long long)result.phase2_nodes,
+                result.total_length,
+                (double)result.total_length / num_cubes,
+                num_cubes / (result.seconds > 0.0 ? result.seconds : 1e-9));
+        for (size_t jj = 0; jj < series[ii].seconds.size(); ++jj)
+        {
+            fprintf(file, "%s%.6f", (jj == 0) ? "" : ", ",
+                    series[ii].seconds[jj]);
+        }
+        fprintf(file, "],\n      \"counters_per_solve\": {");
+
+        bool first = true;
+        for (int jj = 0; jj < BENCH_NUM_COUNTERS; ++jj)
+        {
+            if (bench_counter_fds[jj] >= 0)
+            {
+                fprintf(file, "%s\"%s\": %.6g", first ? "" : ", ",
+                        bench_counters[jj].name,
+                        result.counts[jj] / num_cubes);
+                first = false;
+            }
+        }
+        fprintf(file, "}\n    }");
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    return fclose(file) == 0;
+}
+
+/******************************************************************************
+* Function:  bench_print_nodes
+*
+* Purpose:   Prints the placement of some memory on the NUMA nodes.
+*
+* Params:    node_bytes - The number of bytes on each node.
+*
+* Returns:   Nothing.
+*
+* Operation: Prints the megabytes on each node which holds any, and ends the
+*            line.
+******************************************************************************/
+static void bench_print_nodes(std::vector<size_t>& node_bytes)
+{
+    for (size_t node = 0; node < node_bytes.size(); ++node)
+    {
+        if (node_bytes[node] > 0)
+        {
+            printf("  node %zu: %.1f MB", node, node_bytes[node] / 1048576.0);
+        }
+    }
+    printf("\n");
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the benchmark.
+*
+* Params:    argc, argv - The command line options described at the top of
+*                         this file.
+*
+* Returns:   0 on success, 1 if the options are invalid.
+*
+* Operation: Fills the tables that have been asked for, then solves the
+*            scrambles once without prefetching and once with it, and then
+*            with a pipeline and a batch solver if they were asked for.
+******************************************************************************/
+int main(int argc, char** argv)
+{
+    int num_cubes = 20;
+    unsigned seed = 1;
+    int target = 21;
+    bool fused = false;
+    bool order = false;
+    bool batch = false;
+    bool phase2 = false;
+    int tt_bits = 0;
+    int endgame_depth = -1;
+    int near_depth = -1;
+    int producers = 0;
+    int consumers = 0;
+    int p1_depth = 0;
+    int p2_depth = 0;
+    int budget_mb = -1;
+    bool huge_pages = true;
+    int numa_policy = CUBE_NUMA_LOCAL;
+    const char* trace_path = nullptr;
+    bool counters = true;
+    int repeat = 1;
+    const char* json_path = nullptr;
+
+    for (int ii = 1; ii < argc; ++ii)
+    {
+        if (strcmp(argv[ii], "--fused") == 0)
+        {
+            fused = true;
+        }
+        else if (strcmp(argv[ii], "--order") == 0)
+        {
+            order = true;
+        }
+        else if (strcmp(argv[ii], "--batch") == 0)
+        {
+            batch = true;
+        }
+        else if (strcmp(argv[ii], "--phase2") == 0)
+        {
+            phase2 = true;
+        }
+        else if (strcmp(argv[ii], "--no-counters") == 0)
+        {
+            counters = false;
+        }
+        else if (strcmp(argv[ii], "--no-huge-pages") == 0)
+        {
+            huge_pages = false;
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--numa") == 0)
+        {
+            const char* policy = argv[++ii];
+            if (strcmp(policy, "local") == 0)
+            {
+                numa_policy = CUBE_NUMA_LOCAL;
+            }
+            else if (strcmp(policy, "interleave") == 0)
+            {
+                numa_policy = CUBE_NUMA_INTERLEAVE;
+            }
+            else if (strcmp(policy, "replicate") == 0)
+            {
+                numa_policy = CUBE_NUMA_REPLICATE;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown NUMA policy %s\n", policy);
+                return 1;
+            }
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--repeat") == 0)
+        {
+            repeat = std::max(atoi(argv[++ii]), 1);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--json") == 0)
+        {
+            json_path = argv[++ii];
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--trace") == 0)
+        {
+            trace_path = argv[++ii];
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--cubes") == 0)
+        {
+            num_cubes = atoi(argv[++ii]);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--seed") == 0)
+        {
+            seed = strtoul(argv[++ii], nullptr, 10);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--target") == 0)
+        {
+            target = atoi(argv[++ii]);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--endgame") == 0)
+        {
+            endgame_depth = atoi(argv[++ii]);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--near") == 0)
+        {
+            near_depth = atoi(argv[++ii]);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--budget") == 0)
+        {
+            budget_mb = atoi(argv[++ii]);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--tt") == 0)
+        {
+            tt_bits = atoi(argv[++ii]);
+        }
+        else if (ii + 2 < argc && strcmp(argv[ii], "--pipeline") == 0)
+        {
+            producers = atoi(argv[++ii]);
+            consumers = atoi(argv[++ii]);
+        }
+        else if (ii + 2 < argc && strcmp(argv[ii], "--automaton") == 0)
+        {
+            p1_depth = atoi(argv[++ii]);
+            p2_depth = atoi(argv[++ii]);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[ii]);
+            return 1;
+        }
+    }
+
+    // Fill the tables, timing and counting the whole process.
+    if (counters)
+    {
+        bench_open_counters();
+    }
+    double fill_counts[BENCH_NUM_COUNTERS] = {0.0};
+    double counts[BENCH_NUM_COUNTERS];
+    bench_read_counters(counts);
+
+    cube_set_memory_policy(huge_pages, numa_policy);
+    double start = bench_seconds();
+    if (budget_mb >= 0)
+    {
+        int tier = cube_fill_for_budget((size_t)budget_mb << 20);
+        printf("Tier %d chosen for a budget of %d MB\n", tier, budget_mb);
+    }
+    cube_fill_all_trans_tables();
+    cube_fill_all_pruning_tables();
+    if (fused)
+    {
+        cube_fill_fused_pruning_tables();
+    }
+    if (endgame_depth >= 0)
+    {
+        // The optional tables may each use whatever the tables already
+        // filled leave of the budget.
+        size_t endgame_budget = SIZE_MAX;
+        if (budget_mb >= 0)
+        {
+            endgame_budget = cube_budget_left((size_t)budget_mb << 20,
+                                              "endgame_table");
+        }
+        int filled = cube_fill_endgame_table(endgame_depth, endgame_budget);
+        if (filled < endgame_depth)
+        {
+            printf("End-game table filled only to depth %d\n", filled);
+        }
+    }
+    if (near_depth >= 0)
+    {
+        size_t near_budget = SIZE_MAX;
+        if (budget_mb >= 0)
+        {
+            near_budget = cube_budget_left((size_t)budget_mb << 20,
+                                           "near_table");
+        }
+        int filled = cube_fill_near_table(near_depth, near_budget);
+        if (filled < near_depth)
+        {
+            printf("Near-solved table filled to depth %d to fit the "
+                   "budget\n", filled);
+        }
+    }
+    if (p1_depth > 0 || p2_depth > 0)
+    {
+        cube_create_automata(p1_depth, p2_depth);
+    }
+    printf("Tables filled in %.3f s\n", bench_seconds() - start);
+    bench_add_counters(counts, fill_counts);
+    bench_print_counters("filling", fill_counts, 1.0);
+
+    size_t total_bytes = 0;
+    std::vector<size_t> total_node_bytes;
+    for (CubeTableUsage& usage : cube_table_usage())
+    {
+        printf("  %-18s %12zu bytes", usage.name.c_str(), usage.bytes);
+        bench_print_nodes(usage.node_bytes);
+        total_bytes += usage.bytes;
+
+        total_node_bytes.resize(std::max(total_node_bytes.size(),
+                                         usage.node_bytes.size()), 0);
+        for (size_t node = 0; node < usage.node_bytes.size(); ++node)
+        {
+            total_node_bytes[node] += usage.node_bytes[node];
+        }
+    }
+    printf("  %-18s %12zu bytes", "total", total_bytes);
+    bench_print_nodes(total_node_bytes);
+    printf("  %d NUMA node(s), %zu bytes on reserved huge pages, "
+           "%zu bytes advised for transparent huge pages\n",
+           cube_numa_nodes(), cube_hugetlb_bytes(), cube_advised_bytes());
+
+    // Solve the scrambles with and without prefetching, and with any other
+    // solvers asked for.
+    std::vector<Cube> cubes = bench_scrambles(num_cubes, seed, phase2);
+
+    std::unique_ptr<CubeTrace> trace;
+    if (trace_path != nullptr)
+    {
+        trace.reset(new CubeTrace(20));
+    }
+
+    std::vector<BenchRun> runs;
+    runs.push_back({"no prefetch", true, [&]()
+    {
+        return bench_run(cubes, target, false, order, tt_bits, phase2,
+                         nullptr);
+    }});
+    runs.push_back({"prefetch", true, [&]()
+    {
+        return bench_run(cubes, target, true, order, tt_bits, phase2,
+                         trace.get());
+    }});
+    if (producers > 0)
+    {
+        runs.push_back({"pipeline", false, [&]()
+        {
+            return bench_run_pipeline(cubes, target, producers, consumers);
+        }});
+    }
+    if (batch)
+    {
+        runs.push_back({"batch", true, [&]()
+        {
+            return bench_run_batch(cubes, target);
+        }});
+    }
+
+    std::vector<BenchSeries> series;
+    bench_repeat(runs, repeat, num_cubes, series);
+
+    if (trace)
+    {
+        if (!trace->write_json(trace_path, 1))
+        {
+            fprintf(stderr, "Cannot write %s\n", trace_path);
+            return 1;
+        }
+        printf("%zu events written to %s, %llu dropped\n", trace->size(),
+               trace_path, (unsigned long long)trace->dropped());
+    }
+
+    // Write out the results, with the settings which decide the nodes
+    // visited, so that they are only compared with results of the same.
+    if (json_path != nullptr)
+    {
+        char settings[256];
+        snprintf(settings, sizeof(settings),
+                 "seed %u target %d fused %d order %d phase2 %d tt %d "
+                 "endgame %d near %d budget %d automaton %d %d "
+                 "pipeline %d %d",
+                 seed, target, (int)fused, (int)order, (int)phase2, tt_bits,
+                 endgame_depth, near_depth, budget_mb, p1_depth, p2_depth,
+                 producers, consumers);
+        BenchHost host = bench_host();
+        if (!bench_write_json(json_path, settings, host, num_cubes, series))
+        {
+            fprintf(stderr, "Cannot write %s\n", json_path);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -54,6 +54,76 @@ int binom(int n, int k)
     return num / denom;
 }
 
+/******************************************************************************
+* Function:  inverse_move
+*
+* Purpose:   Calculates the inverse of a single move.
+*
+* Params:    move - The move to invert.
+*
+* Returns:   The move which undoes the given move.
+*
+* Operation: Quarter turns are swapped with their primes, and half turns are
+*            their own inverses.
+******************************************************************************/
+int inverse_move(int move)
+{
+    return 3 * (move / 3) + 2 - (move % 3);
+}
+
+/******************************************************************************
+* Function:  operator==
+*
+* Purpose:   Compares two packed cube states for equality.
+*
+* Params:    key_1, key_2 - The packed cube states to compare.
+*
+* Returns:   True if and only if the two keys describe the same cube state.
+*
+* Operation: Compares the corner and edge words of the two keys.
+******************************************************************************/
+bool operator==(const CubeKey& key_1, const CubeKey& key_2)
+{
+    return key_1.corners == key_2.corners && key_1.edges == key_2.edges;
+}
+
+/******************************************************************************
+* Function:  operator<
+*
+* Purpose:   Gives a total ordering on packed cube states.
+*
+* Params:    key_1, key_2 - The packed cube states to compare.
+*
+* Returns:   True if key_1 comes strictly before key_2 in the ordering.
+*
+* Operation: Compares the corner words first and then the edge words.
+******************************************************************************/
+bool operator<(const CubeKey& key_1, const CubeKey& key_2)
+{
+    return key_1.corners < key_2.corners ||
+           (key_1.corners == key_2.corners && key_1.edges < key_2.edges);
+}
+
+/******************************************************************************
+* Function:  CubeKeyHash::operator()
+*
+* Purpose:   Hashes a packed cube state for use in unordered containers.
+*
+* Params:    key - The packed cube state to hash.
+*
+* Returns:   A hash of the key.
+*
+* Operation: Mixes the two words of the key with a multiply-xorshift step.
+******************************************************************************/
+size_t CubeKeyHash::operator()(const CubeKey& key) const
+{
+    uint64_t hash = key.corners * 0x9E3779B97F4A7C15ULL ^ key.edges;
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 32;
+    return (size_t)hash;
+}
+
 /******************************************************************************
 * Cube class implementation
 ******************************************************************************/
@@ -265,6 +335,142 @@ Cube Cube::perform_move(int move)
     return cube;
 }
 
+/******************************************************************************
+* Function:  Cube::multiply
+*
+* Purpose:   Multiplies this cube by another in the cube group.
+*
+* Params:    other - The cube to multiply by on the right.
+*
+* Returns:   A Cube object holding the result of applying this cube and then
+*            the other cube, so that perform_move(move) is the same as
+*            multiplying by the cube which results from performing that move
+*            on a solved cube.
+*
+* Operation: Composes the permutations and adds the orientations. Corner
+*            orientations in the range 3..5 describe mirrored corners, which
+*            only occur in the cubes describing reflections of the whole cube
+*            and in products with them, and these combine by subtraction
+*            rather than addition.
+******************************************************************************/
+Cube Cube::multiply(Cube other)
+{
+    std::vector<int> new_corner_permutation(corner_permutation.size());
+    std::vector<int> new_corner_orientation(corner_orientation.size());
+    std::vector<int> new_edge_permutation(edge_permutation.size());
+    std::vector<int> new_edge_orientation(edge_orientation.size());
+
+    // Combine the corners, taking care over the mirrored orientations.
+    for (size_t ii = 0; ii < corner_permutation.size(); ++ii)
+    {
+        int from = other.corner_permutation[ii];
+        new_corner_permutation[ii] = corner_permutation[from];
+
+        int ori_a = corner_orientation[from];
+        int ori_b = other.corner_orientation[ii];
+        int ori;
+        if (ori_a < 3 && ori_b < 3)
+        {
+            ori = (ori_a + ori_b) % 3;
+        }
+        else if (ori_a < 3)
+        {
+            ori = 3 + (ori_a + ori_b) % 3;
+        }
+        else if (ori_b < 3)
+        {
+            ori = 3 + (ori_a - ori_b + 3) % 3;
+        }
+        else
+        {
+            ori = (ori_a - ori_b + 3) % 3;
+        }
+        new_corner_orientation[ii] = ori;
+    }
+
+    // Combine the edges.
+    for (size_t ii = 0; ii < edge_permutation.size(); ++ii)
+    {
+        int from = other.edge_permutation[ii];
+        new_edge_permutation[ii] = edge_permutation[from];
+        new_edge_orientation[ii] = (edge_orientation[from] +
+                                    other.edge_orientation[ii]) % 2;
+    }
+
+    Cube cube(new_corner_permutation, new_corner_orientation,
+              new_edge_permutation,   new_edge_orientation);
+    return cube;
+}
+
+/******************************************************************************
+* Function:  Cube::inverse
+*
+* Purpose:   Calculates the inverse of this cube in the cube group.
+*
+* Params:    None.
+*
+* Returns:   A Cube object which, multiplied by this one, gives the solved cube.
+*
+* Operation: Inverts the permutations and negates the orientations. Mirrored
+*            corner orientations are their own inverses.
+******************************************************************************/
+Cube Cube::inverse()
+{
+    std::vector<int> new_corner_permutation(corner_permutation.size());
+    std::vector<int> new_corner_orientation(corner_orientation.size());
+    std::vector<int> new_edge_permutation(edge_permutation.size());
+    std::vector<int> new_edge_orientation(edge_orientation.size());
+
+    for (size_t ii = 0; ii < corner_permutation.size(); ++ii)
+    {
+        int to = corner_permutation[ii];
+        int ori = corner_orientation[ii];
+        new_corner_permutation[to] = ii;
+        new_corner_orientation[to] = (ori >= 3) ? ori : (3 - ori) % 3;
+    }
+
+    for (size_t ii = 0; ii < edge_permutation.size(); ++ii)
+    {
+        int to = edge_permutation[ii];
+        new_edge_permutation[to] = ii;
+        new_edge_orientation[to] = edge_orientation[ii];
+    }
+
+    Cube cube(new_corner_permutation, new_corner_orientation,
+              new_edge_permutation,   new_edge_orientation);
+    return cube;
+}
+
+/******************************************************************************
+* Function:  Cube::key
+*
+* Purpose:   Packs the complete state of this cube into a compact key.
+*
+* Params:    None.
+*
+* Returns:   A CubeKey which is equal for two cubes if and only if the cubes
+*            are in the same state.
+*
+* Operation: Stores 3 bits of permutation and 3 bits of orientation for each
+*            corner in one word, and 4 bits of permutation and 1 bit of
+*            orientation for each edge in the other.
+******************************************************************************/
+CubeKey Cube::key()
+{
+    CubeKey ret = {0, 0};
+    for (size_t ii = 0; ii < corner_permutation.size(); ++ii)
+    {
+        ret.corners = (ret.corners << 6) |
+                      (corner_permutation[ii] << 3) | corner_orientation[ii];
+    }
+    for (size_t ii = 0; ii < edge_permutation.size(); ++ii)
+    {
+        ret.edges = (ret.edges << 5) |
+                    (edge_permutation[ii] << 1) | edge_orientation[ii];
+    }
+    return ret;
+}
+
 /******************************************************************************
 * Implementation of normal coordinates, that is, integer values which are
 * calculated directly from the cube state.
@@ -634,4 +840,29 @@ int Cube::coord_ud_unsorted()
 int Cube::coord_ud_permutation()
 {
     return ud_permutation_calc(coord_ud_sorted());
-}
\ No newline at end of file
+}
+
+/******************************************************************************
+* Function:  Cube::coords
+*
+* Purpose:   Calculates the coordinates which the solver starts from.
+*
+* Params:    None.
+*
+* Returns:   The corner orientation, edge orientation and corner permutation
+*            coordinates, and the three sorted slice coordinates, which
+*            between them determine the complete state of the cube.
+*
+* Operation: Calls the function for each coordinate in turn.
+******************************************************************************/
+CubeCoords Cube::coords()
+{
+    CubeCoords result;
+    result.co = coord_corner_orientation();
+    result.eo = coord_edge_orientation();
+    result.cp = coord_corner_permutation();
+    result.ud_sorted = coord_ud_sorted();
+    result.rl_sorted = coord_rl_sorted();
+    result.fb_sorted = coord_fb_sorted();
+    return result;
+}
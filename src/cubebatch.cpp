@@ -0,0 +1,320 @@
+/******************************************************************************
+* File:    cubebatch.cpp
+*
+* Purpose: Implementation of the CubeBatch class. Each of a fixed number of
+*          lanes works through the phase 1 search of one cube with a
+*          CubeWalker. On every step, each lane expands one position,
+*          and the transition and pruning table lookups for the children of
+*          all the lanes are made together, so that their cache misses
+*          overlap instead of following one another. When a lane finds a
+*          phase 1 solution, phase 2 is searched for it straight away by the
+*          lane's own CubeSolver, and when a lane finishes its cube, it moves
+*          on to the next cube which has not yet been started.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <cube.h>
+#include <cubebatch.h>
+#include <cubephase.h>
+#include <cubesolver.h>
+#include <cubetables.h>
+#include <cubewalker.h>
+
+/******************************************************************************
+* CubeBatch class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeBatch::CubeBatch
+*
+* Purpose:   Constructor for the CubeBatch class.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Sets the default target length of 0, so that each cube is
+*            searched until no shorter solution can be found.
+******************************************************************************/
+CubeBatch::CubeBatch()
+{
+    target_length = 0;
+    num_phase1_nodes = 0;
+    num_phase2_nodes = 0;
+}
+
+/******************************************************************************
+* Function:  CubeBatch::set_target_length
+*
+* Purpose:   Sets the length of solution which is good enough to stop at.
+*
+* Params:    length - As for CubeSolver::set_target_length.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply store the value.
+******************************************************************************/
+void CubeBatch::set_target_length(int length)
+{
+    target_length = length;
+}
+
+/******************************************************************************
+* Function:  CubeBatch::set_cancel
+*
+* Purpose:   Sets the token which cancels the search.
+*
+* Params:    token - A token whose cancel function will stop any call to solve
+*                    which is running or is later made.
+*
+* Returns:   Nothing.
+*
+* Operation: Stores the token, which each lane's solver is also given. Each
+*            lane notices within CUBE_CANCEL_INTERVAL nodes and gives up its
+*            cube, and no more cubes are started, so that solve returns the
+*            best solution found so far for each cube, which is empty for
+*            those not yet started.
+******************************************************************************/
+void CubeBatch::set_cancel(const CubeCancel& token)
+{
+    cancel_token = token;
+}
+
+/******************************************************************************
+* Function:  CubeBatch::start_lane
+*
+* Purpose:   Gives a lane the next cube to solve.
+*
+* Params:    lane  - The lane to start.
+*            cubes - The cubes being solved.
+*
+* Returns:   Nothing.
+*
+* Operation: Sets up the lane's solver for the next cube, and starts the
+*            lane's walker on it. If there are no cubes left, the lane is
+*            marked as idle with a cube index of -1.
+******************************************************************************/
+void CubeBatch::start_lane(int lane, std::vector<Cube>& cubes)
+{
+    while (next_cube < (int)cubes.size() && !cancel_token.cancelled())
+    {
+        int cube_index = next_cube++;
+        CubeSolver& solver = lane_solver[lane];
+
+        solver = CubeSolver(cubes[cube_index]);
+        solver.set_target_length(target_length);
+        solver.set_cancel(cancel_token);
+        if (!lane_walker[lane].start(solver, [](std::vector<int>&) {}))
+        {
+            // The near-solved table has already solved this cube.
+            results[cube_index] = solver.best_solution();
+            continue;
+        }
+
+        lane_cube[lane] = cube_index;
+        return;
+    }
+
+    lane_cube[lane] = -1;
+}
+
+/******************************************************************************
+* Function:  CubeBatch::finish_lane
+*
+* Purpose:   Records the result of the cube in a lane, and starts the next.
+*
+* Params:    lane  - The lane which has finished.
+*            cubes - The cubes being solved.
+*
+* Returns:   Nothing.
+*
+* Operation: Stores the best solution found for the lane's cube and adds its
+*            node counts to the totals.
+******************************************************************************/
+void CubeBatch::finish_lane(int lane, std::vector<Cube>& cubes)
+{
+    CubeSolver& solver = lane_solver[lane];
+    results[lane_cube[lane]] = solver.best_solution();
+    num_phase1_nodes += solver.phase1_nodes();
+    num_phase2_nodes += solver.phase2_nodes();
+
+    start_lane(lane, cubes);
+}
+
+/******************************************************************************
+* Function:  CubeBatch::next_node
+*
+* Purpose:   Chooses the next position for a lane to expand.
+*
+* Params:    lane  - The lane to advance.
+*            cubes - The cubes being solved.
+*
+* Returns:   True if the lane has a position to expand, in which case it is
+*            stored in the node arrays, or false if the lane has become idle.
+*
+* Operation: Asks the lane's walker for the next position. Once the search of
+*            the lane's cube is over, the lane moves on to the next cube.
+******************************************************************************/
+bool CubeBatch::next_node(int lane, std::vector<Cube>& cubes)
+{
+    while (lane_cube[lane] != -1)
+    {
+        if (lane_walker[lane].next_node(node_co[lane], node_eo[lane],
+                                        node_ud_pos[lane], node_state[lane]))
+        {
+            return true;
+        }
+        finish_lane(lane, cubes);
+    }
+
+    return false;
+}
+
+/******************************************************************************
+* Function:  CubeBatch::solve
+*
+* Purpose:   Finds solutions to a list of cubes.
+*
+* Params:    cubes - The cubes to solve.
+*
+* Returns:   The best solution found for each cube, in the same order.
+*
+* Operation: Starts a cube in each lane, and then repeatedly lets every lane
+*            choose a position to expand, looks up the coordinates and the
+*            pruning values of the children of all of those positions
+*            together, and pushes a frame holding the children which survive
+*            the pruning onto each lane's stack.
+******************************************************************************/
+std::vector<std::vector<int>> CubeBatch::solve(std::vector<Cube>& cubes)
+{
+    cube_fill_phase1_tables();
+    cube_fill_phase2_tables();
+
+    results.assign(cubes.size(), std::vector<int>());
+    next_cube = 0;
+    num_phase1_nodes = 0;
+    num_phase2_nodes = 0;
+
+    for (int lane = 0; lane < CUBE_BATCH_LANES; ++lane)
+    {
+        start_lane(lane, cubes);
+    }
+
+    while (true)
+    {
+        // Choose the position which each lane will expand next, and list
+        // its children.
+        int num_children = 0;
+        bool active[CUBE_BATCH_LANES];
+        bool any_active = false;
+
+        for (int lane = 0; lane < CUBE_BATCH_LANES; ++lane)
+        {
+            active[lane] = next_node(lane, cubes);
+            if (!active[lane])
+            {
+                continue;
+            }
+            any_active = true;
+
+            uint32_t allowed = cube_p1_automaton.moves(node_state[lane]);
+            lane_walker[lane].count_children(allowed);
+
+            for (uint32_t moves = allowed; moves != 0; )
+            {
+                child_lane[num_children] = lane;
+                child_move[num_children] = cube_next_move(moves);
+                parent_co[num_children] = node_co[lane];
+                parent_eo[num_children] = node_eo[lane];
+                parent_ud_pos[num_children] = node_ud_pos[lane];
+                ++num_children;
+            }
+        }
+
+        if (!any_active)
+        {
+            break;
+        }
+
+        // Look up the children of all the lanes together.
+        cube_co_trans.gather(parent_co, child_move, num_children, child_co);
+        cube_eo_trans.gather(parent_eo, child_move, num_children, child_eo);
+        cube_ud_unsorted_trans.gather(parent_ud_pos, child_move, num_children,
+                                      child_ud_pos);
+        cube_co_eo_prune.gather(child_co, child_eo, num_children,
+                                co_eo_bound);
+        cube_co_ud_prune.gather(child_co, child_ud_pos, num_children,
+                                co_ud_bound);
+        cube_eo_ud_prune.gather(child_eo, child_ud_pos, num_children,
+                                eo_ud_bound);
+
+        // Push a new frame for each lane, holding the children which can
+        // still reach a phase 1 solution within the lane's depth.
+        for (int lane = 0; lane < CUBE_BATCH_LANES; ++lane)
+        {
+            if (active[lane])
+            {
+                lane_walker[lane].begin_frame();
+            }
+        }
+
+        for (int ii = 0; ii < num_children; ++ii)
+        {
+            int lane = child_lane[ii];
+            if (std::max({co_eo_bound[ii], co_ud_bound[ii],
+                          eo_ud_bound[ii]}) > lane_walker[lane].child_depth())
+            {
+                continue;
+            }
+
+            int state = cube_p1_automaton.next(node_state[lane],
+                                               child_move[ii]);
+            lane_walker[lane].push_child(child_co[ii], child_eo[ii],
+                                         child_ud_pos[ii], child_move[ii],
+                                         state);
+        }
+    }
+
+    return results;
+}
+
+/******************************************************************************
+* Function:  CubeBatch::phase1_nodes
+*
+* Purpose:   Getter for the number of phase 1 nodes visited by the last call
+*            to solve.
+*
+* Params:    None.
+*
+* Returns:   The total over all the cubes, counted in the same way as
+*            CubeSolver::phase1_nodes.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubeBatch::phase1_nodes()
+{
+    return num_phase1_nodes;
+}
+
+/******************************************************************************
+* Function:  CubeBatch::phase2_nodes
+*
+* Purpose:   Getter for the number of phase 2 nodes visited by the last call
+*            to solve.
+*
+* Params:    None.
+*
+* Returns:   The total over all the cubes.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubeBatch::phase2_nodes()
+{
+    return num_phase2_nodes;
+}
@@ -0,0 +1,188 @@
+/******************************************************************************
+* File:    cubecache.cpp
+*
+* Purpose: Implementation of the CubeCache class, which remembers solutions
+*          to recently solved cubes so that repeated or symmetric positions
+*          do not need to be searched again.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include <cube.h>
+#include <cubecache.h>
+#include <cubesolver.h>
+#include <cubesym.h>
+
+/******************************************************************************
+* CubeCache class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeCache::CubeCache
+*
+* Purpose:   Constructor for the CubeCache class.
+*
+* Params:    capacity   - The maximum number of solutions to keep.
+*            num_shards - The number of independently locked parts to split
+*                         the cache into, to reduce contention between
+*                         threads.
+*            target_len - The target length passed to the CubeSolver when a
+*                         solution is not already in the cache.
+*
+* Returns:   Nothing.
+*
+* Operation: Splits the capacity evenly between the shards, of which there
+*            is always at least one. The symmetry tables must have been
+*            created with cube_create_symmetries, and the transition and
+*            pruning tables filled, before the cache is used.
+******************************************************************************/
+CubeCache::CubeCache(int capacity, int num_shards, int target_len)
+    : shards(std::max(num_shards, 1)), num_hits(0), num_misses(0)
+{
+    int count = (int)shards.size();
+    shard_capacity = (capacity + count - 1) / count;
+    target_length = target_len;
+}
+
+/******************************************************************************
+* Function:  CubeCache::lookup
+*
+* Purpose:   Looks for a solution in one shard of the cache.
+*
+* Params:    shard    - The shard which the key belongs to.
+*            key      - The key of the canonical cube to look up.
+*            solution - Output parameter holding the solution, if found.
+*
+* Returns:   True if the solution was in the cache, false otherwise.
+*
+* Operation: Under the shard's lock, finds the entry and moves it to the
+*            front of the least-recently-used list.
+******************************************************************************/
+bool CubeCache::lookup(Shard& shard, CubeKey key, std::vector<int>& solution)
+{
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    auto found = shard.index.find(key);
+    if (found == shard.index.end())
+    {
+        return false;
+    }
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    solution = found->second->second;
+    return true;
+}
+
+/******************************************************************************
+* Function:  CubeCache::insert
+*
+* Purpose:   Stores a solution in one shard of the cache.
+*
+* Params:    shard    - The shard which the key belongs to.
+*            key      - The key of the canonical cube being stored.
+*            solution - The solution to the canonical cube.
+*
+* Returns:   Nothing.
+*
+* Operation: Under the shard's lock, adds the entry at the front of the
+*            least-recently-used list, evicting from the back if the shard
+*            is full. If another thread stored the same key in the meantime,
+*            its entry is kept.
+******************************************************************************/
+void CubeCache::insert(Shard& shard, CubeKey key, std::vector<int>& solution)
+{
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    if (shard.index.count(key) > 0)
+    {
+        return;
+    }
+
+    shard.entries.emplace_front(key, solution);
+    shard.index[key] = shard.entries.begin();
+
+    if ((int)shard.entries.size() > shard_capacity)
+    {
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+    }
+}
+
+/******************************************************************************
+* Function:  CubeCache::solve
+*
+* Purpose:   Finds a solution to a cube, using the cache where possible.
+*
+* Params:    cube - The cube to solve.
+*
+* Returns:   The moves of a solution to the cube.
+*
+* Operation: Reduces the cube to its canonical representative under symmetry
+*            and inversion, and looks that up. On a miss the canonical cube is
+*            solved with a CubeSolver, without holding any lock, and the
+*            result is stored. Either way the solution to the canonical cube
+*            is then translated back into a solution to the original cube.
+******************************************************************************/
+std::vector<int> CubeCache::solve(Cube cube)
+{
+    Cube canonical;
+    int transform = cube_canonical(cube, canonical);
+    CubeKey key = canonical.key();
+    Shard& shard = shards[CubeKeyHash()(key) % shards.size()];
+
+    std::vector<int> solution;
+    if (lookup(shard, key, solution))
+    {
+        ++num_hits;
+    }
+    else
+    {
+        ++num_misses;
+
+        CubeSolver solver(canonical);
+        solver.set_target_length(target_length);
+        solver.solve([](std::vector<int>&) {});
+        solution = solver.best_solution();
+
+        insert(shard, key, solution);
+    }
+
+    return cube_uncanonical_solution(solution, transform);
+}
+
+/******************************************************************************
+* Function:  CubeCache::hits
+*
+* Purpose:   Getter for the number of lookups which found a solution.
+*
+* Params:    None.
+*
+* Returns:   The number of cache hits so far.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubeCache::hits()
+{
+    return num_hits;
+}
+
+/******************************************************************************
+* Function:  CubeCache::misses
+*
+* Purpose:   Getter for the number of lookups which had to search.
+*
+* Params:    None.
+*
+* Returns:   The number of cache misses so far.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubeCache::misses()
+{
+    return num_misses;
+}
@@ -0,0 +1,358 @@
+/******************************************************************************
+* File:    cubeendgame.cpp
+*
+* Purpose: Implementation of the CubeEndgame class, a hash table holding the
+*          exact phase 2 distance from solved of every phase 2 position within
+*          some number of moves of solved.
+*
+*          Positions are described by the phase 2 coordinates cp, ep and
+*          ud_perm, which are packed into the low 37 bits of each entry, with
+*          the distance stored in the top byte.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <vector>
+
+#include <cube.h>
+#include <cubeendgame.h>
+#include <cubememory.h>
+#include <cubephase.h>
+#include <cubetables.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define ENDGAME_EMPTY        (~0ULL)
+#define ENDGAME_KEY_MASK     ((1ULL << 56) - 1)
+#define ENDGAME_INITIAL_SIZE (1 << 16)
+#define ENDGAME_MAX_DEPTH    9
+
+/******************************************************************************
+* The number of phase 2 positions at each phase 2 distance from solved, from
+* which the memory needed to fill the table is worked out.
+******************************************************************************/
+static const uint64_t endgame_positions[ENDGAME_MAX_DEPTH + 1] =
+    {1, 10, 67, 456, 3079, 19948, 123074, 736850, 4185118, 22630733};
+
+/******************************************************************************
+* Helper functions
+******************************************************************************/
+
+/******************************************************************************
+* Function:  endgame_key
+*
+* Purpose:   Packs the phase 2 coordinates of a position into a key.
+*
+* Params:    cp, ep, ud_perm - The phase 2 coordinates of the position.
+*
+* Returns:   The packed key.
+*
+* Operation: cp and ep each fit in 16 bits and ud_perm in 5 bits.
+******************************************************************************/
+static uint64_t endgame_key(int cp, int ep, int ud_perm)
+{
+    return (uint64_t)cp | ((uint64_t)ep << 16) | ((uint64_t)ud_perm << 32);
+}
+
+/******************************************************************************
+* CubeEndgame class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeEndgame::CubeEndgame
+*
+* Purpose:   Constructor for the CubeEndgame class.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Creates an empty table, which will not be consulted by the
+*            solver until it has been filled.
+******************************************************************************/
+CubeEndgame::CubeEndgame()
+{
+    num_entries = 0;
+    max_depth = -1;
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::find_slot
+*
+* Purpose:   Finds the slot in the table for a key.
+*
+* Params:    key - The packed key.
+*
+* Returns:   The index of the slot holding the key, or of the empty slot where
+*            it would be inserted.
+*
+* Operation: Open addressing with linear probing from a hash of the key.
+******************************************************************************/
+size_t CubeEndgame::find_slot(uint64_t key)
+{
+    size_t mask = table.size() - 1;
+    size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 24) & mask;
+
+    while (table[slot] != ENDGAME_EMPTY &&
+           (table[slot] & ENDGAME_KEY_MASK) != key)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::grow
+*
+* Purpose:   Doubles the size of the table.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Reinserts every entry into a table of twice the size.
+******************************************************************************/
+void CubeEndgame::grow()
+{
+    std::vector<uint64_t, CubeAllocator<uint64_t>> old_table;
+    old_table.swap(table);
+    table.assign(old_table.size() * 2, ENDGAME_EMPTY);
+
+    for (uint64_t entry : old_table)
+    {
+        if (entry != ENDGAME_EMPTY)
+        {
+            table[find_slot(entry & ENDGAME_KEY_MASK)] = entry;
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::depth
+*
+* Purpose:   Getter for the depth to which the table has been filled.
+*
+* Params:    None.
+*
+* Returns:   The maximum distance from solved of the positions in the table,
+*            or -1 if the table has not been filled.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+int CubeEndgame::depth()
+{
+    return max_depth;
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::size
+*
+* Purpose:   Calculates the number of positions in the table.
+*
+* Params:    None.
+*
+* Returns:   The number of positions stored.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+size_t CubeEndgame::size()
+{
+    return num_entries;
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::bytes
+*
+* Purpose:   Calculates the memory used by the table.
+*
+* Params:    None.
+*
+* Returns:   The number of bytes allocated for the table, all of which have
+*            been written once it is filled.
+*
+* Operation: Multiplies the number of slots by their size.
+******************************************************************************/
+size_t CubeEndgame::bytes()
+{
+    return table.capacity() * sizeof(uint64_t);
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::fill_bytes
+*
+* Purpose:   Works out the most memory which filling the table needs.
+*
+* Params:    depth_limit - The depth to fill the table to.
+*
+* Returns:   The peak number of bytes taken while the table is filled, or
+*            SIZE_MAX if the depth is too large for the number of positions to
+*            be known.
+*
+* Operation: Follows the growth of the table from its initial size, doubling
+*            it whenever it is over half full, as fill does. At the peak, the
+*            table is being doubled with the old table still held, while the
+*            frontiers of the last two depths of the search, at three ints a
+*            position, are held too.
+******************************************************************************/
+size_t CubeEndgame::fill_bytes(int depth_limit)
+{
+    if (depth_limit > ENDGAME_MAX_DEPTH)
+    {
+        return SIZE_MAX;
+    }
+
+    uint64_t entries = 0;
+    for (int depth = 0; depth <= depth_limit; ++depth)
+    {
+        entries += endgame_positions[depth];
+    }
+
+    uint64_t slots = ENDGAME_INITIAL_SIZE;
+    while (2 * entries > slots)
+    {
+        slots *= 2;
+    }
+
+    uint64_t frontier = endgame_positions[depth_limit];
+    if (depth_limit > 0)
+    {
+        frontier += endgame_positions[depth_limit - 1];
+    }
+
+    uint64_t bytes = slots * sizeof(uint64_t) * 3 / 2 +
+                     frontier * 3 * sizeof(int);
+    return (bytes > SIZE_MAX) ? SIZE_MAX : (size_t)bytes;
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::placement
+*
+* Purpose:   Reports which NUMA nodes hold the table.
+*
+* Params:    node_bytes - Array of the number of bytes on each node, which
+*                         the bytes of this table are added to.
+*
+* Returns:   Nothing.
+*
+* Operation: Asks the kernel where the pages of the table are.
+******************************************************************************/
+void CubeEndgame::placement(std::vector<size_t>& node_bytes)
+{
+    cube_memory_placement(table.data(), table.capacity() * sizeof(uint64_t),
+                          node_bytes);
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::operator()
+*
+* Purpose:   Looks up a position in the table.
+*
+* Params:    cp, ep, ud_perm - The phase 2 coordinates of the position.
+*
+* Returns:   The exact number of phase 2 moves needed to solve the position,
+*            or -1 if that is more than the depth of the table.
+*
+* Operation: Packs the coordinates and probes the hash table.
+******************************************************************************/
+int CubeEndgame::operator()(int cp, int ep, int ud_perm)
+{
+    if (table.empty())
+    {
+        return -1;
+    }
+
+    uint64_t entry = table[find_slot(endgame_key(cp, ep, ud_perm))];
+    if (entry == ENDGAME_EMPTY)
+    {
+        return -1;
+    }
+    return (int)(entry >> 56);
+}
+
+/******************************************************************************
+* Function:  CubeEndgame::fill
+*
+* Purpose:   Fills in the entries of this table.
+*
+* Params:    depth_limit  - The maximum phase 2 distance from solved of
+*                           positions to store in the table.
+*            budget_bytes - The most memory which filling the table may take.
+*
+* Returns:   The depth the table was filled to, which is less than the limit
+*            if the budget does not allow for it, or -1 if the budget does not
+*            allow for any table at all, in which case the table is left as
+*            it was.
+*
+* Operation: Reduces the depth until fill_bytes fits in the budget, and to
+*            no more than the depth to which the number of positions is
+*            known. Then, starting from the solved position, performs a
+*            breadth-first search of phase 2 positions using the phase 2
+*            transition tables, which must already have been filled, and
+*            stores the depth at which each position is first reached.
+******************************************************************************/
+int CubeEndgame::fill(int depth_limit, size_t budget_bytes)
+{
+    while (depth_limit > ENDGAME_MAX_DEPTH ||
+           (depth_limit >= 0 && fill_bytes(depth_limit) > budget_bytes))
+    {
+        --depth_limit;
+    }
+    if (depth_limit < 0)
+    {
+        return -1;
+    }
+
+    // Start with an empty table.
+    table.assign(ENDGAME_INITIAL_SIZE, ENDGAME_EMPTY);
+    num_entries = 0;
+
+    // Set up the frontier of the breadth-first search, with three coordinates
+    // for each position, and store the solved position.
+    std::vector<int> frontier = {cube_cp_trans.solved_pos(),
+                                 cube_ep_trans.solved_pos(),
+                                 cube_ud_perm_trans.solved_pos()};
+    uint64_t solved_key = endgame_key(frontier[0], frontier[1], frontier[2]);
+    table[find_slot(solved_key)] = solved_key;
+    ++num_entries;
+
+    // Perform the breadth-first search one depth at a time.
+    for (int depth = 1; depth <= depth_limit; ++depth)
+    {
+        std::vector<int> next_frontier;
+
+        for (size_t ii = 0; ii < frontier.size(); ii += 3)
+        {
+            for (uint32_t moves = cube_p2_allowed_moves[NUM_MOVES];
+                 moves != 0; )
+            {
+                int move = cube_next_move(moves);
+                int cp = cube_cp_trans(frontier[ii], move);
+                int ep = cube_ep_trans(frontier[ii + 1], move);
+                int ud_perm = cube_ud_perm_trans(frontier[ii + 2], move);
+
+                uint64_t key = endgame_key(cp, ep, ud_perm);
+                size_t slot = find_slot(key);
+                if (table[slot] == ENDGAME_EMPTY)
+                {
+                    table[slot] = key | ((uint64_t)depth << 56);
+                    next_frontier.insert(next_frontier.end(),
+                                         {cp, ep, ud_perm});
+
+                    // Keep the load factor below a half.
+                    if (2 * ++num_entries > table.size())
+                    {
+                        grow();
+                    }
+                }
+            }
+        }
+
+        frontier.swap(next_frontier);
+    }
+
+    max_depth = depth_limit;
+    return max_depth;
+}
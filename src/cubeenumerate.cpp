@@ -0,0 +1,281 @@
+/******************************************************************************
+* File:    cubeenumerate.cpp
+*
+* Purpose: Implementation of the CubeEnumerator class.
+*
+*          Each solution of the length is made of a phase 1 part, which ends
+*          at the last move which is not a phase 2 move, and a phase 2 part.
+*          The phase 1 search is run once for each length of phase 1 part,
+*          and the phase 2 search from each phase 1 solution looks for
+*          finishes of exactly the remaining length, rather than for the
+*          shortest. The searches for each length of phase 1 part and each
+*          first move are shared out between the threads, which take them in
+*          turn from a counter.
+*
+*          Both searches follow the allowed moves constants rather than the
+*          automata, which once generated keep only one of the sequences
+*          that reach each position. The constants fix the order of each
+*          pair of turns of opposite faces, so that every solution is found
+*          exactly once, in that order, and none need to be remembered.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cube.h>
+#include <cubeenumerate.h>
+#include <cubememory.h>
+#include <cubephase.h>
+#include <cubesolver.h>
+#include <cubetables.h>
+
+/******************************************************************************
+* CubeEnumerator class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeEnumerator::CubeEnumerator
+*
+* Purpose:   Constructor for the CubeEnumerator class.
+*
+* Params:    scrambled_cube - The cube to find solutions to.
+*            threads        - The number of threads to search with.
+*
+* Returns:   Nothing.
+*
+* Operation: Stores the values, with no limit on the number of solutions.
+******************************************************************************/
+CubeEnumerator::CubeEnumerator(Cube scrambled_cube, int threads)
+    : cube(scrambled_cube), num_threads(std::max(threads, 1)),
+      max_solutions(0), length(0), next_item(0), num_phase1_nodes(0),
+      num_phase2_nodes(0), num_found(0)
+{
+}
+
+/******************************************************************************
+* Function:  CubeEnumerator::set_max_solutions
+*
+* Purpose:   Sets the largest number of solutions to find.
+*
+* Params:    count - The search stops once this many distinct solutions have
+*                    been found. The default of 0 means no limit.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply store the value.
+******************************************************************************/
+void CubeEnumerator::set_max_solutions(size_t count)
+{
+    max_solutions = count;
+}
+
+/******************************************************************************
+* Function:  CubeEnumerator::record_sol
+*
+* Purpose:   Passes on a solution found by one of the threads.
+*
+* Params:    solution - The moves of the solution.
+*
+* Returns:   Nothing.
+*
+* Operation: Counts the solution and calls the callback under the lock, so
+*            that calls are never made concurrently. Once the limit is
+*            reached, the searches are cancelled, and any solutions which
+*            other threads find before they notice are dropped.
+******************************************************************************/
+void CubeEnumerator::record_sol(std::vector<int>& solution)
+{
+    std::lock_guard<std::mutex> guard(found_lock);
+    if (cancel.cancelled())
+    {
+        return;
+    }
+
+    ++num_found;
+    if (process_sol)
+    {
+        process_sol(solution);
+    }
+
+    if (max_solutions != 0 && num_found >= max_solutions)
+    {
+        cancel.cancel();
+    }
+}
+
+/******************************************************************************
+* Function:  CubeEnumerator::search
+*
+* Purpose:   Entry point of each thread of the search.
+*
+* Params:    id - The index of this thread, from 0 to num_threads - 1.
+*
+* Returns:   Nothing.
+*
+* Operation: Repeatedly takes the next item of work from the counter. Item 0
+*            is the cube itself as a phase 1 solution of length zero, and
+*            each later item is a length of phase 1 part and a first move,
+*            for which the phase 1 search is run, starting from the position
+*            after that move. The state of the phase 1 automaton is kept up to
+*            date as in any other search, but is not used. If the tables are
+*            replicated across NUMA nodes, the thread is first assigned to a
+*            node.
+******************************************************************************/
+void CubeEnumerator::search(int id)
+{
+    cube_numa_bind_thread(id);
+
+    CubeSolver solver(cube);
+    solver.enumerate_length = length;
+    solver.set_cancel(cancel);
+    solver.start_search([this](std::vector<int>& solution)
+                        { record_sol(solution); });
+    solver.max_length = length;
+
+    int root_co = solver.curr_co;
+    int root_eo = solver.curr_eo;
+    int root_ud_pos = solver.curr_ud_pos;
+    int root_state = cube_p1_automaton.start();
+
+    int num_items = 1 + length * NUM_MOVES;
+    for (int item = next_item++; item < num_items && !solver.finished;
+         item = next_item++)
+    {
+        if (item == 0)
+        {
+            solver.phase1_search(0);
+            continue;
+        }
+
+        int depth = (item - 1) / NUM_MOVES + 1;
+        int move = (item - 1) % NUM_MOVES;
+        if ((cube_p1_allowed_moves[NUM_MOVES] & CUBE_MOVE_BIT(move)) == 0)
+        {
+            continue;
+        }
+
+        // Check the pruning tables here, since with the fused child tables
+        // phase1_search expects its parent to have done so.
+        int co = cube_co_trans(root_co, move);
+        int eo = cube_eo_trans(root_eo, move);
+        int ud_pos = cube_ud_unsorted_trans(root_ud_pos, move);
+        if (cube_co_eo_prune(co, eo) >= depth ||
+            cube_co_ud_prune(co, ud_pos) >= depth ||
+            cube_eo_ud_prune(eo, ud_pos) >= depth)
+        {
+            continue;
+        }
+
+        solver.curr_co = co;
+        solver.curr_eo = eo;
+        solver.curr_ud_pos = ud_pos;
+        solver.last_move = move;
+        solver.p1_state = cube_p1_automaton.next(root_state, move);
+        solver.solution.assign(1, move);
+
+        solver.phase1_search(depth - 1);
+
+        solver.curr_co = root_co;
+        solver.curr_eo = root_eo;
+        solver.curr_ud_pos = root_ud_pos;
+        solver.last_move = NUM_MOVES;
+        solver.p1_state = root_state;
+        solver.solution.clear();
+    }
+
+    num_phase1_nodes += solver.num_phase1_nodes;
+    num_phase2_nodes += solver.num_phase2_nodes;
+}
+
+/******************************************************************************
+* Function:  CubeEnumerator::enumerate
+*
+* Purpose:   Finds every solution of a given length to the cube.
+*
+* Params:    solution_length - The number of moves in each solution.
+*            callback        - A callback which will be called on each
+*                              distinct solution as it is discovered. Calls
+*                              are never made concurrently.
+*
+* Returns:   The number of distinct solutions found.
+*
+* Operation: Resets the shared state, and starts the threads and waits for
+*            them all to finish. Solutions in which the allowed moves
+*            constants forbid some move, such as two turns of the same face
+*            in a row, are not counted, since the same position is reached by
+*            a shorter sequence, or by the same turns of opposite faces in
+*            the other order. Solutions are passed on as they are found
+*            rather than held, so the memory used does not grow with their
+*            number.
+******************************************************************************/
+size_t CubeEnumerator::enumerate(
+    int solution_length, std::function<void(std::vector<int>&)> callback)
+{
+    cube_fill_phase1_tables();
+    cube_fill_phase2_tables();
+
+    length = solution_length;
+    process_sol = callback;
+    cancel = CubeCancel();
+    num_found = 0;
+    next_item.store(0);
+    num_phase1_nodes.store(0);
+    num_phase2_nodes.store(0);
+    if (length < 0)
+    {
+        return 0;
+    }
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < num_threads; ++id)
+    {
+        threads.push_back(std::thread(&CubeEnumerator::search, this, id));
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    return num_found;
+}
+
+/******************************************************************************
+* Function:  CubeEnumerator::phase1_nodes
+*
+* Purpose:   Getter for the number of phase 1 nodes visited by the last call
+*            to enumerate.
+*
+* Params:    None.
+*
+* Returns:   The total over all the threads.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubeEnumerator::phase1_nodes()
+{
+    return num_phase1_nodes.load();
+}
+
+/******************************************************************************
+* Function:  CubeEnumerator::phase2_nodes
+*
+* Purpose:   Getter for the number of phase 2 nodes visited by the last call
+*            to enumerate.
+*
+* Params:    None.
+*
+* Returns:   The total over all the threads.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubeEnumerator::phase2_nodes()
+{
+    return num_phase2_nodes.load();
+}
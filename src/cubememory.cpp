@@ -0,0 +1,691 @@
+/******************************************************************************
+* File:    cubememory.cpp
+*
+* Purpose: Allocation of memory for the tables, on huge pages where possible
+*          and placed on the NUMA nodes of the host according to a policy.
+*
+*          The NUMA system calls are made directly, so that nothing beyond
+*          the C library is needed. Where they are not available, memory is
+*          placed by the kernel as usual and reported as being on node 0.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cubememory.h>
+
+/******************************************************************************
+* Constants
+*
+* Modes for the mbind system call, from the kernel's mempolicy.h.
+******************************************************************************/
+#define CUBE_MPOL_BIND       2
+#define CUBE_MPOL_INTERLEAVE 3
+
+#define CUBE_PLACEMENT_CHUNK 1024
+
+/******************************************************************************
+* Memory policy
+******************************************************************************/
+static bool cube_huge_pages = true;
+static int cube_policy = CUBE_NUMA_LOCAL;
+
+/******************************************************************************
+* Record of the mappings which are on huge pages
+*
+* Maps the start of each mapping made with MAP_HUGETLB or advised for
+* transparent huge pages to whether it was made with MAP_HUGETLB, so that the
+* totals can be kept up to date as tables are freed.
+******************************************************************************/
+struct CubeMappings
+{
+    std::mutex lock;
+    std::map<void*, bool> huge;
+    size_t hugetlb_total = 0;
+    size_t advised_total = 0;
+};
+
+/******************************************************************************
+* The NUMA node whose copies of the tables this thread reads
+******************************************************************************/
+__thread int cube_numa_node = 0;
+
+/******************************************************************************
+* Function:  cube_mappings
+*
+* Purpose:   Gives the record of the mappings which are on huge pages.
+*
+* Params:    None.
+*
+* Returns:   The record.
+*
+* Operation: The record is created on first use and never destroyed, since
+*            the tables are globals of other files, which free their memory
+*            when they are destroyed at exit, and may be destroyed after any
+*            global of this file would have been.
+******************************************************************************/
+static CubeMappings& cube_mappings()
+{
+    static CubeMappings* mappings = new CubeMappings();
+    return *mappings;
+}
+
+/******************************************************************************
+* Function:  cube_read_list
+*
+* Purpose:   Reads a list of numbers in the format used by sysfs.
+*
+* Params:    path - The path of the file to read, which holds a list such as
+*                   "0-3,8-11".
+*
+* Returns:   The numbers in the list, which is empty if the file cannot be
+*            read.
+*
+* Operation: Reads each range in turn and expands it.
+******************************************************************************/
+static std::vector<int> cube_read_list(const char* path)
+{
+    std::vector<int> values;
+    FILE* file = fopen(path, "r");
+    if (file == nullptr)
+    {
+        return values;
+    }
+
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1)
+    {
+        last = first;
+        int separator = fgetc(file);
+        if (separator == '-')
+        {
+            if (fscanf(file, "%d", &last) != 1)
+            {
+                break;
+            }
+            separator = fgetc(file);
+        }
+        for (int value = first; value <= last; ++value)
+        {
+            values.push_back(value);
+        }
+        if (separator != ',')
+        {
+            break;
+        }
+    }
+
+    fclose(file);
+    return values;
+}
+
+/******************************************************************************
+* Function:  cube_mapped_length
+*
+* Purpose:   Works out how much memory is mapped for an allocation.
+*
+* Params:    bytes - The number of bytes asked for.
+*
+* Returns:   The length of the mapping.
+*
+* Operation: Allocations of at least one huge page are rounded up to a whole
+*            number of huge pages, and others to a whole number of pages.
+******************************************************************************/
+static size_t cube_mapped_length(size_t bytes)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (bytes >= CUBE_HUGE_PAGE_SIZE)
+    {
+        page = CUBE_HUGE_PAGE_SIZE;
+    }
+    return (bytes + page - 1) / page * page;
+}
+
+/******************************************************************************
+* Function:  cube_mbind
+*
+* Purpose:   Sets the NUMA policy of a range of memory.
+*
+* Params:    data       - The start of the range, which is page aligned.
+*            bytes      - The length of the range.
+*            mode       - CUBE_MPOL_BIND or CUBE_MPOL_INTERLEAVE.
+*            first_node - The range of nodes to use.
+*            last_node
+*
+* Returns:   Nothing.
+*
+* Operation: Makes the mbind system call before any of the memory has been
+*            written, so that every page is placed under the policy. The
+*            policy is only a hint, so a failure is ignored.
+******************************************************************************/
+static void cube_mbind(void* data, size_t bytes, int mode,
+                       int first_node, int last_node)
+{
+    const int bits = 8 * sizeof(unsigned long);
+    unsigned long mask[CUBE_MAX_NUMA_NODES / bits] = {};
+    for (int node = first_node; node <= last_node; ++node)
+    {
+        mask[node / bits] |= 1UL << (node % bits);
+    }
+
+    syscall(SYS_mbind, data, bytes, mode, mask, CUBE_MAX_NUMA_NODES + 1, 0);
+}
+
+/******************************************************************************
+* Function:  cube_set_memory_policy
+*
+* Purpose:   Chooses how memory for the tables is allocated.
+*
+* Params:    huge_pages  - Whether large tables are put on huge pages.
+*            numa_policy - One of the CUBE_NUMA constants.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply store the values. Tables which have already been filled
+*            keep their memory, so this should be called before any are.
+******************************************************************************/
+void cube_set_memory_policy(bool huge_pages, int numa_policy)
+{
+    cube_huge_pages = huge_pages;
+    cube_policy = numa_policy;
+}
+
+/******************************************************************************
+* Function:  cube_numa_policy
+*
+* Purpose:   Getter for the NUMA policy.
+*
+* Params:    None.
+*
+* Returns:   One of the CUBE_NUMA constants.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+int cube_numa_policy()
+{
+    return cube_policy;
+}
+
+/******************************************************************************
+* Function:  cube_numa_nodes
+*
+* Purpose:   Gives the number of NUMA nodes on the host.
+*
+* Params:    None.
+*
+* Returns:   One more than the highest numbered node which is online, and 1
+*            if this cannot be found.
+*
+* Operation: Reads the list of online nodes from sysfs on the first call.
+******************************************************************************/
+int cube_numa_nodes()
+{
+    static const int num_nodes = []()
+    {
+        std::vector<int> nodes =
+                         cube_read_list("/sys/devices/system/node/online");
+        int highest = nodes.empty() ? 0 : *std::max_element(nodes.begin(),
+                                                            nodes.end());
+        return std::min(highest + 1, CUBE_MAX_NUMA_NODES);
+    }();
+
+    return num_nodes;
+}
+
+/******************************************************************************
+* Function:  cube_numa_bind_thread
+*
+* Purpose:   Assigns the calling thread of a pool to a NUMA node.
+*
+* Params:    index - The index of the thread in its pool.
+*
+* Returns:   The node whose copies of the tables the thread now reads.
+*
+* Operation: Only when the tables are replicated across more than one node,
+*            the threads are spread over the nodes in turn. Each is limited
+*            to the CPUs of its node, so that its copy is always local, and
+*            reads that copy from then on.
+******************************************************************************/
+int cube_numa_bind_thread(int index)
+{
+    int num_nodes = cube_numa_nodes();
+    if (cube_policy != CUBE_NUMA_REPLICATE || num_nodes < 2)
+    {
+        return cube_numa_node;
+    }
+
+    int node = index % num_nodes;
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    std::vector<int> cpus = cube_read_list(path);
+
+    if (!cpus.empty())
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (int cpu : cpus)
+        {
+            CPU_SET(cpu, &cpu_set);
+        }
+        sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+    }
+
+    cube_numa_node = node;
+    return node;
+}
+
+/******************************************************************************
+* Function:  cube_allocate
+*
+* Purpose:   Allocates memory for a table.
+*
+* Params:    bytes - The number of bytes needed.
+*            node  - The node to bind the memory to, or -1 to place it under
+*                    the NUMA policy.
+*
+* Returns:   The start of the memory, or nullptr if it cannot be allocated.
+*
+* Operation: The memory is mapped directly, and nothing is written to it, so
+*            that it can be placed before it is first touched.
+*
+*            If huge pages are enabled and the allocation is at least one
+*            huge page, it is first tried with MAP_HUGETLB. This fails unless
+*            the administrator has reserved huge pages, in which case an
+*            ordinary mapping is aligned to a huge page boundary and advised
+*            for transparent huge pages instead.
+*
+*            On a host with more than one node, the memory is then bound to
+*            the node given, or interleaved across all nodes, or bound to
+*            node 0 if the tables are to be replicated from there.
+******************************************************************************/
+void* cube_allocate(size_t bytes, int node)
+{
+    size_t length = cube_mapped_length(bytes);
+    bool huge = cube_huge_pages && length >= CUBE_HUGE_PAGE_SIZE;
+    void* data = MAP_FAILED;
+    bool hugetlb = false;
+
+    if (huge)
+    {
+        data = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        hugetlb = (data != MAP_FAILED);
+    }
+
+    if (data == MAP_FAILED && huge)
+    {
+        // Map an extra huge page so that the start can be aligned, and
+        // unmap the unaligned memory at either end.
+        void* region = mmap(nullptr, length + CUBE_HUGE_PAGE_SIZE,
+                            PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        uintptr_t start = (uintptr_t)region;
+        uintptr_t aligned = (start + CUBE_HUGE_PAGE_SIZE - 1) &
+                            ~(uintptr_t)(CUBE_HUGE_PAGE_SIZE - 1);
+        if (aligned > start)
+        {
+            munmap(region, aligned - start);
+        }
+        munmap((void*)(aligned + length),
+               start + CUBE_HUGE_PAGE_SIZE - aligned);
+
+        data = (void*)aligned;
+        madvise(data, length, MADV_HUGEPAGE);
+    }
+    else if (data == MAP_FAILED)
+    {
+        data = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            return nullptr;
+        }
+    }
+
+    if (huge)
+    {
+        CubeMappings& mappings = cube_mappings();
+        std::lock_guard<std::mutex> guard(mappings.lock);
+        mappings.huge[data] = hugetlb;
+        (hugetlb ? mappings.hugetlb_total
+                 : mappings.advised_total) += length;
+    }
+
+    int num_nodes = cube_numa_nodes();
+    if (num_nodes > 1)
+    {
+        if (node >= 0)
+        {
+            cube_mbind(data, length, CUBE_MPOL_BIND, node, node);
+        }
+        else if (cube_policy == CUBE_NUMA_INTERLEAVE)
+        {
+            cube_mbind(data, length, CUBE_MPOL_INTERLEAVE, 0, num_nodes - 1);
+        }
+        else if (cube_policy == CUBE_NUMA_REPLICATE)
+        {
+            cube_mbind(data, length, CUBE_MPOL_BIND, 0, 0);
+        }
+    }
+
+    return data;
+}
+
+/******************************************************************************
+* Function:  cube_deallocate
+*
+* Purpose:   Frees memory allocated by cube_allocate.
+*
+* Params:    data  - The start of the memory.
+*            bytes - The number of bytes which were asked for.
+*
+* Returns:   Nothing.
+*
+* Operation: Unmaps the memory, which has the same length as when it was
+*            mapped, and takes it off the totals of huge page memory.
+******************************************************************************/
+void cube_deallocate(void* data, size_t bytes)
+{
+    size_t length = cube_mapped_length(bytes);
+
+    {
+        CubeMappings& mappings = cube_mappings();
+        std::lock_guard<std::mutex> guard(mappings.lock);
+        auto mapping = mappings.huge.find(data);
+        if (mapping != mappings.huge.end())
+        {
+            (mapping->second ? mappings.hugetlb_total
+                             : mappings.advised_total) -= length;
+            mappings.huge.erase(mapping);
+        }
+    }
+
+    munmap(data, length);
+}
+
+/******************************************************************************
+* Function:  cube_memory_placement
+*
+* Purpose:   Finds which NUMA nodes hold a range of memory.
+*
+* Params:    data       - The start of the range.
+*            bytes      - The length of the range.
+*            node_bytes - Array of the number of bytes on each node, which
+*                         the bytes of the range are added to. It is
+*                         extended as needed.
+*
+* Returns:   Nothing.
+*
+* Operation: Asks the kernel for the node of each page with the move_pages
+*            system call, a chunk of pages at a time, without moving any of
+*            them. Pages which have not been written are not counted. If the
+*            call fails, the part of the range which has not yet been looked
+*            up is counted on node 0, which is the whole range if the call is
+*            not available.
+******************************************************************************/
+void cube_memory_placement(const void* data, size_t bytes,
+                           std::vector<size_t>& node_bytes)
+{
+    if (node_bytes.empty())
+    {
+        node_bytes.resize(1, 0);
+    }
+    if (data == nullptr || bytes == 0)
+    {
+        return;
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)data & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)data + bytes;
+
+    void* pages[CUBE_PLACEMENT_CHUNK];
+    int status[CUBE_PLACEMENT_CHUNK];
+
+    for (uintptr_t chunk = start; chunk < end;
+         chunk += CUBE_PLACEMENT_CHUNK * page)
+    {
+        int count = 0;
+        for (uintptr_t address = chunk;
+             address < end && count < CUBE_PLACEMENT_CHUNK;
+             address += page)
+        {
+            pages[count++] = (void*)address;
+        }
+
+        if (syscall(SYS_move_pages, 0, count, pages, nullptr, status, 0) != 0)
+        {
+            node_bytes[0] += end - std::max(chunk, (uintptr_t)data);
+            return;
+        }
+
+        for (int ii = 0; ii < count; ++ii)
+        {
+            if (status[ii] < 0)
+            {
+                continue;
+            }
+            if ((size_t)status[ii] >= node_bytes.size())
+            {
+                node_bytes.resize(status[ii] + 1, 0);
+            }
+
+            uintptr_t first = std::max((uintptr_t)pages[ii],
+                                       (uintptr_t)data);
+            uintptr_t last = std::min((uintptr_t)pages[ii] + page, end);
+            node_bytes[status[ii]] += last - first;
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  cube_hugetlb_bytes
+*
+* Purpose:   Gives the memory mapped on reserved huge pages.
+*
+* Params:    None.
+*
+* Returns:   The number of bytes currently mapped with MAP_HUGETLB.
+*
+* Operation: Simply return the total.
+******************************************************************************/
+size_t cube_hugetlb_bytes()
+{
+    CubeMappings& mappings = cube_mappings();
+    std::lock_guard<std::mutex> guard(mappings.lock);
+    return mappings.hugetlb_total;
+}
+
+/******************************************************************************
+* Function:  cube_advised_bytes
+*
+* Purpose:   Gives the memory advised for transparent huge pages.
+*
+* Params:    None.
+*
+* Returns:   The number of bytes currently mapped without MAP_HUGETLB but
+*            advised for transparent huge pages. How much of it the kernel
+*            has actually put on huge pages is shown by AnonHugePages in
+*            /proc/self/smaps.
+*
+* Operation: Simply return the total.
+******************************************************************************/
+size_t cube_advised_bytes()
+{
+    CubeMappings& mappings = cube_mappings();
+    std::lock_guard<std::mutex> guard(mappings.lock);
+    return mappings.advised_total;
+}
+
+/******************************************************************************
+* CubeReplicated class template implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeReplicated::CubeReplicated
+*
+* Purpose:   Constructor for the CubeReplicated class template.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Creates the empty primary copy, which every node reads until
+*            the table is replicated.
+******************************************************************************/
+template <class T>
+CubeReplicated<T>::CubeReplicated() : copies(1)
+{
+    for (int node = 0; node < CUBE_MAX_NUMA_NODES; ++node)
+    {
+        node_data[node] = nullptr;
+    }
+}
+
+/******************************************************************************
+* Function:  CubeReplicated::empty
+*
+* Purpose:   Determines whether any space has been allocated for the table.
+*
+* Params:    None.
+*
+* Returns:   True if assign has not been called, false otherwise.
+*
+* Operation: Checks the primary copy.
+******************************************************************************/
+template <class T>
+bool CubeReplicated<T>::empty()
+{
+    return copies[0].empty();
+}
+
+/******************************************************************************
+* Function:  CubeReplicated::bytes
+*
+* Purpose:   Calculates the memory used by the table.
+*
+* Params:    None.
+*
+* Returns:   The number of bytes allocated for all the copies of the table.
+*
+* Operation: Adds up the sizes of the copies.
+******************************************************************************/
+template <class T>
+size_t CubeReplicated<T>::bytes()
+{
+    size_t total = 0;
+    for (Copy& copy : copies)
+    {
+        total += copy.capacity() * sizeof(T);
+    }
+    return total;
+}
+
+/******************************************************************************
+* Function:  CubeReplicated::assign
+*
+* Purpose:   Allocates the primary copy of the table.
+*
+* Params:    count - The number of entries.
+*            value - The value to give each entry.
+*
+* Returns:   Nothing.
+*
+* Operation: Allocates the copy under the NUMA policy and gives it to every
+*            node, discarding any other copies.
+******************************************************************************/
+template <class T>
+void CubeReplicated<T>::assign(size_t count, const T& value)
+{
+    copies.resize(1);
+    copies[0].assign(count, value);
+
+    for (int node = 0; node < CUBE_MAX_NUMA_NODES; ++node)
+    {
+        node_data[node] = copies[0].data();
+    }
+}
+
+/******************************************************************************
+* Function:  CubeReplicated::replicate
+*
+* Purpose:   Copies the filled table onto each NUMA node.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Does nothing unless the policy is CUBE_NUMA_REPLICATE and the
+*            host has more than one node. Otherwise the primary copy, which
+*            was bound to node 0 when it was allocated, is copied into memory
+*            bound to each of the other nodes in turn.
+******************************************************************************/
+template <class T>
+void CubeReplicated<T>::replicate()
+{
+    int num_nodes = cube_numa_nodes();
+    if (cube_numa_policy() != CUBE_NUMA_REPLICATE || num_nodes < 2 ||
+        copies.size() > 1)
+    {
+        return;
+    }
+
+    copies.reserve(num_nodes);
+    for (int node = 1; node < num_nodes; ++node)
+    {
+        copies.push_back(Copy(copies[0].begin(), copies[0].end(),
+                              CubeAllocator<T>(node)));
+    }
+    for (int node = 1; node < num_nodes; ++node)
+    {
+        node_data[node] = copies[node].data();
+    }
+}
+
+/******************************************************************************
+* Function:  CubeReplicated::placement
+*
+* Purpose:   Reports which NUMA nodes hold the table.
+*
+* Params:    node_bytes - Array of the number of bytes on each node, which
+*                         the bytes of this table are added to.
+*
+* Returns:   Nothing.
+*
+* Operation: Asks the kernel where the pages of each copy are.
+******************************************************************************/
+template <class T>
+void CubeReplicated<T>::placement(std::vector<size_t>& node_bytes)
+{
+    for (Copy& copy : copies)
+    {
+        cube_memory_placement(copy.data(), copy.capacity() * sizeof(T),
+                              node_bytes);
+    }
+}
+
+/******************************************************************************
+* Explicit instantiations for the entry types of the tables
+******************************************************************************/
+template class CubeReplicated<uint8_t>;
+template class CubeReplicated<uint16_t>;
+template class CubeReplicated<uint32_t>;
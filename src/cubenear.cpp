@@ -0,0 +1,438 @@
+/******************************************************************************
+* File:    cubenear.cpp
+*
+* Purpose: Implementation of the CubeNear class, a hash table holding every
+*          cube position within some small number of moves of solved,
+*          together with a move from each position which leads towards
+*          solved.
+*
+*          Positions are described by the six coordinates co, eo, cp,
+*          ud_sorted, rl_sorted and fb_sorted, which between them determine
+*          the complete state of the cube and all have transition tables for
+*          every move.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <vector>
+
+#include <cube.h>
+#include <cubememory.h>
+#include <cubenear.h>
+#include <cubetables.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define NEAR_EMPTY        0xFF
+#define NEAR_INITIAL_SIZE (1 << 16)
+#define NEAR_MAX_DEPTH    8
+
+/******************************************************************************
+* The number of positions at each distance from solved, in the half turn
+* metric, from which the memory needed to fill the table is worked out.
+******************************************************************************/
+static const uint64_t near_positions[NEAR_MAX_DEPTH + 1] =
+    {1, 18, 243, 3240, 43239, 574908, 7618438, 100803036, 1332343288};
+
+/******************************************************************************
+* CubeNear class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeNear::CubeNear
+*
+* Purpose:   Constructor for the CubeNear class.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Creates an empty table, which will not be consulted by the
+*            solver until it has been filled.
+******************************************************************************/
+CubeNear::CubeNear()
+{
+    num_entries = 0;
+    max_depth = -1;
+}
+
+/******************************************************************************
+* Function:  CubeNear::pack
+*
+* Purpose:   Packs the coordinates of a cube position into a key.
+*
+* Params:    co, eo, cp,    - The coordinates of the position.
+*            ud_sorted,
+*            rl_sorted,
+*            fb_sorted
+*            lo, hi         - Output parameters holding the packed key.
+*
+* Returns:   Nothing.
+*
+* Operation: The positions of the FB-slice edges are determined by those of
+*            the other two slices, so only their order (fb_sorted % 24) is
+*            kept. This leaves 72 bits, which are split 53 / 19 between the
+*            two words.
+******************************************************************************/
+void CubeNear::pack(int co, int eo, int cp,
+                    int ud_sorted, int rl_sorted, int fb_sorted,
+                    uint64_t& lo, uint32_t& hi)
+{
+    lo = (uint64_t)co | ((uint64_t)eo << 12) | ((uint64_t)cp << 23) |
+         ((uint64_t)ud_sorted << 39);
+    hi = (uint32_t)rl_sorted | ((uint32_t)(fb_sorted % 24) << 14);
+}
+
+/******************************************************************************
+* Function:  CubeNear::find_slot
+*
+* Purpose:   Finds the slot in the table for a key.
+*
+* Params:    lo, hi - The packed key.
+*
+* Returns:   The index of the slot holding the key, or of the empty slot where
+*            it would be inserted.
+*
+* Operation: Open addressing with linear probing from a hash of the key.
+******************************************************************************/
+size_t CubeNear::find_slot(uint64_t lo, uint32_t hi)
+{
+    size_t mask = table.size() - 1;
+    uint64_t hash = (lo ^ ((uint64_t)hi << 40)) * 0x9E3779B97F4A7C15ULL;
+    size_t slot = (size_t)(hash >> 20) & mask;
+
+    while (table[slot].depth != NEAR_EMPTY &&
+           (table[slot].lo != lo || table[slot].hi != hi))
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/******************************************************************************
+* Function:  CubeNear::grow
+*
+* Purpose:   Doubles the size of the table.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Reinserts every entry into a table of twice the size.
+******************************************************************************/
+void CubeNear::grow()
+{
+    std::vector<Entry, CubeAllocator<Entry>> old_table;
+    old_table.swap(table);
+
+    Entry empty = {0, 0, 0, NEAR_EMPTY};
+    table.assign(old_table.size() * 2, empty);
+
+    for (Entry& entry : old_table)
+    {
+        if (entry.depth != NEAR_EMPTY)
+        {
+            table[find_slot(entry.lo, entry.hi)] = entry;
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  CubeNear::depth
+*
+* Purpose:   Getter for the depth to which the table has been filled.
+*
+* Params:    None.
+*
+* Returns:   The maximum distance from solved of the positions in the table,
+*            or -1 if the table has not been filled.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+int CubeNear::depth()
+{
+    return max_depth;
+}
+
+/******************************************************************************
+* Function:  CubeNear::size
+*
+* Purpose:   Calculates the number of positions in the table.
+*
+* Params:    None.
+*
+* Returns:   The number of positions stored.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+size_t CubeNear::size()
+{
+    return num_entries;
+}
+
+/******************************************************************************
+* Function:  CubeNear::bytes
+*
+* Purpose:   Calculates the memory used by the table.
+*
+* Params:    None.
+*
+* Returns:   The number of bytes allocated for the table, all of which have
+*            been written once it is filled.
+*
+* Operation: Multiplies the number of slots by their size.
+******************************************************************************/
+size_t CubeNear::bytes()
+{
+    return table.capacity() * sizeof(Entry);
+}
+
+/******************************************************************************
+* Function:  CubeNear::fill_bytes
+*
+* Purpose:   Works out the most memory which filling the table needs.
+*
+* Params:    depth_limit - The depth to fill the table to.
+*
+* Returns:   The peak number of bytes taken while the table is filled, or
+*            SIZE_MAX if the depth is too large for the number of positions to
+*            be known.
+*
+* Operation: Follows the growth of the table from its initial size, doubling
+*            it whenever it is over half full, as fill does. At the peak, the
+*            table is being doubled with the old table still held, while the
+*            frontiers of the last two depths of the search, at six ints a
+*            position, are held too.
+******************************************************************************/
+size_t CubeNear::fill_bytes(int depth_limit)
+{
+    if (depth_limit > NEAR_MAX_DEPTH)
+    {
+        return SIZE_MAX;
+    }
+
+    uint64_t entries = 0;
+    for (int depth = 0; depth <= depth_limit; ++depth)
+    {
+        entries += near_positions[depth];
+    }
+
+    uint64_t slots = NEAR_INITIAL_SIZE;
+    while (2 * entries > slots)
+    {
+        slots *= 2;
+    }
+
+    uint64_t frontier = near_positions[depth_limit];
+    if (depth_limit > 0)
+    {
+        frontier += near_positions[depth_limit - 1];
+    }
+
+    uint64_t bytes = slots * sizeof(Entry) * 3 / 2 +
+                     frontier * 6 * sizeof(int);
+    return (bytes > SIZE_MAX) ? SIZE_MAX : (size_t)bytes;
+}
+
+/******************************************************************************
+* Function:  CubeNear::placement
+*
+* Purpose:   Reports which NUMA nodes hold the table.
+*
+* Params:    node_bytes - Array of the number of bytes on each node, which
+*                         the bytes of this table are added to.
+*
+* Returns:   Nothing.
+*
+* Operation: Asks the kernel where the pages of the table are.
+******************************************************************************/
+void CubeNear::placement(std::vector<size_t>& node_bytes)
+{
+    cube_memory_placement(table.data(), table.capacity() * sizeof(Entry),
+                          node_bytes);
+}
+
+/******************************************************************************
+* Function:  CubeNear::lookup
+*
+* Purpose:   Looks up a position in the table.
+*
+* Params:    co, eo, cp,    - The coordinates of the position.
+*            ud_sorted,
+*            rl_sorted,
+*            fb_sorted
+*            move           - Output parameter holding a move which takes the
+*                             position one move closer to solved.
+*
+* Returns:   The distance of the position from solved, or -1 if it is further
+*            from solved than the depth of the table.
+*
+* Operation: Packs the coordinates and probes the hash table.
+******************************************************************************/
+int CubeNear::lookup(int co, int eo, int cp,
+                     int ud_sorted, int rl_sorted, int fb_sorted, int& move)
+{
+    if (table.empty())
+    {
+        return -1;
+    }
+
+    uint64_t lo;
+    uint32_t hi;
+    pack(co, eo, cp, ud_sorted, rl_sorted, fb_sorted, lo, hi);
+
+    Entry& entry = table[find_slot(lo, hi)];
+    if (entry.depth == NEAR_EMPTY)
+    {
+        return -1;
+    }
+
+    move = entry.move;
+    return entry.depth;
+}
+
+/******************************************************************************
+* Function:  CubeNear::path_to_solved
+*
+* Purpose:   Finds an optimal solution to a position in the table.
+*
+* Params:    co, eo, cp,    - The coordinates of the position.
+*            ud_sorted,
+*            rl_sorted,
+*            fb_sorted
+*            moves          - Output parameter holding the solution.
+*
+* Returns:   True if the position is in the table, false otherwise.
+*
+* Operation: Repeatedly looks up the position, performs the stored move on
+*            the coordinates using the transition tables, until the position
+*            is solved.
+******************************************************************************/
+bool CubeNear::path_to_solved(int co, int eo, int cp,
+                              int ud_sorted, int rl_sorted, int fb_sorted,
+                              std::vector<int>& moves)
+{
+    int move;
+    int dist = lookup(co, eo, cp, ud_sorted, rl_sorted, fb_sorted, move);
+    if (dist == -1)
+    {
+        return false;
+    }
+
+    moves.clear();
+    while (dist > 0)
+    {
+        moves.push_back(move);
+        co = cube_co_trans(co, move);
+        eo = cube_eo_trans(eo, move);
+        cp = cube_cp_trans(cp, move);
+        ud_sorted = cube_ud_sorted_trans(ud_sorted, move);
+        rl_sorted = cube_rl_sorted_trans(rl_sorted, move);
+        fb_sorted = cube_fb_sorted_trans(fb_sorted, move);
+        dist = lookup(co, eo, cp, ud_sorted, rl_sorted, fb_sorted, move);
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function:  CubeNear::fill
+*
+* Purpose:   Fills in the entries of this table.
+*
+* Params:    depth_limit  - The maximum distance from solved of positions
+*                           to store in the table.
+*            budget_bytes - The most memory which filling the table may take.
+*
+* Returns:   The depth the table was filled to, which is less than the limit
+*            if the budget does not allow for it, or -1 if the budget does not
+*            allow for any table at all, in which case the table is left as
+*            it was.
+*
+* Operation: Reduces the depth until fill_bytes fits in the budget, and to
+*            no more than the depth to which the number of positions is
+*            known. Then, starting from the solved position, performs a
+*            breadth-first search of cube positions using the transition
+*            tables, which must already have been filled. Each new position
+*            is stored along with the inverse of the move which first reached
+*            it.
+******************************************************************************/
+int CubeNear::fill(int depth_limit, size_t budget_bytes)
+{
+    // Local variables
+    uint64_t lo;
+    uint32_t hi;
+
+    while (depth_limit > NEAR_MAX_DEPTH ||
+           (depth_limit >= 0 && fill_bytes(depth_limit) > budget_bytes))
+    {
+        --depth_limit;
+    }
+    if (depth_limit < 0)
+    {
+        return -1;
+    }
+
+    // Start with an empty table.
+    Entry empty = {0, 0, 0, NEAR_EMPTY};
+    table.assign(NEAR_INITIAL_SIZE, empty);
+    num_entries = 0;
+
+    // Set up the frontier of the breadth-first search, with six coordinates
+    // for each position, and store the solved position.
+    std::vector<int> frontier = {cube_co_trans.solved_pos(),
+                                 cube_eo_trans.solved_pos(),
+                                 cube_cp_trans.solved_pos(),
+                                 cube_ud_sorted_trans.solved_pos(),
+                                 cube_rl_sorted_trans.solved_pos(),
+                                 cube_fb_sorted_trans.solved_pos()};
+    pack(frontier[0], frontier[1], frontier[2],
+         frontier[3], frontier[4], frontier[5], lo, hi);
+    Entry solved = {lo, hi, 0, 0};
+    table[find_slot(lo, hi)] = solved;
+    ++num_entries;
+
+    // Perform the breadth-first search one depth at a time.
+    for (int depth = 1; depth <= depth_limit; ++depth)
+    {
+        std::vector<int> next_frontier;
+
+        for (size_t ii = 0; ii < frontier.size(); ii += 6)
+        {
+            for (int move = 0; move < NUM_MOVES; ++move)
+            {
+                int co = cube_co_trans(frontier[ii], move);
+                int eo = cube_eo_trans(frontier[ii + 1], move);
+                int cp = cube_cp_trans(frontier[ii + 2], move);
+                int ud_sorted = cube_ud_sorted_trans(frontier[ii + 3], move);
+                int rl_sorted = cube_rl_sorted_trans(frontier[ii + 4], move);
+                int fb_sorted = cube_fb_sorted_trans(frontier[ii + 5], move);
+
+                pack(co, eo, cp, ud_sorted, rl_sorted, fb_sorted, lo, hi);
+                size_t slot = find_slot(lo, hi);
+                if (table[slot].depth == NEAR_EMPTY)
+                {
+                    Entry entry = {lo, hi, (uint8_t)inverse_move(move),
+                                   (uint8_t)depth};
+                    table[slot] = entry;
+                    next_frontier.insert(next_frontier.end(),
+                                         {co, eo, cp,
+                                          ud_sorted, rl_sorted, fb_sorted});
+
+                    // Keep the load factor below a half.
+                    if (2 * ++num_entries > table.size())
+                    {
+                        grow();
+                    }
+                }
+            }
+        }
+
+        frontier.swap(next_frontier);
+    }
+
+    max_depth = depth_limit;
+    return max_depth;
+}
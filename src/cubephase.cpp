@@ -1,227 +1,393 @@
 /******************************************************************************
 * File:    cubephase.cpp
 *
-* Purpose: Definitions of constants which determine the moves allowed in each
-*          phase of the two-phase algorithm.
+* Purpose: Implementation of the CubeAutomaton class, which determines the
+*          moves allowed at each point of a search in either phase of the
+*          two-phase algorithm.
+*
+*          A sequence of moves is redundant if some other sequence which
+*          is no longer, and comes first in shortlex order, has the same
+*          effect on the cube. Only sequences with no redundant part need to
+*          be searched, since every cube state is reached by one of those at
+*          least as quickly. The automaton recognises exactly the sequences
+*          which contain none of the minimal redundant sequences up to some
+*          length, which are found by a breadth-first search over sequences
+*          of moves.
 ******************************************************************************/
 
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
+#include <cstdint>
+#include <deque>
+#include <unordered_set>
 #include <vector>
 
 #include <cube.h>
+#include <cubephase.h>
 
 /******************************************************************************
-* Allowed moves initial definitions
+* Automaton initial definitions
 ******************************************************************************/
-std::vector<std::vector<int>> cube_p1_allowed_moves(NUM_MOVES + 1);
-std::vector<std::vector<int>> cube_p2_allowed_moves(NUM_MOVES + 1);
+CubeAutomaton cube_p1_automaton(PHASE_1);
+CubeAutomaton cube_p2_automaton(PHASE_2);
 
 /******************************************************************************
-* Implementation of functions which fill the allowed moves vectors
+* CubeAutomaton class implementation
 ******************************************************************************/
 
 /******************************************************************************
-* Function:  cube_create_p1_allowed_moves
+* Function:  CubeAutomaton::CubeAutomaton
 *
-* Purpose:   Fill in the allowed moves for phase 1.
+* Purpose:   Constructor for the CubeAutomaton class.
 *
-* Params:    None.
+* Params:    phase_desc - Whether this automaton is for phase 1 or phase 2 of
+*                         the two-phase algorithm.
 *
 * Returns:   Nothing.
 *
-* Operation: In phase 1, any move is allowed, but not every move is allowed to
-*            follow every other move. In particular, no face can be turned
-*            twice in a row, and, since RL = LR, FB = BF, UD = DU, we do not
-*            allow a turn of the R face to follow a turn of the L face, or a
-*            turn of the F face to follow a turn of the B face, or a turn of
-*            the U face to follow a turn of the D face.
+* Operation: Builds the automaton with state 0 as the start, and state n + 1
+*            as the state after move n, with the moves allowed in each state
+*            taken from the allowed moves constants.
 ******************************************************************************/
-void cube_create_p1_allowed_moves()
+CubeAutomaton::CubeAutomaton(int phase_desc)
 {
-    cube_p1_allowed_moves[MOVE_U]    = {MOVE_L,  MOVE_L2, MOVE_LP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_U2]   = {MOVE_L,  MOVE_L2, MOVE_LP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_UP]   = {MOVE_L,  MOVE_L2, MOVE_LP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_L]    = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_B,  MOVE_B2,
-                                        MOVE_BP, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_L2]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_B,  MOVE_B2,
-                                        MOVE_BP, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_LP]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_B,  MOVE_B2,
-                                        MOVE_BP, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_F]    = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_F2]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_FP]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_R]    = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_F,  MOVE_F2,
-                                        MOVE_FP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_R2]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_F,  MOVE_F2,
-                                        MOVE_FP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_RP]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_F,  MOVE_F2,
-                                        MOVE_FP, MOVE_B,  MOVE_B2, MOVE_BP,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_B]    = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_B2]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_BP]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p1_allowed_moves[MOVE_D]    = {MOVE_L,  MOVE_L2, MOVE_LP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP};
-
-    cube_p1_allowed_moves[MOVE_D2]   = {MOVE_L,  MOVE_L2, MOVE_LP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP};
-
-    cube_p1_allowed_moves[MOVE_DP]   = {MOVE_L,  MOVE_L2, MOVE_LP, MOVE_F,
-                                        MOVE_F2, MOVE_FP, MOVE_R,  MOVE_R2,
-                                        MOVE_RP, MOVE_B,  MOVE_B2, MOVE_BP};
-
-    cube_p1_allowed_moves[NUM_MOVES] = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L,
-                                        MOVE_L2, MOVE_LP, MOVE_F,  MOVE_F2,
-                                        MOVE_FP, MOVE_R,  MOVE_R2, MOVE_RP,
-                                        MOVE_B,  MOVE_B2, MOVE_BP, MOVE_D,
-                                        MOVE_D2, MOVE_DP};
+    phase = phase_desc;
+
+    const uint32_t* allowed_moves = (phase == PHASE_1) ? cube_p1_allowed_moves
+                                                       : cube_p2_allowed_moves;
+
+    state_moves.assign(NUM_MOVES + 1, 0);
+    transitions.assign((NUM_MOVES + 1) * NUM_MOVES, 0);
+
+    state_moves[0] = allowed_moves[NUM_MOVES];
+    for (int move = 0; move < NUM_MOVES; ++move)
+    {
+        state_moves[move + 1] = allowed_moves[move];
+    }
+
+    for (int state = 0; state <= NUM_MOVES; ++state)
+    {
+        for (int move = 0; move < NUM_MOVES; ++move)
+        {
+            transitions[state * NUM_MOVES + move] = move + 1;
+        }
+    }
 }
 
 /******************************************************************************
-* Function:  cube_create_p2_allowed_moves
+* Function:  CubeAutomaton::start
 *
-* Purpose:   Fill in the allowed moves for phase 2.
+* Purpose:   Gives the state at the start of a sequence.
 *
 * Params:    None.
 *
-* Returns:   Nothing.
+* Returns:   The start state.
 *
-* Operation: In phase 2, one half turns of R, L, F, B are allowed, but not
-*            every move is allowed to follow every other move. In particular,
-*            no face can be turned twice in a row, and, since RL = LR, FB = BF,
-*            UD = DU, we do not allow a turn of the R face to follow a turn of
-*            the L face, or a turn of the F face to follow a turn of the B
-*            face, or a turn of the U face to follow a turn of the D face.
+* Operation: The start state is always state 0.
 ******************************************************************************/
-void cube_create_p2_allowed_moves()
+int CubeAutomaton::start()
 {
-    cube_p2_allowed_moves[MOVE_U]    = {MOVE_L2, MOVE_F2, MOVE_R2, MOVE_B2,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_U2]   = {MOVE_L2, MOVE_F2, MOVE_R2, MOVE_B2,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_UP]   = {MOVE_L2, MOVE_F2, MOVE_R2, MOVE_B2,
-                                        MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_L]    = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_F2,
-                                        MOVE_B2, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_L2]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_F2,
-                                        MOVE_B2, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_LP]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_F2,
-                                        MOVE_B2, MOVE_D,  MOVE_D2, MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_F]    = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_R2, MOVE_B2, MOVE_D,  MOVE_D2,
-                                        MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_F2]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_R2, MOVE_B2, MOVE_D,  MOVE_D2,
-                                        MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_FP]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_R2, MOVE_B2, MOVE_D,  MOVE_D2,
-                                        MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_R]    = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_F2, MOVE_B2, MOVE_D,  MOVE_D2,
-                                        MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_R2]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_F2, MOVE_B2, MOVE_D,  MOVE_D2,
-                                        MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_RP]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_F2, MOVE_B2, MOVE_D,  MOVE_D2,
-                                        MOVE_DP};
-
-    cube_p2_allowed_moves[MOVE_B]    = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_R2, MOVE_D,  MOVE_D2, MOVE_DP};
+    return 0;
+}
 
-    cube_p2_allowed_moves[MOVE_B2]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_R2, MOVE_D,  MOVE_D2, MOVE_DP};
+/******************************************************************************
+* Function:  CubeAutomaton::size
+*
+* Purpose:   Calculates the number of states in the automaton.
+*
+* Params:    None.
+*
+* Returns:   The number of states.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+int CubeAutomaton::size()
+{
+    return state_moves.size();
+}
 
-    cube_p2_allowed_moves[MOVE_BP]   = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_R2, MOVE_D,  MOVE_D2, MOVE_DP};
+/******************************************************************************
+* Function:  CubeAutomaton::moves
+*
+* Purpose:   Gives the moves allowed in a state.
+*
+* Params:    state - The current state.
+*
+* Returns:   The set of moves which may be made next.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint32_t CubeAutomaton::moves(int state)
+{
+    return state_moves[state];
+}
 
-    cube_p2_allowed_moves[MOVE_D]    = {MOVE_L2, MOVE_F2, MOVE_R2, MOVE_B2};
+/******************************************************************************
+* Function:  CubeAutomaton::next
+*
+* Purpose:   Gives the state after a move.
+*
+* Params:    state - The current state.
+*            move  - A move allowed in that state.
+*
+* Returns:   The state after the move.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+int CubeAutomaton::next(int state, int move)
+{
+    return transitions[state * NUM_MOVES + move];
+}
 
-    cube_p2_allowed_moves[MOVE_D2]   = {MOVE_L2, MOVE_F2, MOVE_R2, MOVE_B2};
+/******************************************************************************
+* Function:  CubeAutomaton::letters
+*
+* Purpose:   Lists the moves of the phase in shortlex order.
+*
+* Params:    None.
+*
+* Returns:   The moves, in the order used to compare sequences.
+*
+* Operation: The faces are taken in the order U, F, R, B, L, D, so that of
+*            each pair of sequences which turn opposite faces in the two
+*            possible orders, the one kept is the one which the allowed moves
+*            constants already allow. This makes the generated automaton a
+*            refinement of the constants.
+******************************************************************************/
+std::vector<int> CubeAutomaton::letters()
+{
+    const int faces[] = {MOVE_U, MOVE_F, MOVE_R, MOVE_B, MOVE_L, MOVE_D};
+    uint32_t alphabet = (phase == PHASE_1) ? CUBE_P1_MOVES : CUBE_P2_MOVES;
+    std::vector<int> result;
+
+    for (int face : faces)
+    {
+        for (int move = face; move < face + 3; ++move)
+        {
+            if (alphabet & CUBE_MOVE_BIT(move))
+            {
+                result.push_back(move);
+            }
+        }
+    }
+
+    return result;
+}
 
-    cube_p2_allowed_moves[MOVE_DP]   = {MOVE_L2, MOVE_F2, MOVE_R2, MOVE_B2};
+/******************************************************************************
+* Function:  CubeAutomaton::encode
+*
+* Purpose:   Packs a sequence of moves into an integer.
+*
+* Params:    word - The sequence of moves, at most 15 long.
+*
+* Returns:   The sequence as a number in base NUM_MOVES.
+*
+* Operation: Only sequences of the same length are ever compared, so no
+*            marker of the length is needed.
+******************************************************************************/
+uint64_t CubeAutomaton::encode(std::vector<int>& word)
+{
+    uint64_t code = 0;
+    for (int move : word)
+    {
+        code = code * NUM_MOVES + move;
+    }
+    return code;
+}
 
-    cube_p2_allowed_moves[NUM_MOVES] = {MOVE_U,  MOVE_U2, MOVE_UP, MOVE_L2,
-                                        MOVE_F2, MOVE_R2, MOVE_B2, MOVE_D,
-                                        MOVE_D2, MOVE_DP};
+/******************************************************************************
+* Function:  CubeAutomaton::generate
+*
+* Purpose:   Rebuilds the automaton to forbid all redundant sequences up to a
+*            given length.
+*
+* Params:    depth - The length of the longest redundant sequences to find,
+*                    at most 15. Each extra move multiplies the time taken by
+*                    about 13 in phase 1 and about 7 in phase 2.
+*
+* Returns:   Nothing.
+*
+* Operation: Sequences are enumerated in shortlex order, one length at a
+*            time, extending only those with no redundant part. A sequence
+*            whose cube state has already been reached is redundant, and is
+*            minimal since all of its proper parts are not. The minimal
+*            redundant sequences are then built into an Aho-Corasick
+*            automaton, whose states are the prefixes of those sequences, and
+*            whose moves are those which do not complete one of them.
+******************************************************************************/
+void CubeAutomaton::generate(int depth)
+{
+    std::vector<int> order = letters();
+
+    // Find the minimal redundant sequences by a breadth-first search.
+    std::unordered_set<CubeKey, CubeKeyHash> seen;
+    std::vector<std::vector<int>> level = {{}};
+    std::vector<std::vector<int>> redundant;
+
+    Cube solved_cube;
+    seen.insert(solved_cube.key());
+
+    for (int length = 1; length <= depth; ++length)
+    {
+        std::vector<std::vector<int>> next_level;
+
+        // Sequences of the previous length which have no redundant part.
+        std::unordered_set<uint64_t> codes;
+        for (std::vector<int>& word : level)
+        {
+            codes.insert(encode(word));
+        }
+
+        for (std::vector<int>& word : level)
+        {
+            Cube cube;
+            for (int move : word)
+            {
+                cube = cube.perform_move(move);
+            }
+
+            for (int move : order)
+            {
+                std::vector<int> next_word = word;
+                next_word.push_back(move);
+
+                // The prefix has no redundant part, so the sequence only has
+                // one if its suffix does.
+                std::vector<int> suffix(next_word.begin() + 1,
+                                        next_word.end());
+                if (codes.count(encode(suffix)) == 0)
+                {
+                    continue;
+                }
+
+                CubeKey key = cube.perform_move(move).key();
+                if (seen.insert(key).second)
+                {
+                    next_level.push_back(next_word);
+                }
+                else
+                {
+                    redundant.push_back(next_word);
+                }
+            }
+        }
+
+        level.swap(next_level);
+    }
+
+    // Build a trie of the redundant sequences, marking the nodes where one
+    // of them ends.
+    std::vector<int> trie(NUM_MOVES, -1);
+    std::vector<bool> forbidden(1, false);
+
+    for (std::vector<int>& word : redundant)
+    {
+        int node = 0;
+        for (int move : word)
+        {
+            if (trie[node * NUM_MOVES + move] == -1)
+            {
+                trie[node * NUM_MOVES + move] = forbidden.size();
+                trie.insert(trie.end(), NUM_MOVES, -1);
+                forbidden.push_back(false);
+            }
+            node = trie[node * NUM_MOVES + move];
+        }
+        forbidden[node] = true;
+    }
+
+    // Work out the failure links in breadth-first order, turning the trie
+    // into a complete transition table, and marking every node which has a
+    // redundant sequence as a suffix.
+    int num_nodes = forbidden.size();
+    std::vector<int> fail(num_nodes, 0);
+    std::deque<int> queue = {0};
+
+    while (!queue.empty())
+    {
+        int node = queue.front();
+        queue.pop_front();
+        if (forbidden[fail[node]])
+        {
+            forbidden[node] = true;
+        }
+
+        for (int move = 0; move < NUM_MOVES; ++move)
+        {
+            int& child = trie[node * NUM_MOVES + move];
+            int fallback = (node == 0) ? 0 : trie[fail[node] * NUM_MOVES +
+                                                  move];
+            if (child == -1)
+            {
+                child = fallback;
+            }
+            else
+            {
+                fail[child] = fallback;
+                queue.push_back(child);
+            }
+        }
+    }
+
+    // Number the nodes which are not forbidden as the states of the
+    // automaton, keeping the root as the start state.
+    std::vector<int> state_of(num_nodes, -1);
+    int num_states = 0;
+    for (int node = 0; node < num_nodes; ++node)
+    {
+        if (!forbidden[node])
+        {
+            state_of[node] = num_states++;
+        }
+    }
+
+    uint32_t alphabet = (phase == PHASE_1) ? CUBE_P1_MOVES : CUBE_P2_MOVES;
+    state_moves.assign(num_states, 0);
+    transitions.assign((size_t)num_states * NUM_MOVES, 0);
+
+    for (int node = 0; node < num_nodes; ++node)
+    {
+        if (forbidden[node])
+        {
+            continue;
+        }
+
+        for (int move = 0; move < NUM_MOVES; ++move)
+        {
+            int child = trie[node * NUM_MOVES + move];
+            if ((alphabet & CUBE_MOVE_BIT(move)) && !forbidden[child])
+            {
+                state_moves[state_of[node]] |= CUBE_MOVE_BIT(move);
+                transitions[state_of[node] * NUM_MOVES + move] =
+                                                             state_of[child];
+            }
+        }
+    }
 }
 
 /******************************************************************************
-* Function:  cube_create_allowed_moves
+* Implementation of the function which generates the automata
+******************************************************************************/
+
+/******************************************************************************
+* Function:  cube_create_automata
 *
-* Purpose:   Fill in the allowed moves vectors for both phases.
+* Purpose:   Generates the automata for both phases.
 *
-* Params:    None
+* Params:    p1_depth - The length of the longest redundant sequences to
+*                       forbid in phase 1.
+*            p2_depth - The length of the longest redundant sequences to
+*                       forbid in phase 2.
 *
 * Returns:   Nothing.
 *
-* Operation: Calls into functions responsible for filling in the vector for
-*            each phase separately.
+* Operation: Calls generate on each automaton. Without this, the automata
+*            forbid only the sequences which the allowed moves constants do.
 ******************************************************************************/
-void cube_create_allowed_moves()
+void cube_create_automata(int p1_depth, int p2_depth)
 {
-    cube_create_p1_allowed_moves();
-    cube_create_p2_allowed_moves();
+    cube_p1_automaton.generate(p1_depth);
+    cube_p2_automaton.generate(p2_depth);
 }
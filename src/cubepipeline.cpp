@@ -0,0 +1,775 @@
+/******************************************************************************
+* File:    cubepipeline.cpp
+*
+* Purpose: Implementation of the CubePipeline class. Phase 1 is searched by a
+*          pool of producer threads, which split the tree between them by
+*          the first move. Each phase 1 solution is packed into an entry and
+*          pushed onto a bounded lock-free queue, which is drained by a pool
+*          of consumer threads running the phase 2 searches. Consumers take
+*          entries in batches and reject those which the phase 2 pruning
+*          tables rule out with one batched lookup. All threads share the
+*          length of the best solution found so far as the bound for their
+*          searches.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <cube.h>
+#include <cubememory.h>
+#include <cubephase.h>
+#include <cubepipeline.h>
+#include <cubesolver.h>
+#include <cubetables.h>
+
+/******************************************************************************
+* Function:  cube_cpu_relax
+*
+* Purpose:   Tells the processor that the thread is waiting in a spin loop.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Issues a pause instruction where there is one, which frees the
+*            core's resources for its other hardware thread for a moment.
+******************************************************************************/
+static inline void cube_cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+/******************************************************************************
+* CubePipeline class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubePipeline::CubePipeline
+*
+* Purpose:   Constructor for the CubePipeline class.
+*
+* Params:    scrambled_cube - The cube to find solutions to.
+*            producers      - The number of threads searching phase 1.
+*            consumers      - The number of threads searching phase 2.
+*            capacity       - The number of phase 1 solutions which can be
+*                             waiting in the queue at once. This is rounded
+*                             up to a power of two.
+*
+* Returns:   Nothing.
+*
+* Operation: Allocates the slots of the queue. The transition and pruning
+*            tables must be filled before solve is called.
+******************************************************************************/
+CubePipeline::CubePipeline(Cube scrambled_cube, int producers, int consumers,
+                           int capacity)
+    : cube(scrambled_cube), head(0), tail(0), bound(INT_MAX), done(false),
+      producers_left(0), num_waiting(0), num_phase1_nodes(0),
+      num_phase2_nodes(0)
+{
+    num_producers = std::max(producers, 1);
+    num_consumers = std::max(consumers, 1);
+    target_length = 0;
+
+    size_t num_slots = 1;
+    while (num_slots < (size_t)capacity)
+    {
+        num_slots *= 2;
+    }
+    slots.reset(new Slot[num_slots]);
+    mask = num_slots - 1;
+}
+
+/******************************************************************************
+* Function:  CubePipeline::try_push
+*
+* Purpose:   Adds an entry to the back of the queue, if there is room.
+*
+* Params:    entry - The entry to add.
+*
+* Returns:   True if the entry was added, false if the queue is full.
+*
+* Operation: Each slot holds a sequence number which says whose turn it is to
+*            use the slot. A producer claims the slot at the tail when its
+*            sequence number equals the tail position, by advancing the tail,
+*            and then publishes the entry by advancing the sequence number.
+******************************************************************************/
+bool CubePipeline::try_push(Entry& entry)
+{
+    size_t pos = tail.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        Slot& slot = slots[pos & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            if (tail.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed))
+            {
+                slot.entry = entry;
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  CubePipeline::try_pop
+*
+* Purpose:   Takes an entry from the front of the queue, if there is one.
+*
+* Params:    entry - Output parameter holding the entry taken.
+*
+* Returns:   True if an entry was taken, false if the queue is empty.
+*
+* Operation: A consumer claims the slot at the head once its entry has been
+*            published, by advancing the head, and then hands the slot back
+*            to the producers for their next lap of the queue.
+******************************************************************************/
+bool CubePipeline::try_pop(Entry& entry)
+{
+    size_t pos = head.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        Slot& slot = slots[pos & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+            if (head.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed))
+            {
+                entry = slot.entry;
+                slot.sequence.store(pos + mask + 1,
+                                    std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  CubePipeline::push
+*
+* Purpose:   Queues the phase 1 solution which a producer has just found.
+*
+* Params:    solver - The producer's solver, holding the moves of the phase 1
+*                     solution and the phase 2 coordinates at its end.
+*
+* Returns:   Nothing.
+*
+* Operation: Refreshes the producer's view of the shared bound, and drops the
+*            position if its prefix alone is too long to beat the bound.
+*            Otherwise, packs it into an entry, waits until there is room for
+*            it in the queue, and wakes a consumer if any are waiting. The
+*            phase 2 pruning tables are left for the consumers to check a
+*            batch at a time.
+******************************************************************************/
+void CubePipeline::push(CubeSolver& solver)
+{
+    solver.max_length = max_length();
+    solver.finished = finished();
+
+    int length = solver.solution.size();
+    if (solver.finished || length > CUBE_PIPELINE_MAX_PREFIX ||
+        length > solver.max_length)
+    {
+        return;
+    }
+
+    Entry entry;
+    entry.cp = solver.curr_cp;
+    entry.ep = solver.curr_ep;
+    entry.ud_perm = solver.curr_ud_perm;
+    entry.length = length;
+    std::copy(solver.solution.begin(), solver.solution.end(), entry.moves);
+
+    while (!try_push(entry))
+    {
+        if (finished())
+        {
+            return;
+        }
+        std::this_thread::yield();
+    }
+    wake_consumers(false);
+}
+
+/******************************************************************************
+* Function:  CubePipeline::record_sol
+*
+* Purpose:   Records a solution found by one of the consumers.
+*
+* Params:    solution - The moves of the solution.
+*
+* Returns:   Nothing.
+*
+* Operation: Under the lock, ignores the solution if another thread has
+*            already found one at least as short. Otherwise, updates the best
+*            solution and the shared bound, executes the callback, and
+*            finishes the search if the solution is short enough.
+******************************************************************************/
+void CubePipeline::record_sol(std::vector<int>& solution)
+{
+    std::lock_guard<std::mutex> guard(best_lock);
+
+    if (!best.empty() && solution.size() >= best.size())
+    {
+        return;
+    }
+
+    best = solution;
+    bound.store(solution.size() - 1);
+    if (process_sol)
+    {
+        process_sol(solution);
+    }
+
+    if ((int)solution.size() <= target_length)
+    {
+        done.store(true);
+        wake_consumers(true);
+    }
+}
+
+/******************************************************************************
+* Function:  CubePipeline::max_length
+*
+* Purpose:   Getter for the bound shared between the threads.
+*
+* Params:    None.
+*
+* Returns:   The maximum length of solution which is still worth looking for,
+*            in the same sense as CubeSolver's max_length.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+int CubePipeline::max_length()
+{
+    return bound.load();
+}
+
+/******************************************************************************
+* Function:  CubePipeline::finished
+*
+* Purpose:   Getter for whether a short enough solution has been found, or
+*            the search has been cancelled.
+*
+* Params:    None.
+*
+* Returns:   True if the threads should stop searching.
+*
+* Operation: Checks the flag set by record_sol and the cancellation token.
+******************************************************************************/
+bool CubePipeline::finished()
+{
+    return done.load() || cancel_token.cancelled();
+}
+
+/******************************************************************************
+* Function:  CubePipeline::produce
+*
+* Purpose:   The body of a producer thread.
+*
+* Params:    id - The index of this producer, from 0 to num_producers - 1.
+*
+* Returns:   Nothing.
+*
+* Operation: Runs the phase 1 search at increasing depths, exactly as the
+*            CubeSolver does, except that only the first moves whose number
+*            is congruent to id modulo num_producers are searched, and the
+*            phase 1 solutions are pushed onto the queue. Phase 1 solutions
+*            longer than an entry can hold are never searched, which loses
+*            nothing since no solution with such a prefix can be shorter
+*            than the first solution found. If the tables are replicated
+*            across NUMA nodes, the thread is first assigned to a node.
+******************************************************************************/
+void CubePipeline::produce(int id)
+{
+    cube_numa_bind_thread(id);
+
+    CubeSolver solver(cube);
+    solver.set_target_length(target_length);
+    solver.pipeline = this;
+    solver.set_cancel(cancel_token);
+    solver.start_search(nullptr);
+
+    int root_co = solver.curr_co;
+    int root_eo = solver.curr_eo;
+    int root_ud_pos = solver.curr_ud_pos;
+
+    for (int depth = 0;
+         depth <= std::min(max_length(), CUBE_PIPELINE_MAX_PREFIX) &&
+         !finished();
+         ++depth)
+    {
+        // The cube itself can only be a phase 1 solution of length zero, so
+        // the first producer takes care of it.
+        if (depth == 0)
+        {
+            if (id == 0)
+            {
+                solver.phase1_search(0);
+            }
+            continue;
+        }
+
+        int root_state = cube_p1_automaton.start();
+        for (uint32_t moves = cube_p1_automaton.moves(root_state);
+             moves != 0; )
+        {
+            int move = cube_next_move(moves);
+            if (move % num_producers != id)
+            {
+                continue;
+            }
+
+            // Check the pruning tables here, since with the fused child
+            // tables phase1_search expects its parent to have done so.
+            int co = cube_co_trans(root_co, move);
+            int eo = cube_eo_trans(root_eo, move);
+            int ud_pos = cube_ud_unsorted_trans(root_ud_pos, move);
+            if (cube_co_eo_prune(co, eo) >= depth ||
+                cube_co_ud_prune(co, ud_pos) >= depth ||
+                cube_eo_ud_prune(eo, ud_pos) >= depth)
+            {
+                continue;
+            }
+
+            solver.curr_co = co;
+            solver.curr_eo = eo;
+            solver.curr_ud_pos = ud_pos;
+            solver.last_move = move;
+            solver.p1_state = cube_p1_automaton.next(root_state, move);
+            solver.solution.assign(1, move);
+            solver.finished = finished();
+
+            solver.phase1_search(depth - 1);
+        }
+
+        solver.curr_co = root_co;
+        solver.curr_eo = root_eo;
+        solver.curr_ud_pos = root_ud_pos;
+        solver.last_move = NUM_MOVES;
+        solver.p1_state = root_state;
+        solver.solution.clear();
+    }
+
+    num_phase1_nodes += solver.num_phase1_nodes;
+    if (--producers_left == 0)
+    {
+        wake_consumers(true);
+    }
+}
+
+/******************************************************************************
+* Function:  CubePipeline::wake_consumers
+*
+* Purpose:   Wakes consumers which are waiting for entries.
+*
+* Params:    all - True to wake every waiting consumer, as when the producers
+*                  have finished, and false to wake one for a new entry.
+*
+* Returns:   Nothing.
+*
+* Operation: Does nothing unless a consumer is waiting, so that a producer
+*            which is keeping the consumers busy never takes the lock. The
+*            lock is taken before notifying so that a consumer which has
+*            checked the queue but not yet started to wait is not missed.
+******************************************************************************/
+void CubePipeline::wake_consumers(bool all)
+{
+    if (num_waiting.load() == 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(wait_lock);
+    if (all)
+    {
+        wait_cond.notify_all();
+    }
+    else
+    {
+        wait_cond.notify_one();
+    }
+}
+
+/******************************************************************************
+* Function:  CubePipeline::wait_for_entries
+*
+* Purpose:   Waits for the queue to become non-empty, or for the producers to
+*            finish.
+*
+* Params:    spins - The number of times in a row that the consumer has found
+*                    the queue empty, which is reset once it is not.
+*
+* Returns:   Nothing.
+*
+* Operation: Backs off in stages, so that a consumer waiting for a moment
+*            does not pay for a sleep, while one waiting for longer gives its
+*            core to the producers: first with pause instructions, then by
+*            yielding, and after that by sleeping on the condition variable
+*            until a producer pushes an entry or finishes. The sleep has a
+*            timeout so that a wakeup which is lost to a race costs no more
+*            than that.
+******************************************************************************/
+void CubePipeline::wait_for_entries(int spins)
+{
+    if (spins < CUBE_PIPELINE_SPINS)
+    {
+        for (int ii = 0; ii < (1 << std::min(spins, 6)); ++ii)
+        {
+            cube_cpu_relax();
+        }
+    }
+    else if (spins < 2 * CUBE_PIPELINE_SPINS)
+    {
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::unique_lock<std::mutex> guard(wait_lock);
+        ++num_waiting;
+        wait_cond.wait_for(guard,
+                           std::chrono::microseconds(CUBE_PIPELINE_SLEEP_US),
+                           [this]() { return head.load() != tail.load() ||
+                                             producers_left.load() == 0 ||
+                                             finished(); });
+        --num_waiting;
+    }
+}
+
+/******************************************************************************
+* Function:  CubePipeline::pop_batch
+*
+* Purpose:   Takes a batch of entries from the front of the queue.
+*
+* Params:    batch - Output array with room for CUBE_PIPELINE_BATCH entries.
+*
+* Returns:   The number of entries taken, which is zero if the queue is empty.
+*
+* Operation: Takes entries one at a time until the batch is full or the queue
+*            is empty.
+******************************************************************************/
+int CubePipeline::pop_batch(Entry* batch)
+{
+    int count = 0;
+    while (count < CUBE_PIPELINE_BATCH && try_pop(batch[count]))
+    {
+        ++count;
+    }
+    return count;
+}
+
+/******************************************************************************
+* Function:  CubePipeline::search_entry
+*
+* Purpose:   Runs the phase 2 search from one entry.
+*
+* Params:    solver - The consumer's solver.
+*            entry  - The phase 1 solution to search from.
+*
+* Returns:   Nothing.
+*
+* Operation: Unpacks the entry into the solver and runs the phase 2 search
+*            from it with the current shared bound.
+******************************************************************************/
+void CubePipeline::search_entry(CubeSolver& solver, Entry& entry)
+{
+    solver.max_length = max_length();
+    solver.finished = false;
+    solver.solution.assign(entry.moves, entry.moves + entry.length);
+    solver.last_move = (entry.length == 0) ? (int)NUM_MOVES
+                                           : (int)entry.moves[entry.length - 1];
+    solver.curr_cp = entry.cp;
+    solver.curr_ep = entry.ep;
+    solver.curr_ud_perm = entry.ud_perm;
+
+    // The auxiliary coordinates are only needed for the near-solved table,
+    // so they are worked out again from the moves only when it is loaded.
+    int ud_sorted = solver.start_ud_sorted;
+    int rl_sorted = solver.start_rl_sorted;
+    int fb_sorted = solver.start_fb_sorted;
+    if (cube_near_table.depth() >= 0)
+    {
+        for (int move : solver.solution)
+        {
+            ud_sorted = cube_ud_sorted_trans(ud_sorted, move);
+            rl_sorted = cube_rl_sorted_trans(rl_sorted, move);
+            fb_sorted = cube_fb_sorted_trans(fb_sorted, move);
+        }
+    }
+
+    solver.phase2_start(ud_sorted, rl_sorted, fb_sorted);
+}
+
+/******************************************************************************
+* Function:  CubePipeline::consume
+*
+* Purpose:   The body of a consumer thread.
+*
+* Params:    id - The index of this consumer, from 0 to num_consumers - 1.
+*
+* Returns:   Nothing.
+*
+* Operation: Repeatedly takes a batch of entries from the queue and looks up
+*            the phase 2 pruning values of the whole batch at once. Entries
+*            whose lower bound shows that they cannot beat the current shared
+*            bound are discarded, and a phase 2 search is run from each of
+*            the others. While the queue is empty, the thread backs off with
+*            wait_for_entries. Once every producer has finished, the
+*            remaining entries are drained and the thread exits. Consumers
+*            are assigned to NUMA nodes following on from the producers.
+******************************************************************************/
+void CubePipeline::consume(int id)
+{
+    cube_numa_bind_thread(num_producers + id);
+
+    CubeSolver solver(cube);
+    solver.set_target_length(target_length);
+    solver.pipeline = this;
+    solver.set_cancel(cancel_token);
+    solver.start_search(nullptr);
+
+    Entry batch[CUBE_PIPELINE_BATCH];
+    int cp[CUBE_PIPELINE_BATCH];
+    int ep[CUBE_PIPELINE_BATCH];
+    int ud_perm[CUBE_PIPELINE_BATCH];
+    int cp_bound[CUBE_PIPELINE_BATCH];
+    int ep_bound[CUBE_PIPELINE_BATCH];
+
+    int spins = 0;
+    while (true)
+    {
+        int count = pop_batch(batch);
+        if (count == 0)
+        {
+            if (producers_left.load() > 0)
+            {
+                wait_for_entries(spins++);
+                continue;
+            }
+
+            count = pop_batch(batch);
+            if (count == 0)
+            {
+                break;
+            }
+        }
+        spins = 0;
+
+        if (finished())
+        {
+            continue;
+        }
+
+        for (int ii = 0; ii < count; ++ii)
+        {
+            cp[ii] = batch[ii].cp;
+            ep[ii] = batch[ii].ep;
+            ud_perm[ii] = batch[ii].ud_perm;
+        }
+        cube_cp_ud_prune.gather(cp, ud_perm, count, cp_bound);
+        cube_ep_ud_prune.gather(ep, ud_perm, count, ep_bound);
+
+        for (int ii = 0; ii < count; ++ii)
+        {
+            int length = batch[ii].length + std::max(cp_bound[ii],
+                                                     ep_bound[ii]);
+            if (length <= max_length())
+            {
+                search_entry(solver, batch[ii]);
+            }
+        }
+    }
+
+    num_phase2_nodes += solver.num_phase2_nodes;
+}
+
+/******************************************************************************
+* Function:  CubePipeline::set_target_length
+*
+* Purpose:   Sets the length of solution which is good enough to stop at.
+*
+* Params:    length - As for CubeSolver::set_target_length.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply store the value.
+******************************************************************************/
+void CubePipeline::set_target_length(int length)
+{
+    target_length = length;
+}
+
+/******************************************************************************
+* Function:  CubePipeline::set_cancel
+*
+* Purpose:   Sets the token which cancels the search.
+*
+* Params:    token - A token whose cancel function will stop any call to solve
+*                    which is running or is later made.
+*
+* Returns:   Nothing.
+*
+* Operation: Stores the token, which every thread's solver is also given.
+*            A producer or consumer in the middle of a search notices within
+*            CUBE_CANCEL_INTERVAL nodes, and one which is waiting for entries
+*            notices within CUBE_PIPELINE_SLEEP_US, after which the shortest
+*            solution found so far is left in best_solution.
+******************************************************************************/
+void CubePipeline::set_cancel(const CubeCancel& token)
+{
+    cancel_token = token;
+}
+
+/******************************************************************************
+* Function:  CubePipeline::solve
+*
+* Purpose:   Finds solutions to the cube.
+*
+* Params:    callback - A callback which will be called on each solution
+*                       which is shorter than all those before it. Calls are
+*                       never made concurrently.
+*
+* Returns:   Nothing.
+*
+* Operation: Resets the queue and the shared state, reads off a solution
+*            from the near-solved table if possible, and otherwise starts the
+*            producer and consumer threads and waits for them all to finish.
+******************************************************************************/
+void CubePipeline::solve(std::function<void(std::vector<int>&)> callback)
+{
+    cube_fill_phase1_tables();
+    cube_fill_phase2_tables();
+
+    // Reset the shared state and the queue.
+    process_sol = callback;
+    best.clear();
+    bound.store(INT_MAX);
+    done.store(false);
+    num_phase1_nodes.store(0);
+    num_phase2_nodes.store(0);
+    head.store(0);
+    tail.store(0);
+    for (size_t ii = 0; ii <= mask; ++ii)
+    {
+        slots[ii].sequence.store(ii);
+    }
+
+    // If the cube is close enough to solved to be in the near-solved table,
+    // then there is nothing to search.
+    CubeSolver solver(cube);
+    solver.set_target_length(target_length);
+    solver.pipeline = this;
+    solver.set_cancel(cancel_token);
+    if (solver.start_search(nullptr))
+    {
+        done.store(true);
+        return;
+    }
+
+    // Start the threads and wait for them to finish.
+    producers_left.store(num_producers);
+    std::vector<std::thread> threads;
+    for (int id = 0; id < num_producers; ++id)
+    {
+        threads.push_back(std::thread(&CubePipeline::produce, this, id));
+    }
+    for (int id = 0; id < num_consumers; ++id)
+    {
+        threads.push_back(std::thread(&CubePipeline::consume, this, id));
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/******************************************************************************
+* Function:  CubePipeline::best_solution
+*
+* Purpose:   Getter for the shortest solution found by the last call to solve.
+*
+* Params:    None.
+*
+* Returns:   The moves of the shortest solution found.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+std::vector<int> CubePipeline::best_solution()
+{
+    return best;
+}
+
+/******************************************************************************
+* Function:  CubePipeline::phase1_nodes
+*
+* Purpose:   Getter for the number of phase 1 nodes visited by the last call
+*            to solve.
+*
+* Params:    None.
+*
+* Returns:   The total over all the producer threads.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubePipeline::phase1_nodes()
+{
+    return num_phase1_nodes.load();
+}
+
+/******************************************************************************
+* Function:  CubePipeline::phase2_nodes
+*
+* Purpose:   Getter for the number of phase 2 nodes visited by the last call
+*            to solve.
+*
+* Params:    None.
+*
+* Returns:   The total over all the consumer threads.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubePipeline::phase2_nodes()
+{
+    return num_phase2_nodes.load();
+}
@@ -1,70 +1,161 @@
 /******************************************************************************
 * File:    cubeprune.cpp
 *
-* Purpose: Implementation of the CubePrune class, representing a single pruning
-*          table for use in the Kociemba algorithm.
+* Purpose: Implementation of the CubePrune class template, representing a
+*          single pruning table for use in the Kociemba algorithm.
 ******************************************************************************/
 
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
+#include <cstdint>
 #include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include <cube.h>
 #include <cubephase.h>
 #include <cubeprune.h>
+#include <cubetables.h>
 #include <cubetrans.h>
 
 /******************************************************************************
-* CubePrune class implementation.
+* CubePrune class template implementation.
 ******************************************************************************/
 
 /******************************************************************************
 * Function:  CubePrune::CubePrune
 *
-* Purpose:   Constructor for the CubePrune class.
+* Purpose:   Constructor for the CubePrune class template.
+*
+* Params:    trans_table_1 - The transition tables of the cube coordinates
+*            trans_table_2   that this table is for.
+*
+* Returns:   Nothing.
+*
+* Operation: Stores the transition tables. No space is allocated for the
+*            data in the pruning table until it is filled.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+CubePrune<Trans1, Trans2, Phase>::CubePrune(Trans1& trans_table_1,
+                                            Trans2& trans_table_2)
+    : transition_table_1(trans_table_1), transition_table_2(trans_table_2)
+{
+}
+
+/******************************************************************************
+* Function:  CubePrune::gather
+*
+* Purpose:   Looks up a batch of entries in the pruning table.
 *
-* Params:    phase_desc    - Whether this pruning table is relevant in phase 1
-*                            or phase 2 of the two-phase algorithm.
-*            trans_table_1 - Pointers to the transition tables of the cube
-*            trans_table_2 - coordinates that this table is for.
+* Params:    coords_1 - The first coordinate of each position to look up.
+*            coords_2 - The second coordinate of each position to look up.
+*            count    - The number of positions.
+*            values   - Output array holding the value stored in the table for
+*                       each position.
 *
 * Returns:   Nothing.
 *
-* Operation: Uses the phase to store the available moves, and stores the
-*            transition tables. Allocates space for the data in the pruning
-*            table.
+* Operation: When built with AVX2, the positions are looked up eight at a
+*            time with a single gather instruction, so that the cache misses
+*            for all of them overlap. There is no gather of single bytes, so
+*            four bytes are read from the start of each entry and all but the
+*            first are masked off, which is why the table has padding at the
+*            end. Any positions left over, or all of them without AVX2, are
+*            looked up one at a time.
 ******************************************************************************/
-CubePrune::CubePrune(int phase_desc,
-                     CubeTrans* trans_table_1, CubeTrans* trans_table_2)
+template <class Trans1, class Trans2, int Phase>
+void CubePrune<Trans1, Trans2, Phase>::gather(const int* coords_1,
+                                              const int* coords_2, int count,
+                                              int* values)
 {
-    phase = phase_desc;
-    transition_table_1 = trans_table_1;
-    transition_table_2 = trans_table_2;
+    int ii = 0;
 
-    table = std::vector<std::vector<int>>(
-                                  trans_table_1->size(),
-                                  std::vector<int>(trans_table_2->size(), -1));
+#ifdef __AVX2__
+    __m256i stride = _mm256_set1_epi32(size_2);
+    __m256i low_byte = _mm256_set1_epi32(UINT8_MAX);
+    for ( ; ii + 8 <= count; ii += 8)
+    {
+        __m256i coord_1 = _mm256_loadu_si256((const __m256i*)&coords_1[ii]);
+        __m256i coord_2 = _mm256_loadu_si256((const __m256i*)&coords_2[ii]);
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(coord_1, stride),
+                                         coord_2);
+        __m256i value = _mm256_i32gather_epi32((const int*)table.data(),
+                                               index, 1);
+        value = _mm256_and_si256(value, low_byte);
+        _mm256_storeu_si256((__m256i*)&values[ii], value);
+    }
+#endif
+
+    for ( ; ii < count; ++ii)
+    {
+        values[ii] = table[(size_t)coords_1[ii] * size_2 + coords_2[ii]];
+    }
 }
 
 /******************************************************************************
-* Function:  CubePrune::operator()
+* Function:  CubePrune::has_children
 *
-* Purpose:   Returns an entry in the pruning table.
+* Purpose:   Determines whether the fused child table has been filled.
 *
-* Params:    coord_value_1 - The coordinate values of the position to look up.
-*            coord_value_2
+* Params:    None.
 *
-* Returns:   The value stored in the table for that combination of coordinates.
+* Returns:   True if fill_children has been called, false otherwise.
 *
-* Operation: Simply return the value from the private table.
+* Operation: Checks whether any space has been allocated for the table.
 ******************************************************************************/
-int CubePrune::operator()(int coord_value_1, int coord_value_2)
+template <class Trans1, class Trans2, int Phase>
+bool CubePrune<Trans1, Trans2, Phase>::has_children()
 {
-    return table[coord_value_1][coord_value_2];
+    return !child_table.empty();
+}
+
+/******************************************************************************
+* Function:  CubePrune::bytes
+*
+* Purpose:   Calculates the memory used by the pruning table.
+*
+* Params:    None.
+*
+* Returns:   The number of bytes allocated for the table and its fused child
+*            table, all of which have been written once the tables are
+*            filled, counting every copy if they have been replicated across
+*            NUMA nodes.
+*
+* Operation: Adds up the sizes of the two arrays.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+size_t CubePrune<Trans1, Trans2, Phase>::bytes()
+{
+    return table.bytes() + child_table.bytes();
+}
+
+/******************************************************************************
+* Function:  CubePrune::placement
+*
+* Purpose:   Reports which NUMA nodes hold the pruning table.
+*
+* Params:    node_bytes - Array of the number of bytes on each node, which
+*                         the bytes of the table and its fused child table
+*                         are added to.
+*
+* Returns:   Nothing.
+*
+* Operation: Passes the request on to the two arrays.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+void CubePrune<Trans1, Trans2, Phase>::placement(
+                                             std::vector<size_t>& node_bytes)
+{
+    table.placement(node_bytes);
+    child_table.placement(node_bytes);
 }
 
 /******************************************************************************
@@ -78,9 +169,13 @@ int CubePrune::operator()(int coord_value_1, int coord_value_2)
 *
 * Operation: Starting from the solved position, at depth 0, perform a
 *            breadth-first search of the shared coordinate space and store the
-*            depth from solved of each position.
+*            depth from solved of each position. The table is stored in a
+*            single block with the entries for each value of the first
+*            coordinate together, one byte for each. The transition tables
+*            must already be filled.
 ******************************************************************************/
-void CubePrune::fill()
+template <class Trans1, class Trans2, int Phase>
+void CubePrune<Trans1, Trans2, Phase>::fill()
 {
     // Local variables
     std::pair<int, int> curr_position, next_position;
@@ -88,23 +183,15 @@ void CubePrune::fill()
 
     // Set up a deque which we will use to perform the breadth-first search.
     std::deque<std::pair<int, int>> bfs;
+    table.assign((size_t)size_1 * size_2 + CUBE_PRUNE_PADDING,
+                 CUBE_PRUNE_EMPTY);
 
     // Push the solved position onto the deque and record the depth of the
     // solved position.
-    int solved_1 = transition_table_1->solved_pos();
-    int solved_2 = transition_table_2->solved_pos();
+    int solved_1 = transition_table_1.solved_pos();
+    int solved_2 = transition_table_2.solved_pos();
     bfs.push_back(std::make_pair(solved_1, solved_2));
-    table[solved_1][solved_2] = 0;
-
-    // Work out the available moves
-    if (phase == PHASE_1)
-    {
-        allowed_moves = cube_p1_allowed_moves[NUM_MOVES];
-    }
-    else if (phase == PHASE_2)
-    {
-        allowed_moves = cube_p2_allowed_moves[NUM_MOVES];
-    }
+    table[(size_t)solved_1 * size_2 + solved_2] = 0;
 
     // Perform the breadth-first search
     while (!bfs.empty())
@@ -112,20 +199,110 @@ void CubePrune::fill()
         // Get the top position from the deque, and record the depths of all of
         // its children positions.
         curr_position = bfs.front();
-        depth = table[curr_position.first][curr_position.second];
+        depth = table[(size_t)curr_position.first * size_2 +
+                      curr_position.second];
         bfs.pop_front();
 
-        for (int move : allowed_moves)
+        for (uint32_t moves = allowed_moves; moves != 0; )
         {
+            int move = cube_next_move(moves);
             next_position = std::make_pair(
-                            (*transition_table_1)(curr_position.first,  move),
-                            (*transition_table_2)(curr_position.second, move));
+                            transition_table_1(curr_position.first,  move),
+                            transition_table_2(curr_position.second, move));
 
-            if (table[next_position.first][next_position.second] == -1)
+            size_t next_index = (size_t)next_position.first * size_2 +
+                                next_position.second;
+            if (table[next_index] == CUBE_PRUNE_EMPTY)
             {
                 bfs.push_back(next_position);
-                table[next_position.first][next_position.second] = depth + 1;
+                table[next_index] = depth + 1;
             }
         }
     }
 }
+
+/******************************************************************************
+* Function:  CubePrune::fill_once
+*
+* Purpose:   Fill in the entries in this pruning table if they have not
+*            already been filled, along with the transition tables it needs.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Uses std::call_once, as CubeTrans::fill_once does. The two
+*            transition tables do not depend on each other, so the second is
+*            filled on a separate thread while this one fills the first. Once
+*            filled, the table is copied onto each NUMA node if the tables
+*            are replicated.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+void CubePrune<Trans1, Trans2, Phase>::fill_once()
+{
+    std::call_once(filled, [this]()
+    {
+        std::thread other([this]() { transition_table_2.fill_once(); });
+        transition_table_1.fill_once();
+        other.join();
+
+        fill();
+        table.replicate();
+    });
+}
+
+/******************************************************************************
+* Function:  CubePrune::fill_children
+*
+* Purpose:   Fill in the entries of the fused child table.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: For every pair of coordinate values and every allowed move, looks
+*            up the resulting pair of coordinate values in the transition
+*            tables and stores its pruning value. Moves which are not allowed
+*            in this phase are given the largest possible value, so that they
+*            are always pruned. The pruning table must already be filled.
+*            Once filled, the child table is copied onto each NUMA node if
+*            the tables are replicated.
+******************************************************************************/
+template <class Trans1, class Trans2, int Phase>
+void CubePrune<Trans1, Trans2, Phase>::fill_children()
+{
+    child_table.assign((size_t)size_1 * size_2 * NUM_MOVES, UINT8_MAX);
+
+    for (int coord_1 = 0; coord_1 < size_1; ++coord_1)
+    {
+        for (int coord_2 = 0; coord_2 < size_2; ++coord_2)
+        {
+            uint8_t* row = &child_table[((size_t)coord_1 * size_2 + coord_2) *
+                                        NUM_MOVES];
+
+            for (uint32_t moves = allowed_moves; moves != 0; )
+            {
+                int move = cube_next_move(moves);
+                row[move] = table[
+                         (size_t)transition_table_1(coord_1, move) * size_2 +
+                         transition_table_2(coord_2, move)];
+            }
+        }
+    }
+
+    child_table.replicate();
+}
+
+/******************************************************************************
+* Explicit instantiations for the tables declared in cubetables.h
+******************************************************************************/
+template class CubePrune<decltype(cube_co_trans), decltype(cube_eo_trans),
+                         PHASE_1>;
+template class CubePrune<decltype(cube_co_trans),
+                         decltype(cube_ud_unsorted_trans), PHASE_1>;
+template class CubePrune<decltype(cube_eo_trans),
+                         decltype(cube_ud_unsorted_trans), PHASE_1>;
+template class CubePrune<decltype(cube_ep_trans), decltype(cube_ud_perm_trans),
+                         PHASE_2>;
+template class CubePrune<decltype(cube_cp_trans), decltype(cube_ud_perm_trans),
+                         PHASE_2>;
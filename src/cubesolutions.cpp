@@ -0,0 +1,223 @@
+/******************************************************************************
+* File:    cubesolutions.cpp
+*
+* Purpose: Implementation of the CubeSolutions class. The phase 1 search is
+*          run by a CubeWalker, as in CubeBatch, so that it can stop after
+*          any step and carry on from the same place later. Each
+*          phase 1 solution is searched in phase 2 straight away by a
+*          CubeSolver, and the solutions which that finds are held until the
+*          caller asks for them. Since each solution found is shorter than
+*          the one before, only a few are ever held at once.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <cube.h>
+#include <cubephase.h>
+#include <cubesolutions.h>
+#include <cubesolver.h>
+#include <cubetables.h>
+#include <cubewalker.h>
+
+/******************************************************************************
+* CubeSolutions class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeSolutions::CubeSolutions
+*
+* Purpose:   Constructor for the CubeSolutions class.
+*
+* Params:    cube - The cube to find solutions to.
+*
+* Returns:   Nothing.
+*
+* Operation: Sets up the solver for the cube. Nothing is searched until the
+*            first call to next.
+******************************************************************************/
+CubeSolutions::CubeSolutions(Cube cube) : solver(cube)
+{
+    started = false;
+    done = false;
+}
+
+/******************************************************************************
+* Function:  CubeSolutions::CubeSolutions
+*
+* Purpose:   Constructor for the CubeSolutions class.
+*
+* Params:    coords - The coordinates of the cube to find solutions to.
+*
+* Returns:   Nothing.
+*
+* Operation: Sets up the solver for the cube. Nothing is searched until the
+*            first call to next.
+******************************************************************************/
+CubeSolutions::CubeSolutions(const CubeCoords& coords) : solver(coords)
+{
+    started = false;
+    done = false;
+}
+
+/******************************************************************************
+* Function:  CubeSolutions::set_target_length
+*
+* Purpose:   Sets the length of solution which is good enough to stop at.
+*
+* Params:    length - As for CubeSolver::set_target_length. Once a solution
+*                     of at most this many moves has been handed out, there
+*                     are no more solutions.
+*
+* Returns:   Nothing.
+*
+* Operation: Passes the value on to the solver.
+******************************************************************************/
+void CubeSolutions::set_target_length(int length)
+{
+    solver.set_target_length(length);
+}
+
+/******************************************************************************
+* Function:  CubeSolutions::set_cancel
+*
+* Purpose:   Sets the token which cancels the search.
+*
+* Params:    token - As for CubeSolver::set_cancel. Once the token has been
+*                    cancelled, next hands out any solutions already found
+*                    and then reports that there are no more.
+*
+* Returns:   Nothing.
+*
+* Operation: Passes the token on to the solver.
+******************************************************************************/
+void CubeSolutions::set_cancel(const CubeCancel& token)
+{
+    solver.set_cancel(token);
+}
+
+/******************************************************************************
+* Function:  CubeSolutions::start
+*
+* Purpose:   Prepares the search.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Fills any of the tables which are not yet filled, and starts
+*            the walker with a callback which holds each solution for next
+*            to hand out.
+******************************************************************************/
+void CubeSolutions::start()
+{
+    cube_fill_phase1_tables();
+    cube_fill_phase2_tables();
+    started = true;
+
+    if (!walker.start(solver, [this](std::vector<int>& solution)
+                              { pending.push_back(solution); }))
+    {
+        // The near-solved table has already solved this cube.
+        done = true;
+    }
+}
+
+/******************************************************************************
+* Function:  CubeSolutions::step
+*
+* Purpose:   Advances the search by one phase 1 position.
+*
+* Params:    None.
+*
+* Returns:   True if there is more of the search to do, and false if it is
+*            over.
+*
+* Operation: Asks the walker for the next position, visiting any phase 1
+*            solutions on the way, and expands it.
+******************************************************************************/
+bool CubeSolutions::step()
+{
+    int co, eo, ud_pos, state;
+    if (!walker.next_node(co, eo, ud_pos, state))
+    {
+        return false;
+    }
+
+    walker.expand(co, eo, ud_pos, state);
+    return true;
+}
+
+/******************************************************************************
+* Function:  CubeSolutions::next
+*
+* Purpose:   Finds the next solution to the cube.
+*
+* Params:    solution - Output parameter holding the moves of the solution.
+*
+* Returns:   True if a solution was found, and false if there are no more.
+*
+* Operation: Hands out a solution found earlier if there is one, and
+*            otherwise runs the search until it finds one or is over. Each
+*            solution is shorter than the one before it, so the last is the
+*            best solution found. The object must not be copied once next
+*            has been called, as the solver holds a pointer to it.
+******************************************************************************/
+bool CubeSolutions::next(std::vector<int>& solution)
+{
+    if (!started)
+    {
+        start();
+    }
+
+    while (pending.empty() && !done)
+    {
+        done = !step();
+    }
+
+    if (pending.empty())
+    {
+        return false;
+    }
+
+    solution = std::move(pending.front());
+    pending.pop_front();
+    return true;
+}
+
+/******************************************************************************
+* Function:  CubeSolutions::phase1_nodes
+*
+* Purpose:   Getter for the number of phase 1 nodes visited so far.
+*
+* Params:    None.
+*
+* Returns:   The number of phase 1 nodes, counted in the same way as
+*            CubeSolver::phase1_nodes.
+*
+* Operation: Read the value from the solver.
+******************************************************************************/
+uint64_t CubeSolutions::phase1_nodes()
+{
+    return solver.phase1_nodes();
+}
+
+/******************************************************************************
+* Function:  CubeSolutions::phase2_nodes
+*
+* Purpose:   Getter for the number of phase 2 nodes visited so far.
+*
+* Params:    None.
+*
+* Returns:   The number of phase 2 positions searched.
+*
+* Operation: Read the value from the solver.
+******************************************************************************/
+uint64_t CubeSolutions::phase2_nodes()
+{
+    return solver.phase2_nodes();
+}
@@ -2,7 +2,8 @@
 * File:    cubesolver.cpp
 *
 * Purpose: Implementation of the CubeSolver class which uses the Kociemba
-*          algorithm to quickly find near-optimal solutions to the cube.
+*          algorithm to quickly find near-optimal solutions to the cube, and
+*          of the CubeCancel tokens which stop it.
 ******************************************************************************/
 
 /******************************************************************************
@@ -10,11 +11,14 @@
 ******************************************************************************/
 #include <algorithm>
 #include <climits>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include <cube.h>
 #include <cubephase.h>
+#include <cubepipeline.h>
 #include <cubetables.h>
 #include <cubesolver.h>
 
@@ -35,19 +39,8 @@
 *            to a cube given by the default Constructor of the Cube class.
 ******************************************************************************/
 CubeSolver::CubeSolver()
+    : CubeSolver(Cube())
 {
-    Cube cube;
-
-    // Calculate the starting values of the phase 1 coordinates.
-    curr_co = cube.coord_corner_orientation();
-    curr_eo = cube.coord_edge_orientation();
-    curr_ud_pos = cube.coord_ud_unsorted();
-
-    // Calculate the starting values of the auxiliary coordinates.
-    start_ud_sorted = cube.coord_ud_sorted();
-    start_rl_sorted = cube.coord_rl_sorted();
-    start_fb_sorted = cube.coord_fb_sorted();
-    start_cp  = cube.coord_corner_permutation();
 }
 
 /******************************************************************************
@@ -60,21 +53,56 @@ CubeSolver::CubeSolver()
 *
 * Returns:   Nothing.
 *
-* Operation: Sets the private member variable cube to be equal to the cube
-*            object which was passed in.
+* Operation: Works out the coordinates of the cube, and sets up from those.
 ******************************************************************************/
 CubeSolver::CubeSolver(Cube scrambled_cube)
+    : CubeSolver(scrambled_cube.coords())
+{
+}
+
+/******************************************************************************
+* Function:  CubeSolver::CubeSolver
+*
+* Purpose:   Constructor for the CubeSolver class, which the others delegate
+*            to.
+*
+* Params:    coords - The coordinates of the position we are trying to find a
+*                     solution to.
+*
+* Returns:   Nothing.
+*
+* Operation: Takes the starting values of the coordinates directly, so that
+*            a scramble which has been applied to the coordinates through the
+*            transition tables never has to be built as a Cube, and sets the
+*            options to their defaults. The state which the getters read is
+*            cleared as well, so that they give a solver which has not been
+*            run yet no solution, no nodes and no cancellation.
+******************************************************************************/
+CubeSolver::CubeSolver(const CubeCoords& coords)
 {
-    // Calculate the starting values of the phase 1 coordinates.
-    curr_co = scrambled_cube.coord_corner_orientation();
-    curr_eo = scrambled_cube.coord_edge_orientation();
-    curr_ud_pos = scrambled_cube.coord_ud_unsorted();
+    max_length = INT_MAX;
+    target_length = 0;
+    enumerate_length = 0;
+    finished = false;
+    was_cancelled = false;
+    use_prefetch = true;
+    use_child_ordering = false;
+    num_phase1_nodes = 0;
+    num_phase2_nodes = 0;
+    num_phase1_leaves = 0;
+    pipeline = nullptr;
+    trace = nullptr;
 
-    // Calculate the starting values of the auxiliary coordinates.
-    start_ud_sorted = scrambled_cube.coord_ud_sorted();
-    start_rl_sorted = scrambled_cube.coord_rl_sorted();
-    start_fb_sorted = scrambled_cube.coord_fb_sorted();
-    start_cp  = scrambled_cube.coord_corner_permutation();
+    // Take the starting values of the phase 1 coordinates.
+    curr_co = coords.co;
+    curr_eo = coords.eo;
+    curr_ud_pos = Cube::ud_unsorted_calc(coords.ud_sorted);
+
+    // Take the starting values of the auxiliary coordinates.
+    start_ud_sorted = coords.ud_sorted;
+    start_rl_sorted = coords.rl_sorted;
+    start_fb_sorted = coords.fb_sorted;
+    start_cp  = coords.cp;
 }
 
 /******************************************************************************
@@ -92,61 +120,172 @@ CubeSolver::CubeSolver(Cube scrambled_cube)
 ******************************************************************************/
 void CubeSolver::phase1_search(int depth)
 {
+    // Stop searching once a short enough solution has been found.
+    if (finished)
+    {
+        return;
+    }
+    ++num_phase1_nodes;
+
+    // Every so often, check whether the search has been cancelled.
+    if ((num_phase1_nodes & (CUBE_CANCEL_INTERVAL - 1)) == 0 && poll_cancel())
+    {
+        return;
+    }
+
     // If the depth is zero, then check if we have a valid phase 1 solution.
     if (depth == 0 &&
         curr_co == cube_co_trans.solved_pos() &&
         curr_eo == cube_eo_trans.solved_pos() &&
         curr_ud_pos == cube_ud_unsorted_trans.solved_pos() &&
-        std::find(cube_p2_allowed_moves[NUM_MOVES].begin(),
-                  cube_p2_allowed_moves[NUM_MOVES].end(), last_move)
-                                     == cube_p2_allowed_moves[NUM_MOVES].end())
+        (cube_p2_allowed_moves[NUM_MOVES] & CUBE_MOVE_BIT(last_move)) == 0)
     {
-        // Initialise the phase 2 starting coordinates and call into the phase
-        // 2 search from this position
-        int ud_sorted = start_ud_sorted;
-        int rl_sorted = start_rl_sorted;
-        int fb_sorted = start_fb_sorted;
-        int coord_cp  = start_cp;
-
-        for (int move : solution)
-        {
-            ud_sorted = cube_ud_sorted_trans(ud_sorted, move);
-            rl_sorted = cube_rl_sorted_trans(rl_sorted, move);
-            fb_sorted = cube_fb_sorted_trans(fb_sorted, move);
-            coord_cp  = cube_cp_trans(coord_cp, move);
-        }
-
-        curr_cp = coord_cp;
-        curr_ep = Cube::edge_permutation_calc(rl_sorted, fb_sorted);
-        curr_ud_perm = Cube::ud_permutation_calc(ud_sorted);
-
-        for (int depth2 = 0;
-             (int)(depth2 + solution.size()) <= max_length;
-             ++depth2)
-        {
-            phase2_search(depth2);
-        }
+        ++num_phase1_leaves;
+        phase1_leaf();
     }
 
     // If the depth is not zero, then check the pruning tables to see if we
     // should prune this branch or not, and then check all available moves.
+    // If the fused child tables are loaded, then this position has already
+    // been checked against the pruning tables by its parent.
     else if (depth > 0)
     {
-        if (cube_co_eo_prune(curr_co, curr_eo) <= depth &&
-            cube_co_ud_prune(curr_co, curr_ud_pos) <= depth &&
-            cube_eo_ud_prune(curr_eo, curr_ud_pos) <= depth)
+        if (use_fused_prune ||
+            (cube_co_eo_prune(curr_co, curr_eo) <= depth &&
+             cube_co_ud_prune(curr_co, curr_ud_pos) <= depth &&
+             cube_eo_ud_prune(curr_eo, curr_ud_pos) <= depth))
         {
+            // With the transposition table enabled, skip positions which are
+            // already known to have no phase 1 solutions of this length.
+            uint64_t key = 0;
+            uint64_t old_leaves = num_phase1_leaves;
+            if (!transpositions.empty())
+            {
+                key = transposition_key(depth);
+                if (transpositions[transposition_slot(key)] == key)
+                {
+                    return;
+                }
+            }
+
             int old_co = curr_co;
             int old_eo = curr_eo;
             int old_ud_pos = curr_ud_pos;
 
-            for (int move : cube_p1_allowed_moves[last_move])
+            const uint8_t* co_eo_children = nullptr;
+            const uint8_t* co_ud_children = nullptr;
+            const uint8_t* eo_ud_children = nullptr;
+            if (use_fused_prune)
+            {
+                co_eo_children = cube_co_eo_prune.children(old_co, old_eo);
+                co_ud_children = cube_co_ud_prune.children(old_co, old_ud_pos);
+                eo_ud_children = cube_eo_ud_prune.children(old_eo, old_ud_pos);
+            }
+
+            // In a first pass, work out the coordinates of each child, and
+            // start fetching the pruning table entries which it will look up,
+            // so that they are ready by the time we recurse into it.
+            int child_co[NUM_MOVES];
+            int child_eo[NUM_MOVES];
+            int child_ud_pos[NUM_MOVES];
+            uint32_t children = 0;
+
+            // When enumerating, the plain allowed moves are used instead of
+            // the automaton, since a generated automaton keeps only one of
+            // the sequences which reach the same position, and each of them
+            // is a distinct solution.
+            int old_state = p1_state;
+            uint32_t allowed = (enumerate_length > 0) ?
+                               cube_p1_allowed_moves[last_move] :
+                               cube_p1_automaton.moves(old_state);
+            for (uint32_t moves = allowed; moves != 0; )
             {
-                curr_co = cube_co_trans(old_co, move);
-                curr_eo = cube_eo_trans(old_eo, move);
-                curr_ud_pos = cube_ud_unsorted_trans(old_ud_pos, move);
+                int move = cube_next_move(moves);
+
+                // With the fused child tables, skip any child which cannot
+                // reach a phase 1 solution in the remaining depth.
+                if (use_fused_prune &&
+                    (co_eo_children[move] >= depth ||
+                     co_ud_children[move] >= depth ||
+                     eo_ud_children[move] >= depth))
+                {
+                    continue;
+                }
+
+                child_co[move] = cube_co_trans(old_co, move);
+                child_eo[move] = cube_eo_trans(old_eo, move);
+                child_ud_pos[move] = cube_ud_unsorted_trans(old_ud_pos, move);
+                children |= CUBE_MOVE_BIT(move);
+
+                if (use_prefetch && depth > 1)
+                {
+                    prefetch_phase1(child_co[move], child_eo[move],
+                                    child_ud_pos[move]);
+                }
+            }
+
+            // Decide the order in which to visit the children. By default
+            // this is the fixed move order, but with child ordering enabled
+            // the pruning value of every child is worked out first, children
+            // which cannot reach a phase 1 solution in the remaining depth
+            // are dropped, and the rest are sorted by their pruning value.
+            int order[NUM_MOVES];
+            int bound[NUM_MOVES];
+            int num_children = 0;
+
+            while (children != 0)
+            {
+                int move = cube_next_move(children);
+                int child_bound = 0;
+
+                if (use_child_ordering)
+                {
+                    if (use_fused_prune)
+                    {
+                        child_bound = std::max({(int)co_eo_children[move],
+                                                (int)co_ud_children[move],
+                                                (int)eo_ud_children[move]});
+                    }
+                    else
+                    {
+                        int co = child_co[move];
+                        int eo = child_eo[move];
+                        int ud_pos = child_ud_pos[move];
+                        child_bound = std::max({cube_co_eo_prune(co, eo),
+                                                cube_co_ud_prune(co, ud_pos),
+                                                cube_eo_ud_prune(eo, ud_pos)});
+                    }
+
+                    if (child_bound >= depth)
+                    {
+                        continue;
+                    }
+                }
+
+                // Insert the child into the order, after any children with
+                // the same bound so that ties stay in move order.
+                int pos = num_children++;
+                while (pos > 0 && bound[pos - 1] > child_bound)
+                {
+                    order[pos] = order[pos - 1];
+                    bound[pos] = bound[pos - 1];
+                    --pos;
+                }
+                order[pos] = move;
+                bound[pos] = child_bound;
+            }
+
+            // In a second pass, recurse into each child.
+            for (int ii = 0; ii < num_children; ++ii)
+            {
+                int move = order[ii];
+
+                curr_co = child_co[move];
+                curr_eo = child_eo[move];
+                curr_ud_pos = child_ud_pos[move];
 
                 last_move = move;
+                p1_state = cube_p1_automaton.next(old_state, move);
                 solution.push_back(move);
 
                 phase1_search(depth - 1);
@@ -154,10 +293,242 @@ void CubeSolver::phase1_search(int depth)
                 solution.pop_back();
                 last_move = (solution.empty()) ? NUM_MOVES : solution.back();
             }
+            p1_state = old_state;
 
             curr_co = old_co;
             curr_eo = old_eo;
             curr_ud_pos = old_ud_pos;
+
+            // If no phase 1 solutions were found below this position, then
+            // remember so, unless the search was cut short.
+            if (!transpositions.empty() && !finished &&
+                num_phase1_leaves == old_leaves)
+            {
+                transpositions[transposition_slot(key)] = key;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  CubeSolver::transposition_key
+*
+* Purpose:   Works out the key of the current phase 1 position in the
+*            transposition table.
+*
+* Params:    depth - The number of phase 1 moves still to be made.
+*
+* Returns:   The key, which is never zero.
+*
+* Operation: Whether there is a phase 1 solution of exactly the remaining
+*            length depends only on the phase 1 coordinates, the remaining
+*            depth, and the moves allowed next, which are determined by the
+*            state of the phase 1 automaton. These are packed together, with
+*            the top bit set so that a key can never equal an empty slot.
+******************************************************************************/
+uint64_t CubeSolver::transposition_key(int depth)
+{
+    return (uint64_t)curr_co | ((uint64_t)curr_eo << 12) |
+           ((uint64_t)curr_ud_pos << 23) | ((uint64_t)depth << 32) |
+           ((uint64_t)p1_state << 40) | (1ULL << 63);
+}
+
+/******************************************************************************
+* Function:  CubeSolver::transposition_slot
+*
+* Purpose:   Works out where a key is stored in the transposition table.
+*
+* Params:    key - The key, as returned by transposition_key.
+*
+* Returns:   The index of the slot for the key.
+*
+* Operation: Multiplicative hashing. Each key has a single slot, and a new
+*            key simply overwrites whatever was there before.
+******************************************************************************/
+size_t CubeSolver::transposition_slot(uint64_t key)
+{
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> transposition_shift);
+}
+
+/******************************************************************************
+* Function:  CubeSolver::phase1_leaf
+*
+* Purpose:   Continues the search from a phase 1 solution.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Works out the phase 2 coordinates at the end of the stored moves
+*            by applying them to the starting coordinates, and then either
+*            hands the position to the pipeline or starts the phase 2 search
+*            from it.
+******************************************************************************/
+void CubeSolver::phase1_leaf()
+{
+    // Initialise the phase 2 starting coordinates and call into the phase
+    // 2 search from this position
+    int ud_sorted = start_ud_sorted;
+    int rl_sorted = start_rl_sorted;
+    int fb_sorted = start_fb_sorted;
+    int coord_cp  = start_cp;
+
+    for (int move : solution)
+    {
+        ud_sorted = cube_ud_sorted_trans(ud_sorted, move);
+        rl_sorted = cube_rl_sorted_trans(rl_sorted, move);
+        fb_sorted = cube_fb_sorted_trans(fb_sorted, move);
+        coord_cp  = cube_cp_trans(coord_cp, move);
+    }
+
+    curr_cp = coord_cp;
+    curr_ep = Cube::edge_permutation_calc(rl_sorted, fb_sorted);
+    curr_ud_perm = Cube::ud_permutation_calc(ud_sorted);
+
+    // In a pipelined search, hand the position over to the phase 2
+    // workers rather than searching it here.
+    if (pipeline != nullptr)
+    {
+        pipeline->push(*this);
+    }
+    else
+    {
+        phase2_start(ud_sorted, rl_sorted, fb_sorted);
+    }
+}
+
+/******************************************************************************
+* Function:  CubeSolver::prefetch_phase1
+*
+* Purpose:   Starts fetching the pruning data which a phase 1 position will
+*            look up.
+*
+* Params:    co, eo, ud_pos - The phase 1 coordinates of the position.
+*
+* Returns:   Nothing.
+*
+* Operation: If the fused child tables are loaded, the position will read its
+*            rows of those, and otherwise it will read its entries in the
+*            three phase 1 pruning tables.
+******************************************************************************/
+void CubeSolver::prefetch_phase1(int co, int eo, int ud_pos)
+{
+    if (use_fused_prune)
+    {
+        cube_co_eo_prune.prefetch_children(co, eo);
+        cube_co_ud_prune.prefetch_children(co, ud_pos);
+        cube_eo_ud_prune.prefetch_children(eo, ud_pos);
+    }
+    else
+    {
+        cube_co_eo_prune.prefetch(co, eo);
+        cube_co_ud_prune.prefetch(co, ud_pos);
+        cube_eo_ud_prune.prefetch(eo, ud_pos);
+    }
+}
+
+/******************************************************************************
+* Function:  CubeSolver::phase2_start
+*
+* Purpose:   Starts the phase 2 search from the end of a phase 1 solution.
+*
+* Params:    ud_sorted, - The auxiliary coordinates of the position, which
+*            rl_sorted,   are used to look it up in the near-solved table.
+*            fb_sorted
+*
+* Returns:   Nothing.
+*
+* Operation: The phase 2 coordinates and the moves so far must already be
+*            stored. Uses the near-solved and end-game tables, if they are
+*            loaded, to skip depths which cannot give a solution, and then
+*            runs the phase 2 search at increasing depths up to the bound
+*            set by the best solution so far.
+******************************************************************************/
+void CubeSolver::phase2_start(int ud_sorted, int rl_sorted, int fb_sorted)
+{
+    trace_event(CUBE_TRACE_PHASE2_START, solution.size());
+
+    // When enumerating, only finishes which make up the full length are
+    // wanted, and the near-solved table cannot list all of them.
+    if (enumerate_length > 0)
+    {
+        p2_state = cube_p2_automaton.start();
+        trace_event(CUBE_TRACE_PHASE2_DEPTH,
+                    enumerate_length - solution.size());
+        phase2_search(enumerate_length - solution.size());
+        return;
+    }
+
+    // If the near-solved table is loaded, then it either gives an optimal
+    // finish from here directly, or tells us that there is no finish within
+    // its depth, so that the phase 2 search can start deeper.
+    int min_depth2 = 0;
+    if (cube_near_table.depth() >= 0)
+    {
+        std::vector<int> finish;
+        if (cube_near_table.path_to_solved(cube_co_trans.solved_pos(),
+                                           cube_eo_trans.solved_pos(),
+                                           curr_cp, ud_sorted,
+                                           rl_sorted, fb_sorted, finish))
+        {
+            // Only use the finish if it does not turn the same face as the
+            // last phase 1 move, since otherwise a shorter solution is found
+            // elsewhere in the search.
+            if (finish.empty() ||
+                (cube_p1_allowed_moves[last_move] &
+                                           CUBE_MOVE_BIT(finish[0])) != 0)
+            {
+                if ((int)(finish.size() + solution.size()) <= max_length)
+                {
+                    int prefix_size = solution.size();
+                    solution.insert(solution.end(),
+                                    finish.begin(), finish.end());
+                    record_sol();
+                    solution.resize(prefix_size);
+                }
+                return;
+            }
+            min_depth2 = finish.size();
+        }
+        else
+        {
+            min_depth2 = cube_near_table.depth() + 1;
+        }
+    }
+
+    // Likewise, the end-game table gives the exact phase 2 distance of
+    // positions within its depth, and a lower bound for all others. It is
+    // only worth probing if the pruning tables allow the position to be
+    // within its depth.
+    if (cube_endgame_table.depth() >= 0)
+    {
+        int dist2 = std::max(cube_cp_ud_prune(curr_cp, curr_ud_perm),
+                             cube_ep_ud_prune(curr_ep, curr_ud_perm));
+        if (dist2 <= cube_endgame_table.depth())
+        {
+            dist2 = cube_endgame_table(curr_cp, curr_ep, curr_ud_perm);
+            if (dist2 == -1)
+            {
+                dist2 = cube_endgame_table.depth() + 1;
+            }
+        }
+        min_depth2 = std::max(min_depth2, dist2);
+    }
+
+    // In a pipelined search, another consumer may have improved the shared
+    // bound while this one searched, so it is picked up before each deeper
+    // pass.
+    p2_state = cube_p2_automaton.start();
+    for (int depth2 = min_depth2;
+         !finished && (int)(depth2 + solution.size()) <= max_length;
+         ++depth2)
+    {
+        trace_event(CUBE_TRACE_PHASE2_DEPTH, depth2);
+        phase2_search(depth2);
+        if (pipeline != nullptr)
+        {
+            max_length = std::min(max_length, pipeline->max_length());
+            finished = finished || pipeline->finished();
         }
     }
 }
@@ -178,11 +549,30 @@ void CubeSolver::phase1_search(int depth)
 void CubeSolver::phase2_search(int depth)
 {
     // Break out early if we're looking for a solution of the same length as
-    // one we've already found, or longer.
-    if ((int)(depth + solution.size()) >= max_length)
+    // one we've already found, or longer, or if a short enough solution has
+    // already been found.
+    if (finished || (int)(depth + solution.size()) > max_length)
     {
         return;
     }
+    ++num_phase2_nodes;
+
+    // Every so often, check whether the search has been cancelled, and in a
+    // pipelined search, whether another consumer has improved the bound so
+    // far that this branch is no longer worth finishing.
+    if ((num_phase2_nodes & (CUBE_CANCEL_INTERVAL - 1)) == 0)
+    {
+        if (pipeline != nullptr)
+        {
+            max_length = std::min(max_length, pipeline->max_length());
+            finished = finished || pipeline->finished();
+        }
+        if (poll_cancel() || finished ||
+            (int)(depth + solution.size()) > max_length)
+        {
+            return;
+        }
+    }
 
     // If the depth is zero, then check if we have a valid phase 2 solution.
     if (depth == 0 &&
@@ -190,30 +580,76 @@ void CubeSolver::phase2_search(int depth)
         curr_ep == cube_ep_trans.solved_pos() &&
         curr_ud_perm == cube_ud_perm_trans.solved_pos())
     {
-        // We've found a solution, so update the max_length, and execute the
-        // callback on the solution
-        max_length = solution.size() - 1;
-        print_sol();
+        // We've found a solution, so record it.
+        record_sol();
     }
 
     // If the depth is not zero, then check the pruning tables to see if we
     // should prune this branch or not, and then check all available moves.
     else if (depth > 0)
     {
-        if (cube_cp_ud_prune(curr_cp, curr_ud_perm) <= depth &&
-            cube_ep_ud_prune(curr_ep, curr_ud_perm) <= depth)
+        // Within the depth of the end-game table, positions which pass the
+        // pruning tables also have their exact distance looked up, and
+        // anything which cannot be finished in exactly the remaining depth is
+        // pruned, since shorter finishes were tried in earlier iterations.
+        // When enumerating, longer finishes than the shortest are wanted
+        // too, so the distance is only used as a bound.
+        bool expand = (cube_cp_ud_prune(curr_cp, curr_ud_perm) <= depth &&
+                       cube_ep_ud_prune(curr_ep, curr_ud_perm) <= depth);
+        if (expand && depth <= cube_endgame_table.depth())
+        {
+            int dist2 = cube_endgame_table(curr_cp, curr_ep, curr_ud_perm);
+            expand = (dist2 == depth ||
+                      (enumerate_length > 0 && dist2 >= 0 && dist2 < depth));
+        }
+
+        if (expand)
         {
             int old_cp = curr_cp;
             int old_ep = curr_ep;
             int old_ud_perm = curr_ud_perm;
 
-            for (int move : cube_p2_allowed_moves[last_move])
+            // In a first pass, work out the coordinates of each child, and
+            // start fetching the pruning table entries which it will look up.
+            int child_cp[NUM_MOVES];
+            int child_ep[NUM_MOVES];
+            int child_ud_perm[NUM_MOVES];
+            // As in phase 1, the automaton is not used when enumerating.
+            int old_state = p2_state;
+            uint32_t children = cube_p2_allowed_moves[last_move];
+            if (enumerate_length == 0)
             {
-                curr_cp = cube_cp_trans(old_cp, move);
-                curr_ep = cube_ep_trans(old_ep, move);
-                curr_ud_perm = cube_ud_perm_trans(old_ud_perm, move);
+                children &= cube_p2_automaton.moves(old_state);
+            }
+
+            for (uint32_t moves = children; moves != 0; )
+            {
+                int move = cube_next_move(moves);
+
+                child_cp[move] = cube_cp_trans(old_cp, move);
+                child_ep[move] = cube_ep_trans(old_ep, move);
+                child_ud_perm[move] = cube_ud_perm_trans(old_ud_perm, move);
+
+                if (use_prefetch && depth > 1)
+                {
+                    cube_cp_ud_prune.prefetch(child_cp[move],
+                                              child_ud_perm[move]);
+                    cube_ep_ud_prune.prefetch(child_ep[move],
+                                              child_ud_perm[move]);
+                }
+            }
+
+            // In a second pass, recurse into each child.
+            while (children != 0)
+            {
+                int move = cube_next_move(children);
+
+                curr_cp = child_cp[move];
+                curr_ep = child_ep[move];
+                curr_ud_perm = child_ud_perm[move];
 
                 last_move = move;
+                p2_state = cube_p2_automaton.next(old_state, move);
                 solution.push_back(move);
 
                 phase2_search(depth - 1);
@@ -221,6 +657,7 @@ void CubeSolver::phase2_search(int depth)
                 solution.pop_back();
                 last_move = (solution.empty()) ? NUM_MOVES : solution.back();
             }
+            p2_state = old_state;
 
             curr_cp = old_cp;
             curr_ep = old_ep;
@@ -229,6 +666,59 @@ void CubeSolver::phase2_search(int depth)
     }
 }
 
+/******************************************************************************
+* Function:  CubeSolver::record_sol
+*
+* Purpose:   Records the solution which is currently stored.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Updates the max_length and the best solution, executes the
+*            callback on the solution, and finishes the search if the solution
+*            is short enough for the caller's purposes. In a pipelined search
+*            the solution is passed on to the pipeline to do the same, and
+*            when enumerating, the callback is executed with nothing else.
+******************************************************************************/
+void CubeSolver::record_sol()
+{
+    // In a pipelined search, the pipeline keeps the best solution and the
+    // bound which is shared between all of its threads.
+    if (pipeline != nullptr)
+    {
+        pipeline->record_sol(solution);
+        max_length = pipeline->max_length();
+        finished = pipeline->finished();
+        return;
+    }
+
+    // When enumerating, every solution is passed on to the enumerator, and
+    // the bound is left alone so that the rest of the same length are found.
+    if (enumerate_length > 0)
+    {
+        process_sol(solution);
+        return;
+    }
+
+    max_length = solution.size() - 1;
+    best = solution;
+    trace_event(CUBE_TRACE_SOLUTION, solution.size());
+    if (process_sol)
+    {
+        process_sol(solution);
+    }
+    else
+    {
+        print_sol();
+    }
+
+    if ((int)solution.size() <= target_length)
+    {
+        finished = true;
+    }
+}
+
 /******************************************************************************
 * Function:  CubeSolver::print_sol
 *
@@ -311,29 +801,517 @@ void CubeSolver::print_sol()
     std::cout << std::endl << std::endl;
 }
 
+/******************************************************************************
+* Function:  CubeSolver::set_target_length
+*
+* Purpose:   Sets the length of solution which is good enough to stop at.
+*
+* Params:    length - As soon as a solution of at most this many moves is
+*                     found, the search finishes. The default of 0 means that
+*                     the search carries on until it can find no shorter
+*                     solutions.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply store the value.
+******************************************************************************/
+void CubeSolver::set_target_length(int length)
+{
+    target_length = length;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::set_prefetch
+*
+* Purpose:   Sets whether the search prefetches pruning data for children.
+*
+* Params:    enabled - True to issue prefetches for the pruning table entries
+*                      of each child before recursing into any of them.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply store the value.
+******************************************************************************/
+void CubeSolver::set_prefetch(bool enabled)
+{
+    use_prefetch = enabled;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::set_child_ordering
+*
+* Purpose:   Sets whether phase 1 visits children in order of their pruning
+*            values.
+*
+* Params:    enabled - True to visit the children of each phase 1 position
+*                      with the smallest pruning value first, false to visit
+*                      them in the fixed move order.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply store the value. Ordering the children does not change
+*            the positions visited by a complete search, only the order in
+*            which solutions are found.
+******************************************************************************/
+void CubeSolver::set_child_ordering(bool enabled)
+{
+    use_child_ordering = enabled;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::set_transposition_table
+*
+* Purpose:   Sets the size of the phase 1 transposition table.
+*
+* Params:    log2_entries - The base 2 logarithm of the number of entries in
+*                           the table, or 0 to switch the table off.
+*
+* Returns:   Nothing.
+*
+* Operation: Allocates an empty table of 8-byte entries. The table records
+*            phase 1 positions which were searched to some depth without
+*            finding any phase 1 solutions, so that the search can skip them
+*            when it meets them again, by another sequence of moves or in a
+*            later iteration. The entries hold no information about the cube
+*            being solved, so the table stays valid from one solve to the
+*            next.
+******************************************************************************/
+void CubeSolver::set_transposition_table(int log2_entries)
+{
+    if (log2_entries <= 0)
+    {
+        transpositions.clear();
+        return;
+    }
+
+    transpositions.assign((size_t)1 << log2_entries, 0);
+    transposition_shift = 64 - log2_entries;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::set_cancel
+*
+* Purpose:   Sets the token which cancels the search.
+*
+* Params:    token - A token whose cancel function will stop any search which
+*                    this solver is running or later runs.
+*
+* Returns:   Nothing.
+*
+* Operation: Shares the state of the token, which both searches check once
+*            every CUBE_CANCEL_INTERVAL nodes.
+******************************************************************************/
+void CubeSolver::set_cancel(const CubeCancel& token)
+{
+    cancel_flag = token.flag;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::set_trace
+*
+* Purpose:   Sets the log which the searches record their events in.
+*
+* Params:    event_trace - The log, or nullptr to record no events. It must
+*                          not be destroyed while the solver is using it,
+*                          and must not be shared with a solver on another
+*                          thread.
+*
+* Returns:   Nothing.
+*
+* Operation: Simply store the value. Each call to solve then records its
+*            start, when the tables are ready, the start of each phase 1
+*            depth, the start of each phase 2 search and of each of its
+*            depths, each solution, any cancellation, and its end.
+******************************************************************************/
+void CubeSolver::set_trace(CubeTrace* event_trace)
+{
+    trace = event_trace;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::trace_event
+*
+* Purpose:   Records an event in the log, if there is one.
+*
+* Params:    type  - One of the CUBE_TRACE constants.
+*            value - The value which goes with the event.
+*
+* Returns:   Nothing.
+*
+* Operation: Does nothing unless a log has been set, so that the cost of an
+*            untraced search is a single test at each event.
+******************************************************************************/
+void CubeSolver::trace_event(int type, int value)
+{
+    if (trace != nullptr)
+    {
+        trace->record(type, value);
+    }
+}
+
+/******************************************************************************
+* Function:  CubeSolver::poll_cancel
+*
+* Purpose:   Checks whether the search has been cancelled.
+*
+* Params:    None.
+*
+* Returns:   True if the search has been cancelled, and false otherwise.
+*
+* Operation: If the token has been cancelled, finishes the search, which
+*            then unwinds as it does once a short enough solution is found.
+*            The best solution so far is kept.
+******************************************************************************/
+bool CubeSolver::poll_cancel()
+{
+    if (!was_cancelled && cancel_flag &&
+        cancel_flag->load(std::memory_order_relaxed))
+    {
+        was_cancelled = true;
+        finished = true;
+        trace_event(CUBE_TRACE_CANCELLED, 0);
+    }
+    return was_cancelled;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::solve
+*
+* Purpose:   Finds solutions to the current cube state, printing each one.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Calls into the main solve function with no callback, so that
+*            print_sol is used on each solution instead.
+******************************************************************************/
+void CubeSolver::solve()
+{
+    solve(nullptr);
+}
+
 /******************************************************************************
 * Function:  CubeSolver::solve
 *
 * Purpose:   Finds solutions to the current cube state.
 *
-* Params:    process_sol - A callback which will be called on each solution as
-*                          it is discovered.
+* Params:    callback - A callback which will be called on each solution as
+*                       it is discovered.
 *
 * Returns:   Nothing.
 *
 * Operation: Uses the two-phase Kociemba algorithm with transition tables and
-*            pruning to find solutions.
+*            pruning to find solutions, filling any of the tables which are
+*            not yet filled. If the cube is already in the phase 2
+*            subgroup, then the phase 2 search is run from it directly in
+*            place of the phase 1 search at depth 0, and the deeper phase 1
+*            searches then look for shorter solutions which leave the
+*            subgroup.
 ******************************************************************************/
-void CubeSolver::solve()
+void CubeSolver::solve(std::function<void(std::vector<int>&)> callback)
+{
+    trace_event(CUBE_TRACE_SOLVE_START, 0);
+    cube_fill_phase1_tables();
+    cube_fill_phase2_tables();
+    trace_event(CUBE_TRACE_TABLES_READY, 0);
+
+    if (!start_search(callback))
+    {
+        int first_depth = 0;
+        if (in_phase2())
+        {
+            phase2_root();
+            first_depth = 1;
+        }
+
+        // Begin searching for solutions.
+        for (int depth = first_depth; depth <= max_length && !finished;
+             ++depth)
+        {
+            trace_event(CUBE_TRACE_PHASE1_DEPTH, depth);
+            phase1_search(depth);
+        }
+    }
+
+    trace_event(CUBE_TRACE_FINISH, best.empty() ? -1 : (int)best.size());
+}
+
+/******************************************************************************
+* Function:  CubeSolver::solve_phase2
+*
+* Purpose:   Finds the shortest solution to the current cube state which uses
+*            only phase 2 moves.
+*
+* Params:    callback - A callback which will be called on each solution as
+*                       it is discovered.
+*
+* Returns:   Nothing.
+*
+* Operation: The cube must already be in the phase 2 subgroup, which can be
+*            checked with in_phase2, and otherwise no solution is found. The
+*            phase 2 search is run at increasing depths from the cube itself,
+*            and stops at the first depth with a solution, or at the first
+*            solution within the target length. A solution from the
+*            near-solved table may be used instead if it is at least as
+*            short, even if it leaves the subgroup. Only the phase 2 tables
+*            are filled, if they are not already.
+******************************************************************************/
+void CubeSolver::solve_phase2(std::function<void(std::vector<int>&)> callback)
+{
+    trace_event(CUBE_TRACE_SOLVE_START, 0);
+    cube_fill_phase2_tables();
+    trace_event(CUBE_TRACE_TABLES_READY, 0);
+
+    if (!start_search(callback) && in_phase2())
+    {
+        phase2_root();
+        finished = true;
+    }
+
+    trace_event(CUBE_TRACE_FINISH, best.empty() ? -1 : (int)best.size());
+}
+
+/******************************************************************************
+* Function:  CubeSolver::solve_async
+*
+* Purpose:   Finds solutions to the current cube state on another thread.
+*
+* Params:    callback - A callback which will be called on each solution as
+*                       it is discovered, from the searching thread. Each
+*                       solution is shorter than the one before it.
+*
+* Returns:   A future holding the shortest solution found, which is ready
+*            once the search has finished or been cancelled.
+*
+* Operation: Runs solve on a new thread. The solver must not be used or
+*            destroyed until the future is ready. To abandon the search early,
+*            give the solver a token with set_cancel before calling this, and
+*            cancel the token; the future then holds the best solution found
+*            before the search stopped, which may be empty.
+******************************************************************************/
+std::future<std::vector<int>> CubeSolver::solve_async(
+    std::function<void(std::vector<int>&)> callback)
+{
+    return std::async(std::launch::async, [this, callback]()
+    {
+        solve(callback);
+        return best;
+    });
+}
+
+/******************************************************************************
+* Function:  CubeSolver::cancelled
+*
+* Purpose:   Getter for whether the last call to solve was cancelled.
+*
+* Params:    None.
+*
+* Returns:   True if the search was stopped by its cancellation token before
+*            it finished, and false otherwise.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+bool CubeSolver::cancelled()
+{
+    return was_cancelled;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::in_phase2
+*
+* Purpose:   Checks whether the current cube state is in the phase 2
+*            subgroup, so that it can be solved using phase 2 moves only.
+*
+* Params:    None.
+*
+* Returns:   True if the cube is in the phase 2 subgroup, false otherwise.
+*
+* Operation: The cube is in the subgroup exactly when all three phase 1
+*            coordinates are solved.
+******************************************************************************/
+bool CubeSolver::in_phase2()
+{
+    return curr_co == cube_co_trans.solved_pos() &&
+           curr_eo == cube_eo_trans.solved_pos() &&
+           curr_ud_pos == cube_ud_unsorted_trans.solved_pos();
+}
+
+/******************************************************************************
+* Function:  CubeSolver::phase2_root
+*
+* Purpose:   Runs the phase 2 search from the cube itself.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Works out the phase 2 coordinates directly from the starting
+*            auxiliary coordinates, as phase1_leaf does for an empty phase 1
+*            solution, and then starts the phase 2 search. Since the phase 2
+*            group is connected and every position in it is within 18 phase 2
+*            moves of solved, this always finds a solution.
+******************************************************************************/
+void CubeSolver::phase2_root()
+{
+    curr_cp = start_cp;
+    curr_ep = Cube::edge_permutation_calc(start_rl_sorted, start_fb_sorted);
+    curr_ud_perm = Cube::ud_permutation_calc(start_ud_sorted);
+
+    phase2_start(start_ud_sorted, start_rl_sorted, start_fb_sorted);
+}
+
+/******************************************************************************
+* Function:  CubeSolver::start_search
+*
+* Purpose:   Prepares for a search for solutions to the current cube state.
+*
+* Params:    callback - A callback which will be called on each solution as
+*                       it is discovered.
+*
+* Returns:   True if the cube has already been solved optimally, so that no
+*            search is needed, and false otherwise.
+*
+* Operation: Resets the state of the search, and reads off a solution from
+*            the near-solved table if the cube is close enough to solved.
+******************************************************************************/
+bool CubeSolver::start_search(std::function<void(std::vector<int>&)> callback)
 {
     // Reset private member variables to their starting values
     max_length = INT_MAX;
+    finished = false;
+    was_cancelled = false;
     solution = {};
+    best = {};
     last_move = NUM_MOVES;
+    p1_state = cube_p1_automaton.start();
+    process_sol = callback;
+    num_phase1_nodes = 0;
+    num_phase2_nodes = 0;
+    num_phase1_leaves = 0;
+    use_fused_prune = cube_co_eo_prune.has_children() &&
+                      cube_co_ud_prune.has_children() &&
+                      cube_eo_ud_prune.has_children();
 
-    // Begin searching for solutions.
-    for (int depth = 0; depth <= max_length; ++depth)
+    // If the position is close enough to solved to be in the near-solved
+    // table, then read off an optimal solution directly, unless all of the
+    // solutions of some length are wanted.
+    if (enumerate_length == 0 && cube_near_table.depth() >= 0 &&
+        cube_near_table.path_to_solved(curr_co, curr_eo, start_cp,
+                                       start_ud_sorted, start_rl_sorted,
+                                       start_fb_sorted, solution))
     {
-        phase1_search(depth);
+        record_sol();
+        finished = true;
+        return true;
     }
-}
\ No newline at end of file
+
+    return false;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::best_solution
+*
+* Purpose:   Getter for the shortest solution found by the last call to solve.
+*
+* Params:    None.
+*
+* Returns:   The moves of the shortest solution found.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+std::vector<int> CubeSolver::best_solution()
+{
+    return best;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::phase1_nodes
+*
+* Purpose:   Getter for the number of phase 1 nodes visited by the last call
+*            to solve.
+*
+* Params:    None.
+*
+* Returns:   The number of calls made to phase1_search, which is one for
+*            the root at each depth and one for each child of each position
+*            expanded, whether or not the pruning tables then cut it off.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubeSolver::phase1_nodes()
+{
+    return num_phase1_nodes;
+}
+
+/******************************************************************************
+* Function:  CubeSolver::phase2_nodes
+*
+* Purpose:   Getter for the number of phase 2 nodes visited by the last call
+*            to solve.
+*
+* Params:    None.
+*
+* Returns:   The number of calls made to phase2_search which were not cut off
+*            by the current best solution.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+uint64_t CubeSolver::phase2_nodes()
+{
+    return num_phase2_nodes;
+}
+
+/******************************************************************************
+* CubeCancel class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeCancel::CubeCancel
+*
+* Purpose:   Constructor for the CubeCancel class.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Creates the shared state of a token which has not been
+*            cancelled.
+******************************************************************************/
+CubeCancel::CubeCancel() : flag(std::make_shared<std::atomic<bool>>(false))
+{
+}
+
+/******************************************************************************
+* Function:  CubeCancel::cancel
+*
+* Purpose:   Cancels every search which has been given this token.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Sets the shared flag. Each search notices within
+*            CUBE_CANCEL_INTERVAL nodes of either phase, and a search which
+*            is started afterwards stops almost at once.
+******************************************************************************/
+void CubeCancel::cancel()
+{
+    flag->store(true, std::memory_order_relaxed);
+}
+
+/******************************************************************************
+* Function:  CubeCancel::cancelled
+*
+* Purpose:   Checks whether the token has been cancelled.
+*
+* Params:    None.
+*
+* Returns:   True if cancel has been called on the token or a copy of it.
+*
+* Operation: Simply read the shared flag.
+******************************************************************************/
+bool CubeCancel::cancelled() const
+{
+    return flag->load(std::memory_order_relaxed);
+}
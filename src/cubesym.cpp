@@ -0,0 +1,209 @@
+/******************************************************************************
+* File:    cubesym.cpp
+*
+* Purpose: Definitions of the 48 symmetries of the cube, together with the
+*          functions which use them to reduce a cube to a canonical
+*          representative of its class under symmetry and inversion, and to
+*          translate solutions of that representative back to the original.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <cube.h>
+#include <cubesym.h>
+
+/******************************************************************************
+* Symmetry table initial definitions
+******************************************************************************/
+std::vector<Cube> cube_sym_cubes;
+std::vector<int> cube_sym_inverse(NUM_SYMMETRIES);
+std::vector<std::vector<int>> cube_sym_move(NUM_SYMMETRIES,
+                                            std::vector<int>(NUM_MOVES));
+
+/******************************************************************************
+* Implementation of functions which fill and use the symmetry tables
+******************************************************************************/
+
+/******************************************************************************
+* Function:  cube_create_symmetries
+*
+* Purpose:   Fill in the symmetry tables.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Every symmetry of the cube is a product of powers of four basic
+*            symmetries - a 120 degree rotation about the URF-DBL diagonal, a
+*            180 degree rotation about the F-B axis, a 90 degree rotation
+*            about the U-D axis and a reflection in the plane which swaps L
+*            and R. Symmetry number 16a + 8b + 2c + d is the product
+*            URF3^a F2^b U4^c LR2^d. For each symmetry we then find its
+*            inverse and the face move that each move becomes under
+*            conjugation by it.
+******************************************************************************/
+void cube_create_symmetries()
+{
+    Cube rot_urf3({CORNER_URF, CORNER_DFR, CORNER_DLF, CORNER_UFL,
+                   CORNER_UBR, CORNER_DRB, CORNER_DBL, CORNER_ULB},
+                  {1, 2, 1, 2, 2, 1, 2, 1},
+                  {EDGE_FR, EDGE_DF, EDGE_FL, EDGE_UF, EDGE_BR, EDGE_DB,
+                   EDGE_BL, EDGE_UB, EDGE_UR, EDGE_DR, EDGE_DL, EDGE_UL},
+                  {0, 1, 0, 1, 0, 1, 0, 1, 1, 1, 1, 1});
+    Cube rot_f2({CORNER_DLF, CORNER_DFR, CORNER_DRB, CORNER_DBL,
+                 CORNER_UFL, CORNER_URF, CORNER_UBR, CORNER_ULB},
+                {0, 0, 0, 0, 0, 0, 0, 0},
+                {EDGE_DF, EDGE_DR, EDGE_DB, EDGE_DL, EDGE_UF, EDGE_UR,
+                 EDGE_UB, EDGE_UL, EDGE_FL, EDGE_FR, EDGE_BR, EDGE_BL},
+                {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+    Cube rot_u4({CORNER_UBR, CORNER_URF, CORNER_UFL, CORNER_ULB,
+                 CORNER_DRB, CORNER_DFR, CORNER_DLF, CORNER_DBL},
+                {0, 0, 0, 0, 0, 0, 0, 0},
+                {EDGE_UR, EDGE_UF, EDGE_UL, EDGE_UB, EDGE_DR, EDGE_DF,
+                 EDGE_DL, EDGE_DB, EDGE_BR, EDGE_FR, EDGE_FL, EDGE_BL},
+                {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1});
+    Cube mirr_lr2({CORNER_UFL, CORNER_URF, CORNER_UBR, CORNER_ULB,
+                   CORNER_DLF, CORNER_DFR, CORNER_DRB, CORNER_DBL},
+                  {3, 3, 3, 3, 3, 3, 3, 3},
+                  {EDGE_UF, EDGE_UR, EDGE_UB, EDGE_UL, EDGE_DF, EDGE_DR,
+                   EDGE_DB, EDGE_DL, EDGE_FL, EDGE_FR, EDGE_BR, EDGE_BL},
+                  {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+
+    // Build up each symmetry as a product of the basic symmetries.
+    cube_sym_cubes.clear();
+    for (int sym = 0; sym < NUM_SYMMETRIES; ++sym)
+    {
+        Cube cube;
+        for (int ii = 0; ii < sym / 16; ++ii)       cube = cube.multiply(rot_urf3);
+        for (int ii = 0; ii < (sym / 8) % 2; ++ii)  cube = cube.multiply(rot_f2);
+        for (int ii = 0; ii < (sym / 2) % 4; ++ii)  cube = cube.multiply(rot_u4);
+        for (int ii = 0; ii < sym % 2; ++ii)        cube = cube.multiply(mirr_lr2);
+        cube_sym_cubes.push_back(cube);
+    }
+
+    // Work out the inverse of each symmetry.
+    Cube solved_cube;
+    CubeKey solved_key = solved_cube.key();
+    for (int sym = 0; sym < NUM_SYMMETRIES; ++sym)
+    {
+        for (int inv = 0; inv < NUM_SYMMETRIES; ++inv)
+        {
+            if (cube_sym_cubes[sym].multiply(cube_sym_cubes[inv]).key()
+                                                               == solved_key)
+            {
+                cube_sym_inverse[sym] = inv;
+            }
+        }
+    }
+
+    // Work out which move each move is conjugated to by each symmetry. Every
+    // conjugate of a face turn is again a face turn, so failing to find one
+    // means the tables above are wrong.
+    std::vector<CubeKey> move_keys;
+    for (int move = 0; move < NUM_MOVES; ++move)
+    {
+        move_keys.push_back(solved_cube.perform_move(move).key());
+    }
+
+    for (int sym = 0; sym < NUM_SYMMETRIES; ++sym)
+    {
+        for (int move = 0; move < NUM_MOVES; ++move)
+        {
+            Cube conj = cube_sym_cubes[sym]
+                        .multiply(solved_cube.perform_move(move))
+                        .multiply(cube_sym_cubes[cube_sym_inverse[sym]]);
+            std::vector<CubeKey>::iterator found = std::find(
+                               move_keys.begin(), move_keys.end(), conj.key());
+            if (found == move_keys.end())
+            {
+                abort();
+            }
+            cube_sym_move[sym][move] = found - move_keys.begin();
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  cube_canonical
+*
+* Purpose:   Reduces a cube to a canonical representative of its class under
+*            the symmetries of the cube and inversion.
+*
+* Params:    cube      - The cube to reduce.
+*            canonical - Output parameter holding the canonical representative.
+*
+* Returns:   A transform index which can be passed to
+*            cube_uncanonical_solution in order to turn a solution to the
+*            canonical cube into a solution to the original cube.
+*
+* Operation: Computes S^-1 X S for each symmetry S, where X is either the
+*            cube or its inverse, and keeps the one with the smallest key. The
+*            transform index is 2 * S + (1 if X is the inverse, else 0).
+******************************************************************************/
+int cube_canonical(Cube cube, Cube& canonical)
+{
+    Cube candidates[2] = {cube, cube.inverse()};
+    int best_transform = -1;
+    CubeKey best_key;
+
+    for (int inv = 0; inv < 2; ++inv)
+    {
+        for (int sym = 0; sym < NUM_SYMMETRIES; ++sym)
+        {
+            Cube conj = cube_sym_cubes[cube_sym_inverse[sym]]
+                        .multiply(candidates[inv])
+                        .multiply(cube_sym_cubes[sym]);
+            CubeKey conj_key = conj.key();
+            if (best_transform == -1 || conj_key < best_key)
+            {
+                best_transform = 2 * sym + inv;
+                best_key = conj_key;
+                canonical = conj;
+            }
+        }
+    }
+
+    return best_transform;
+}
+
+/******************************************************************************
+* Function:  cube_uncanonical_solution
+*
+* Purpose:   Translates a solution to a canonical cube back into a solution to
+*            the cube which it was calculated from.
+*
+* Params:    solution  - A solution to the canonical cube.
+*            transform - The transform index returned by cube_canonical.
+*
+* Returns:   A solution to the original cube, of the same length.
+*
+* Operation: If N solves S^-1 X S then S N S^-1 solves X, and each move of
+*            S N S^-1 is the conjugate of the corresponding move of N. If X is
+*            the inverse of the original cube then the solution is inverted by
+*            reversing it and inverting each move.
+******************************************************************************/
+std::vector<int> cube_uncanonical_solution(std::vector<int> solution,
+                                           int transform)
+{
+    int sym = transform / 2;
+    for (size_t ii = 0; ii < solution.size(); ++ii)
+    {
+        solution[ii] = cube_sym_move[sym][solution[ii]];
+    }
+
+    if (transform % 2 == 1)
+    {
+        std::reverse(solution.begin(), solution.end());
+        for (size_t ii = 0; ii < solution.size(); ++ii)
+        {
+            solution[ii] = inverse_move(solution[ii]);
+        }
+    }
+
+    return solution;
+}
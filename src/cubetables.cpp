@@ -3,12 +3,27 @@
 *
 * Purpose: Builds transition and pruning tables for the two phases of the
 *          Kociemba algorithm for solving the cube.
+*
+*          Each table is filled at most once, however many times and from
+*          however many threads it is asked for, and asking for a table also
+*          fills the tables it is built from. Tables which do not depend on
+*          each other are filled on separate threads.
 ******************************************************************************/
 
 /******************************************************************************
 * Includes
 ******************************************************************************/
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <cube.h>
+#include <cubecoord.h>
+#include <cubeendgame.h>
+#include <cubememory.h>
+#include <cubenear.h>
 #include <cubephase.h>
 #include <cubeprune.h>
 #include <cubetrans.h>
@@ -17,29 +32,105 @@
 /******************************************************************************
 * Initial definitions of the transition tables
 ******************************************************************************/
-CubeTrans cube_co_trans(PHASE_1, &Cube::coord_corner_orientation, 2187);
-CubeTrans cube_eo_trans(PHASE_1, &Cube::coord_edge_orientation, 2048);
-CubeTrans cube_cp_trans(PHASE_1, &Cube::coord_corner_permutation, 40320);
-CubeTrans cube_ud_sorted_trans(PHASE_1, &Cube::coord_ud_sorted, 11880);
-CubeTrans cube_rl_sorted_trans(PHASE_1, &Cube::coord_rl_sorted, 11880);
-CubeTrans cube_fb_sorted_trans(PHASE_1, &Cube::coord_fb_sorted, 11880);
-CubeTrans cube_ep_trans(PHASE_2, &Cube::coord_edge_permutation, 40320);
-CubeTrans cube_ud_unsorted_trans(PHASE_1, &Cube::coord_ud_unsorted, 495);
-CubeTrans cube_ud_perm_trans(PHASE_2, &Cube::coord_ud_permutation, 24);
+CubeTrans<CubeCoordCO, PHASE_1> cube_co_trans;
+CubeTrans<CubeCoordEO, PHASE_1> cube_eo_trans;
+CubeTrans<CubeCoordCP, PHASE_1> cube_cp_trans;
+CubeTrans<CubeCoordUDSorted, PHASE_1> cube_ud_sorted_trans;
+CubeTrans<CubeCoordRLSorted, PHASE_1> cube_rl_sorted_trans;
+CubeTrans<CubeCoordFBSorted, PHASE_1> cube_fb_sorted_trans;
+CubeTrans<CubeCoordEP, PHASE_2> cube_ep_trans;
+CubeTrans<CubeCoordUDUnsorted, PHASE_1> cube_ud_unsorted_trans;
+CubeTrans<CubeCoordUDPerm, PHASE_2> cube_ud_perm_trans;
 
 /******************************************************************************
 * Initial definitions of the pruning tables
 ******************************************************************************/
-CubePrune cube_co_eo_prune(PHASE_1, &cube_co_trans, &cube_eo_trans);
-CubePrune cube_co_ud_prune(PHASE_1, &cube_co_trans, &cube_ud_unsorted_trans);
-CubePrune cube_eo_ud_prune(PHASE_1, &cube_eo_trans, &cube_ud_unsorted_trans);
-CubePrune cube_ep_ud_prune(PHASE_2, &cube_ep_trans, &cube_ud_perm_trans);
-CubePrune cube_cp_ud_prune(PHASE_2, &cube_cp_trans, &cube_ud_perm_trans);
+CubePrune<decltype(cube_co_trans), decltype(cube_eo_trans), PHASE_1>
+    cube_co_eo_prune(cube_co_trans, cube_eo_trans);
+CubePrune<decltype(cube_co_trans), decltype(cube_ud_unsorted_trans), PHASE_1>
+    cube_co_ud_prune(cube_co_trans, cube_ud_unsorted_trans);
+CubePrune<decltype(cube_eo_trans), decltype(cube_ud_unsorted_trans), PHASE_1>
+    cube_eo_ud_prune(cube_eo_trans, cube_ud_unsorted_trans);
+CubePrune<decltype(cube_ep_trans), decltype(cube_ud_perm_trans), PHASE_2>
+    cube_ep_ud_prune(cube_ep_trans, cube_ud_perm_trans);
+CubePrune<decltype(cube_cp_trans), decltype(cube_ud_perm_trans), PHASE_2>
+    cube_cp_ud_prune(cube_cp_trans, cube_ud_perm_trans);
+
+/******************************************************************************
+* Initial definition of the table of positions close to solved
+******************************************************************************/
+CubeNear cube_near_table;
+
+/******************************************************************************
+* Initial definition of the table of exact phase 2 distances close to solved
+******************************************************************************/
+CubeEndgame cube_endgame_table;
+
+/******************************************************************************
+* Definitions of the tiers of tables
+*
+* Each tier holds the optional tables to fill on top of the transition and
+* pair pruning tables, the total memory which all of the tables take once
+* filled, and the most memory taken at any moment while they are filled, as
+* measured on a 64-bit build. The near-solved and end-game tables are hash
+* tables whose size doubles as they fill, and the search which fills each of
+* them holds its frontier too, so for the largest tier the peak is about a
+* third more than the total. Tiers are chosen by their peak.
+******************************************************************************/
+struct CubeTier
+{
+    bool fused;
+    int near_depth;
+    int endgame_depth;
+    size_t bytes;
+    size_t peak_bytes;
+};
+
+static const CubeTier cube_tiers[NUM_CUBE_TIERS] =
+{
+    {false, -1, -1,  18u << 20,   60u << 20},
+    {true,   4,  7, 150u << 20,  200u << 20},
+    {true,   6,  9, 900u << 20, 1250u << 20}
+};
+
+/******************************************************************************
+* Flags recording which sets of tables have been filled
+******************************************************************************/
+static std::once_flag cube_phase1_filled;
+static std::once_flag cube_phase2_filled;
 
 /******************************************************************************
 * Implementation of functions which populate the tables with data.
 ******************************************************************************/
 
+/******************************************************************************
+* Function:  cube_fill_concurrently
+*
+* Purpose:   Runs a list of tasks which fill tables, all at the same time.
+*
+* Params:    tasks - The tasks to run.
+*
+* Returns:   Nothing.
+*
+* Operation: Runs the first task on this thread and each of the others on a
+*            thread of its own, and waits for them all to finish.
+******************************************************************************/
+static void cube_fill_concurrently(std::vector<std::function<void()>> tasks)
+{
+    std::vector<std::thread> threads;
+    for (size_t ii = 1; ii < tasks.size(); ++ii)
+    {
+        threads.emplace_back(tasks[ii]);
+    }
+
+    tasks[0]();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
 /******************************************************************************
 * Function:  cube_fill_all_trans_tables
 *
@@ -49,20 +140,20 @@ CubePrune cube_cp_ud_prune(PHASE_2, &cube_cp_trans, &cube_ud_perm_trans);
 *
 * Returns:   Nothing.
 *
-* Operation: Calls into each of the functions responsible for populating a
-*            particular transition table.
+* Operation: Fills each transition table which has not yet been filled, all
+*            at the same time.
 ******************************************************************************/
 void cube_fill_all_trans_tables()
 {
-    cube_co_trans.fill();
-    cube_eo_trans.fill();
-    cube_cp_trans.fill();
-    cube_ud_sorted_trans.fill();
-    cube_rl_sorted_trans.fill();
-    cube_fb_sorted_trans.fill();
-    cube_ep_trans.fill();
-    cube_ud_unsorted_trans.fill();
-    cube_ud_perm_trans.fill();
+    cube_fill_concurrently({[]() { cube_co_trans.fill_once(); },
+                            []() { cube_eo_trans.fill_once(); },
+                            []() { cube_cp_trans.fill_once(); },
+                            []() { cube_ud_sorted_trans.fill_once(); },
+                            []() { cube_rl_sorted_trans.fill_once(); },
+                            []() { cube_fb_sorted_trans.fill_once(); },
+                            []() { cube_ep_trans.fill_once(); },
+                            []() { cube_ud_unsorted_trans.fill_once(); },
+                            []() { cube_ud_perm_trans.fill_once(); }});
 }
 
 /******************************************************************************
@@ -74,14 +165,381 @@ void cube_fill_all_trans_tables()
 *
 * Returns:   Nothing.
 *
-* Operation: Calls into each of the functions responsible for populating a
-*            particular pruning table.
+* Operation: Fills each pruning table which has not yet been filled, all at
+*            the same time, along with the transition tables they need.
 ******************************************************************************/
 void cube_fill_all_pruning_tables()
 {
-    cube_co_eo_prune.fill();
-    cube_co_ud_prune.fill();
-    cube_eo_ud_prune.fill();
-    cube_ep_ud_prune.fill();
-    cube_cp_ud_prune.fill();
+    cube_fill_concurrently({[]() { cube_co_eo_prune.fill_once(); },
+                            []() { cube_co_ud_prune.fill_once(); },
+                            []() { cube_eo_ud_prune.fill_once(); },
+                            []() { cube_ep_ud_prune.fill_once(); },
+                            []() { cube_cp_ud_prune.fill_once(); }});
+}
+
+/******************************************************************************
+* Function:  cube_fill_phase1_tables
+*
+* Purpose:   Populate the tables needed by the phase 1 search.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Fills the phase 1 pruning tables and the transition tables they
+*            need, together with the transition tables used to work out the
+*            phase 2 coordinates at the end of a phase 1 solution. This is
+*            done only on the first call, so that the solver can call it
+*            before every search.
+******************************************************************************/
+void cube_fill_phase1_tables()
+{
+    std::call_once(cube_phase1_filled, []()
+    {
+        cube_fill_concurrently({[]() { cube_co_eo_prune.fill_once(); },
+                                []() { cube_co_ud_prune.fill_once(); },
+                                []() { cube_eo_ud_prune.fill_once(); },
+                                []() { cube_cp_trans.fill_once(); },
+                                []() { cube_ud_sorted_trans.fill_once(); },
+                                []() { cube_rl_sorted_trans.fill_once(); },
+                                []() { cube_fb_sorted_trans.fill_once(); }});
+    });
+}
+
+/******************************************************************************
+* Function:  cube_fill_phase2_tables
+*
+* Purpose:   Populate the tables needed by the phase 2 search.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Fills the phase 2 pruning tables and the transition tables they
+*            need, only on the first call, as for cube_fill_phase1_tables.
+******************************************************************************/
+void cube_fill_phase2_tables()
+{
+    std::call_once(cube_phase2_filled, []()
+    {
+        cube_fill_concurrently({[]() { cube_ep_ud_prune.fill_once(); },
+                                []() { cube_cp_ud_prune.fill_once(); }});
+    });
+}
+
+/******************************************************************************
+* Function:  cube_fill_fused_pruning_tables
+*
+* Purpose:   Populate the optional fused child tables for phase 1.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Calls into the function which fills the child table of each
+*            phase 1 pruning table, after filling the pruning table itself if
+*            needed. These take around 120MB in total. Until this is called,
+*            the solver uses the pruning tables directly.
+******************************************************************************/
+void cube_fill_fused_pruning_tables()
+{
+    cube_fill_concurrently({[]() { cube_co_eo_prune.fill_once();
+                                   cube_co_eo_prune.fill_children(); },
+                            []() { cube_co_ud_prune.fill_once();
+                                   cube_co_ud_prune.fill_children(); },
+                            []() { cube_eo_ud_prune.fill_once();
+                                   cube_eo_ud_prune.fill_children(); }});
+}
+
+/******************************************************************************
+* Function:  cube_fill_near_table
+*
+* Purpose:   Populate the optional table of positions close to solved.
+*
+* Params:    depth        - The maximum distance from solved of the positions
+*                           to store. Each extra move multiplies the size of
+*                           the table by roughly 13.
+*            budget_bytes - The most memory which the table may take while it
+*                           is filled, or SIZE_MAX for no limit.
+*
+* Returns:   The depth the table was filled to, which is the largest up to the
+*            given depth which fits in the budget, or -1 if none does.
+*
+* Operation: Fills the transition tables which the table is built from, and
+*            then calls into the fill function of the table. Until this is
+*            called, the solver does not consult the table.
+******************************************************************************/
+int cube_fill_near_table(int depth, size_t budget_bytes)
+{
+    cube_fill_concurrently({[]() { cube_co_trans.fill_once(); },
+                            []() { cube_eo_trans.fill_once(); },
+                            []() { cube_cp_trans.fill_once(); },
+                            []() { cube_ud_sorted_trans.fill_once(); },
+                            []() { cube_rl_sorted_trans.fill_once(); },
+                            []() { cube_fb_sorted_trans.fill_once(); }});
+
+    return cube_near_table.fill(depth, budget_bytes);
+}
+
+/******************************************************************************
+* Function:  cube_fill_endgame_table
+*
+* Purpose:   Populate the optional table of exact phase 2 distances.
+*
+* Params:    depth        - The maximum phase 2 distance from solved of the
+*                           positions to store. Each extra move multiplies
+*                           the size of the table by roughly 6.
+*            budget_bytes - The most memory which the table may take while it
+*                           is filled, or SIZE_MAX for no limit.
+*
+* Returns:   The depth the table was filled to, which is the largest up to the
+*            given depth which fits in the budget, or -1 if none does.
+*
+* Operation: Fills the phase 2 transition tables which the table is built
+*            from, and then calls into the fill function of the table. Until
+*            this is called, the solver does not consult the table.
+******************************************************************************/
+int cube_fill_endgame_table(int depth, size_t budget_bytes)
+{
+    cube_fill_concurrently({[]() { cube_cp_trans.fill_once(); },
+                            []() { cube_ep_trans.fill_once(); },
+                            []() { cube_ud_perm_trans.fill_once(); }});
+
+    return cube_endgame_table.fill(depth, budget_bytes);
+}
+
+/******************************************************************************
+* Function:  cube_tier_bytes
+*
+* Purpose:   Gives the memory needed by a tier of tables.
+*
+* Params:    tier - One of the CUBE_TIER constants.
+*
+* Returns:   The number of bytes taken by all of the tables once the tier has
+*            been filled.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+size_t cube_tier_bytes(int tier)
+{
+    return cube_tiers[tier].bytes;
+}
+
+/******************************************************************************
+* Function:  cube_tier_peak_bytes
+*
+* Purpose:   Gives the memory needed to fill a tier of tables.
+*
+* Params:    tier - One of the CUBE_TIER constants.
+*
+* Returns:   The most bytes taken by all of the tables at any moment while
+*            the tier is filled.
+*
+* Operation: Simply return the value.
+******************************************************************************/
+size_t cube_tier_peak_bytes(int tier)
+{
+    return cube_tiers[tier].peak_bytes;
+}
+
+/******************************************************************************
+* Function:  cube_near_bytes
+*
+* Purpose:   Gives the memory needed to fill the near-solved table.
+*
+* Params:    depth - The depth to fill the table to.
+*
+* Returns:   The peak number of bytes taken while the table is filled, or
+*            SIZE_MAX if it is not known.
+*
+* Operation: Asks the table.
+******************************************************************************/
+size_t cube_near_bytes(int depth)
+{
+    return CubeNear::fill_bytes(depth);
+}
+
+/******************************************************************************
+* Function:  cube_endgame_bytes
+*
+* Purpose:   Gives the memory needed to fill the end-game table.
+*
+* Params:    depth - The depth to fill the table to.
+*
+* Returns:   The peak number of bytes taken while the table is filled, or
+*            SIZE_MAX if it is not known.
+*
+* Operation: Asks the table.
+******************************************************************************/
+size_t cube_endgame_bytes(int depth)
+{
+    return CubeEndgame::fill_bytes(depth);
+}
+
+/******************************************************************************
+* Function:  cube_tier_for_budget
+*
+* Purpose:   Chooses the largest tier of tables which fits in a memory budget.
+*
+* Params:    budget_bytes - The number of bytes available for tables.
+*
+* Returns:   One of the CUBE_TIER constants.
+*
+* Operation: Goes through the tiers from the largest down, and chooses the
+*            first whose peak while it is filled fits. The minimal tier is
+*            chosen if none fit, since the solver cannot run without it.
+******************************************************************************/
+int cube_tier_for_budget(size_t budget_bytes)
+{
+    for (int tier = NUM_CUBE_TIERS - 1; tier > CUBE_TIER_MINIMAL; --tier)
+    {
+        if (cube_tiers[tier].peak_bytes <= budget_bytes)
+        {
+            return tier;
+        }
+    }
+
+    return CUBE_TIER_MINIMAL;
+}
+
+/******************************************************************************
+* Function:  cube_fill_tier
+*
+* Purpose:   Populates a tier of tables.
+*
+* Params:    tier - One of the CUBE_TIER constants.
+*
+* Returns:   Nothing.
+*
+* Operation: Fills the tables for both phases, and then the optional tables
+*            of the tier. The end-game table and then the near-solved table
+*            may each use whatever the tables already filled leave of the
+*            peak of the tier. The solver uses whichever tables are filled.
+******************************************************************************/
+void cube_fill_tier(int tier)
+{
+    const CubeTier& config = cube_tiers[tier];
+
+    cube_fill_phase1_tables();
+    cube_fill_phase2_tables();
+
+    if (config.fused)
+    {
+        cube_fill_fused_pruning_tables();
+    }
+    if (config.endgame_depth >= 0)
+    {
+        cube_fill_endgame_table(config.endgame_depth,
+                                cube_budget_left(config.peak_bytes,
+                                                 "endgame_table"));
+    }
+    if (config.near_depth >= 0)
+    {
+        cube_fill_near_table(config.near_depth,
+                             cube_budget_left(config.peak_bytes,
+                                              "near_table"));
+    }
+}
+
+/******************************************************************************
+* Function:  cube_fill_for_budget
+*
+* Purpose:   Populates the largest tier of tables which fits in a memory
+*            budget.
+*
+* Params:    budget_bytes - The number of bytes available for tables.
+*
+* Returns:   The tier which was filled.
+*
+* Operation: Calls cube_tier_for_budget and then cube_fill_tier.
+******************************************************************************/
+int cube_fill_for_budget(size_t budget_bytes)
+{
+    int tier = cube_tier_for_budget(budget_bytes);
+    cube_fill_tier(tier);
+    return tier;
+}
+
+/******************************************************************************
+* Function:  cube_usage
+*
+* Purpose:   Reports the memory used by one table.
+*
+* Params:    name  - The name to report the table under.
+*            table - The table.
+*
+* Returns:   The name of the table, the number of bytes which it takes, and
+*            the number of those bytes on each NUMA node.
+*
+* Operation: Asks the table for its size and for its placement.
+******************************************************************************/
+template <class Table>
+static CubeTableUsage cube_usage(const char* name, Table& table)
+{
+    CubeTableUsage usage;
+    usage.name = name;
+    usage.bytes = table.bytes();
+    table.placement(usage.node_bytes);
+    return usage;
+}
+
+/******************************************************************************
+* Function:  cube_table_usage
+*
+* Purpose:   Reports the memory used by each table.
+*
+* Params:    None.
+*
+* Returns:   The name of each table, the number of bytes which it takes, and
+*            the number of those bytes on each NUMA node. Tables which have
+*            not been filled take none.
+*
+* Operation: Asks each table for its size and placement in turn. The fused
+*            child table of a phase 1 pruning table is counted along with the
+*            table itself, and every copy of a replicated table is counted.
+******************************************************************************/
+std::vector<CubeTableUsage> cube_table_usage()
+{
+    return {cube_usage("co_trans", cube_co_trans),
+            cube_usage("eo_trans", cube_eo_trans),
+            cube_usage("cp_trans", cube_cp_trans),
+            cube_usage("ud_sorted_trans", cube_ud_sorted_trans),
+            cube_usage("rl_sorted_trans", cube_rl_sorted_trans),
+            cube_usage("fb_sorted_trans", cube_fb_sorted_trans),
+            cube_usage("ep_trans", cube_ep_trans),
+            cube_usage("ud_unsorted_trans", cube_ud_unsorted_trans),
+            cube_usage("ud_perm_trans", cube_ud_perm_trans),
+            cube_usage("co_eo_prune", cube_co_eo_prune),
+            cube_usage("co_ud_prune", cube_co_ud_prune),
+            cube_usage("eo_ud_prune", cube_eo_ud_prune),
+            cube_usage("ep_ud_prune", cube_ep_ud_prune),
+            cube_usage("cp_ud_prune", cube_cp_ud_prune),
+            cube_usage("near_table", cube_near_table),
+            cube_usage("endgame_table", cube_endgame_table)};
+}
+
+/******************************************************************************
+* Function:  cube_budget_left
+*
+* Purpose:   Works out how much of a memory budget is left for refilling one
+*            table.
+*
+* Params:    budget_bytes - The number of bytes available for tables.
+*            name         - The name of the table to be filled, as reported
+*                           by cube_table_usage.
+*
+* Returns:   The number of bytes of the budget which the other tables do not
+*            take, or 0 if they take it all.
+*
+* Operation: Adds up the memory used by every other table. The table itself
+*            is not counted, since filling it replaces what it holds.
+******************************************************************************/
+size_t cube_budget_left(size_t budget_bytes, const std::string& name)
+{
+    size_t used = 0;
+    for (CubeTableUsage& usage : cube_table_usage())
+    {
+        used += (usage.name == name) ? 0 : usage.bytes;
+    }
+    return (budget_bytes > used) ? budget_bytes - used : 0;
 }
@@ -0,0 +1,556 @@
+/******************************************************************************
+* File:    cubetext.cpp
+*
+* Purpose: Conversion between cubes and text, for reading scrambles and
+*          writing solutions.
+*
+*          A string of moves can be applied straight to the coordinates
+*          through the transition tables, so that no Cube is built. Facelet
+*          strings are checked with SSE2 where it is available: each colour
+*          is compared against the whole string at once, which gives a mask
+*          of the facelets of each colour, and the counts and twist are
+*          worked out from the masks with population counts.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <cube.h>
+#include <cubetables.h>
+#include <cubetext.h>
+
+/******************************************************************************
+* Constants
+*
+* Faces in the order in which they appear in a facelet string.
+******************************************************************************/
+enum {FACELET_U, FACELET_R, FACELET_F, FACELET_D, FACELET_L, FACELET_B,
+      NUM_FACES};
+
+#define FACELET_BITS ((1ULL << NUM_FACELETS) - 1)
+
+/******************************************************************************
+* Facelet definitions
+*
+* The facelets of each corner and edge position, starting with the facelet
+* on the U or D face, or for the middle layer edges on the F or B face, and
+* going clockwise around the corners. The colours of each corner and edge
+* piece, in the same order, are the faces of its home position. A piece in a
+* position has no twist or flip if its first colour is on the first facelet
+* of the position, and otherwise its twist is the number of the facelet
+* which has its first colour.
+******************************************************************************/
+static const int corner_facelets[8][3] =
+{
+    { 8,  9, 20}, { 6, 18, 38}, { 0, 36, 47}, { 2, 45, 11},
+    {29, 26, 15}, {27, 44, 24}, {33, 53, 42}, {35, 17, 51}
+};
+
+static const int corner_colours[8][3] =
+{
+    {FACELET_U, FACELET_R, FACELET_F}, {FACELET_U, FACELET_F, FACELET_L},
+    {FACELET_U, FACELET_L, FACELET_B}, {FACELET_U, FACELET_B, FACELET_R},
+    {FACELET_D, FACELET_F, FACELET_R}, {FACELET_D, FACELET_L, FACELET_F},
+    {FACELET_D, FACELET_B, FACELET_L}, {FACELET_D, FACELET_R, FACELET_B}
+};
+
+static const int edge_facelets[12][2] =
+{
+    { 7, 19}, { 3, 37}, { 1, 46}, { 5, 10},
+    {28, 25}, {30, 43}, {34, 52}, {32, 16},
+    {23, 12}, {21, 41}, {50, 39}, {48, 14}
+};
+
+static const int edge_colours[12][2] =
+{
+    {FACELET_U, FACELET_F}, {FACELET_U, FACELET_L},
+    {FACELET_U, FACELET_B}, {FACELET_U, FACELET_R},
+    {FACELET_D, FACELET_F}, {FACELET_D, FACELET_L},
+    {FACELET_D, FACELET_B}, {FACELET_D, FACELET_R},
+    {FACELET_F, FACELET_R}, {FACELET_F, FACELET_L},
+    {FACELET_B, FACELET_L}, {FACELET_B, FACELET_R}
+};
+
+/******************************************************************************
+* Lookup tables built from the facelet definitions
+*
+* For each of the three facelets of a corner position, a mask with a bit set
+* for that facelet of every corner position. Corner pieces are looked up by
+* the second and third of their colours, and edge pieces by both of their
+* colours, in the order in which they are seen on a position, giving the
+* piece and its flip, or -1 if there is no such piece.
+******************************************************************************/
+struct CubeFaceletTables
+{
+    uint64_t corner_masks[3];
+    int corner_piece[NUM_FACES * NUM_FACES];
+    int edge_piece[NUM_FACES * NUM_FACES];
+    int edge_flip[NUM_FACES * NUM_FACES];
+
+    CubeFaceletTables()
+    {
+        for (int ii = 0; ii < NUM_FACES * NUM_FACES; ++ii)
+        {
+            corner_piece[ii] = -1;
+            edge_piece[ii] = -1;
+            edge_flip[ii] = -1;
+        }
+
+        corner_masks[0] = corner_masks[1] = corner_masks[2] = 0;
+        for (int pos = 0; pos < 8; ++pos)
+        {
+            for (int ii = 0; ii < 3; ++ii)
+            {
+                corner_masks[ii] |= 1ULL << corner_facelets[pos][ii];
+            }
+            corner_piece[corner_colours[pos][1] * NUM_FACES +
+                         corner_colours[pos][2]] = pos;
+        }
+
+        for (int pos = 0; pos < 12; ++pos)
+        {
+            int colour_1 = edge_colours[pos][0];
+            int colour_2 = edge_colours[pos][1];
+            edge_piece[colour_1 * NUM_FACES + colour_2] = pos;
+            edge_flip[colour_1 * NUM_FACES + colour_2] = FLIP_NONE;
+            edge_piece[colour_2 * NUM_FACES + colour_1] = pos;
+            edge_flip[colour_2 * NUM_FACES + colour_1] = FLIP_FLIP;
+        }
+    }
+};
+
+static const CubeFaceletTables facelet_tables;
+
+/******************************************************************************
+* Move notation
+*
+* The letter of each face in the order of the MOVE constants, and the suffix
+* of each amount of turn.
+******************************************************************************/
+static const char move_faces[] = "ULFRBD";
+static const char* const move_suffixes[] = {"", "2", "'"};
+
+/******************************************************************************
+* Function:  cube_parity
+*
+* Purpose:   Works out the parity of a permutation.
+*
+* Params:    perm  - The permutation, in an array of at least 16 entries.
+*            count - The number of entries in the permutation, at most 16.
+*
+* Returns:   0 if the permutation is even, and 1 if it is odd.
+*
+* Operation: Counts the pairs of entries which are out of order. With SSE2,
+*            each entry is compared against the whole permutation at once,
+*            and the entries after it which are smaller are counted from the
+*            resulting mask.
+******************************************************************************/
+static int cube_parity(const uint8_t* perm, int count)
+{
+    int inversions = 0;
+
+#ifdef __SSE2__
+    __m128i entries = _mm_loadu_si128((const __m128i*)perm);
+    for (int ii = 0; ii < count; ++ii)
+    {
+        __m128i smaller = _mm_cmpgt_epi8(_mm_set1_epi8(perm[ii]), entries);
+        int after = ((1 << count) - 1) & ~((2 << ii) - 1);
+        inversions += __builtin_popcount(_mm_movemask_epi8(smaller) & after);
+    }
+#else
+    for (int ii = 0; ii < count; ++ii)
+    {
+        for (int jj = ii + 1; jj < count; ++jj)
+        {
+            inversions += (perm[ii] > perm[jj]);
+        }
+    }
+#endif
+
+    return inversions % 2;
+}
+
+/******************************************************************************
+* Function:  cube_read_moves
+*
+* Purpose:   Reads a string of moves, passing each on as it is read.
+*
+* Params:    text   - The start of the string.
+*            length - The number of characters in the string.
+*            apply  - Function called on each move in turn.
+*
+* Returns:   True if the string is a valid string of moves, and false
+*            otherwise.
+*
+* Operation: Each move is the letter of a face, U, L, F, R, B or D, followed
+*            by nothing for a quarter turn clockwise, 2 or 2' for a half
+*            turn, and ' or 3 for a quarter turn anticlockwise. Spaces and
+*            tabs between moves are skipped, and are not needed.
+******************************************************************************/
+template <class Apply>
+static bool cube_read_moves(const char* text, size_t length, Apply apply)
+{
+    const char* end = text + length;
+    while (text < end)
+    {
+        int face;
+        switch (*text++)
+        {
+            case ' ':
+            case '\t':
+                continue;
+            case 'U': face = 0; break;
+            case 'L': face = 1; break;
+            case 'F': face = 2; break;
+            case 'R': face = 3; break;
+            case 'B': face = 4; break;
+            case 'D': face = 5; break;
+            default:
+                return false;
+        }
+
+        int amount = 0;
+        if (text < end && *text == '2')
+        {
+            amount = 1;
+            ++text;
+            if (text < end && *text == '\'')
+            {
+                ++text;
+            }
+        }
+        else if (text < end && (*text == '\'' || *text == '3'))
+        {
+            amount = 2;
+            ++text;
+        }
+
+        apply(face * 3 + amount);
+    }
+
+    return true;
+}
+
+/******************************************************************************
+* Function:  cube_parse_moves
+*
+* Purpose:   Reads a string of moves.
+*
+* Params:    text   - The start of the string.
+*            length - The number of characters in the string.
+*            moves  - Output array, which the moves are appended to.
+*
+* Returns:   True if the string is a valid string of moves, and false
+*            otherwise.
+*
+* Operation: Reads the moves as described for cube_read_moves.
+******************************************************************************/
+bool cube_parse_moves(const char* text, size_t length,
+                      std::vector<int>& moves)
+{
+    return cube_read_moves(text, length,
+                           [&moves](int move) { moves.push_back(move); });
+}
+
+/******************************************************************************
+* Function:  cube_parse_coords
+*
+* Purpose:   Reads a string of moves and applies it to a solved cube.
+*
+* Params:    text   - The start of the string.
+*            length - The number of characters in the string.
+*            coords - Output parameter holding the coordinates of the cube
+*                     which results from applying the moves.
+*
+* Returns:   True if the string is a valid string of moves, and false
+*            otherwise.
+*
+* Operation: Starts from the coordinates of the solved cube and applies each
+*            move as it is read with one lookup in the transition table of
+*            each coordinate, so that no Cube is built and nothing is
+*            allocated. The phase 1 tables are filled first if they have not
+*            been already.
+******************************************************************************/
+bool cube_parse_coords(const char* text, size_t length, CubeCoords& coords)
+{
+    cube_fill_phase1_tables();
+
+    coords.co = cube_co_trans.solved_pos();
+    coords.eo = cube_eo_trans.solved_pos();
+    coords.cp = cube_cp_trans.solved_pos();
+    coords.ud_sorted = cube_ud_sorted_trans.solved_pos();
+    coords.rl_sorted = cube_rl_sorted_trans.solved_pos();
+    coords.fb_sorted = cube_fb_sorted_trans.solved_pos();
+
+    return cube_read_moves(text, length, [&coords](int move)
+    {
+        coords.co = cube_co_trans(coords.co, move);
+        coords.eo = cube_eo_trans(coords.eo, move);
+        coords.cp = cube_cp_trans(coords.cp, move);
+        coords.ud_sorted = cube_ud_sorted_trans(coords.ud_sorted, move);
+        coords.rl_sorted = cube_rl_sorted_trans(coords.rl_sorted, move);
+        coords.fb_sorted = cube_fb_sorted_trans(coords.fb_sorted, move);
+    });
+}
+
+/******************************************************************************
+* Function:  cube_is_facelets
+*
+* Purpose:   Determines whether a scramble is a facelet string rather than a
+*            string of moves.
+*
+* Params:    text   - The start of the string.
+*            length - The number of characters in the string.
+*
+* Returns:   True if the string has the form of a facelet string.
+*
+* Operation: A facelet string is exactly NUM_FACELETS characters, none of
+*            which is a space or can be a suffix of a move. A string of 54
+*            quarter turns written without spaces has the same form, and is
+*            taken to be facelets.
+******************************************************************************/
+bool cube_is_facelets(const char* text, size_t length)
+{
+    if (length != NUM_FACELETS)
+    {
+        return false;
+    }
+
+    for (size_t ii = 0; ii < length; ++ii)
+    {
+        char letter = text[ii];
+        if (letter == ' ' || letter == '\t' || letter == '\'' ||
+            letter == '2' || letter == '3')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/******************************************************************************
+* Function:  cube_classify_facelets
+*
+* Purpose:   Works out the face of each facelet of a facelet string, and
+*            makes the checks which need only the colours.
+*
+* Params:    text      - The facelet string, of NUM_FACELETS characters.
+*            faces     - Output array of 64 entries, holding the face of each
+*                        facelet.
+*            face_bits - Output array holding, for each face, a mask with a
+*                        bit set for each facelet of its colour.
+*
+* Returns:   True if each centre is a different colour, each colour appears
+*            on exactly nine facelets, each corner position has one facelet
+*            of the U or D colour, and the twists add up to a multiple of 3.
+*
+* Operation: With SSE2, the string is held in four registers, and the colour
+*            of each centre is compared against all of them at once, giving
+*            the mask of facelets of that colour and, ANDed with the number
+*            of the face, its contribution to the array of faces. The masks
+*            of the faces must each have nine bits set and must not overlap,
+*            which rules out two centres of the same colour. The twist of a
+*            corner is the number of its facelet which has the U or D colour,
+*            so the sum of the twists is the number of such facelets in the
+*            second corner mask plus twice the number in the third.
+******************************************************************************/
+static bool cube_classify_facelets(const char* text, uint8_t* faces,
+                                   uint64_t* face_bits)
+{
+    uint64_t all_bits = 0;
+
+#ifdef __SSE2__
+    uint8_t padded[64] = {0};
+    memcpy(padded, text, NUM_FACELETS);
+
+    __m128i chunks[4], chunk_faces[4];
+    for (int ii = 0; ii < 4; ++ii)
+    {
+        chunks[ii] = _mm_loadu_si128((const __m128i*)&padded[16 * ii]);
+        chunk_faces[ii] = _mm_setzero_si128();
+    }
+
+    for (int face = 0; face < NUM_FACES; ++face)
+    {
+        __m128i colour = _mm_set1_epi8(text[face * 9 + 4]);
+        __m128i number = _mm_set1_epi8(face);
+        uint64_t bits = 0;
+        for (int ii = 0; ii < 4; ++ii)
+        {
+            __m128i match = _mm_cmpeq_epi8(chunks[ii], colour);
+            bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(match) << (16 * ii);
+            chunk_faces[ii] = _mm_or_si128(chunk_faces[ii],
+                                           _mm_and_si128(match, number));
+        }
+
+        bits &= FACELET_BITS;
+        if (__builtin_popcountll(bits) != 9 || (all_bits & bits) != 0)
+        {
+            return false;
+        }
+        all_bits |= bits;
+        face_bits[face] = bits;
+    }
+
+    for (int ii = 0; ii < 4; ++ii)
+    {
+        _mm_storeu_si128((__m128i*)&faces[16 * ii], chunk_faces[ii]);
+    }
+#else
+    for (int face = 0; face < NUM_FACES; ++face)
+    {
+        char colour = text[face * 9 + 4];
+        uint64_t bits = 0;
+        for (int ii = 0; ii < NUM_FACELETS; ++ii)
+        {
+            if (text[ii] == colour)
+            {
+                bits |= 1ULL << ii;
+                faces[ii] = face;
+            }
+        }
+
+        if (__builtin_popcountll(bits) != 9 || (all_bits & bits) != 0)
+        {
+            return false;
+        }
+        all_bits |= bits;
+        face_bits[face] = bits;
+    }
+#endif
+
+    uint64_t ud_bits = face_bits[FACELET_U] | face_bits[FACELET_D];
+    uint64_t corner_bits = facelet_tables.corner_masks[0] |
+                           facelet_tables.corner_masks[1] |
+                           facelet_tables.corner_masks[2];
+    int twist = __builtin_popcountll(ud_bits &
+                                     facelet_tables.corner_masks[1]) +
+            2 * __builtin_popcountll(ud_bits &
+                                     facelet_tables.corner_masks[2]);
+
+    return __builtin_popcountll(ud_bits & corner_bits) == 8 &&
+           twist % 3 == 0;
+}
+
+/******************************************************************************
+* Function:  cube_parse_facelets
+*
+* Purpose:   Reads a facelet string.
+*
+* Params:    text   - The start of the string.
+*            length - The number of characters in the string.
+*            cube   - Output parameter holding the cube described.
+*
+* Returns:   True if the string describes a cube which can be solved, and
+*            false otherwise.
+*
+* Operation: The colours are checked by cube_classify_facelets. Each corner
+*            and edge position is then matched to a piece by looking up its
+*            colours, which also gives its twist or flip. The string is
+*            rejected unless every piece appears exactly once, the flips add
+*            up to a multiple of 2, and the corner and edge permutations have
+*            the same parity.
+******************************************************************************/
+bool cube_parse_facelets(const char* text, size_t length, Cube& cube)
+{
+    uint8_t faces[64];
+    uint64_t face_bits[NUM_FACES];
+    if (length != NUM_FACELETS ||
+        !cube_classify_facelets(text, faces, face_bits))
+    {
+        return false;
+    }
+
+    // Match each corner position to a piece. The facelet of the U or D
+    // colour gives the twist, and the other two colours give the piece.
+    uint64_t ud_bits = face_bits[FACELET_U] | face_bits[FACELET_D];
+    uint8_t corner_perm[16] = {0};
+    std::vector<int> corner_orient(8);
+    int corners_seen = 0;
+    for (int pos = 0; pos < 8; ++pos)
+    {
+        const int* facelets = corner_facelets[pos];
+        int ori = (int)((ud_bits >> facelets[1]) & 1) +
+                  2 * (int)((ud_bits >> facelets[2]) & 1);
+        int piece = facelet_tables.corner_piece[
+                        faces[facelets[(ori + 1) % 3]] * NUM_FACES +
+                        faces[facelets[(ori + 2) % 3]]];
+        if (piece < 0 || corner_colours[piece][0] != faces[facelets[ori]])
+        {
+            return false;
+        }
+
+        corner_perm[pos] = piece;
+        corner_orient[pos] = ori;
+        corners_seen |= 1 << piece;
+    }
+
+    // Match each edge position to a piece.
+    uint8_t edge_perm[16] = {0};
+    std::vector<int> edge_orient(12);
+    int edges_seen = 0;
+    int flip = 0;
+    for (int pos = 0; pos < 12; ++pos)
+    {
+        int colours = faces[edge_facelets[pos][0]] * NUM_FACES +
+                      faces[edge_facelets[pos][1]];
+        int piece = facelet_tables.edge_piece[colours];
+        if (piece < 0)
+        {
+            return false;
+        }
+
+        edge_perm[pos] = piece;
+        edge_orient[pos] = facelet_tables.edge_flip[colours];
+        edges_seen |= 1 << piece;
+        flip += edge_orient[pos];
+    }
+
+    // Check that every piece appears once and that the cube can be solved.
+    if (corners_seen != 0xFF || edges_seen != 0xFFF || flip % 2 != 0 ||
+        cube_parity(corner_perm, 8) != cube_parity(edge_perm, 12))
+    {
+        return false;
+    }
+
+    cube = Cube(std::vector<int>(corner_perm, corner_perm + 8), corner_orient,
+                std::vector<int>(edge_perm, edge_perm + 12), edge_orient);
+    return true;
+}
+
+/******************************************************************************
+* Function:  cube_format_moves
+*
+* Purpose:   Writes a string of moves.
+*
+* Params:    moves - The moves to write.
+*            text  - The string which the moves are appended to.
+*
+* Returns:   Nothing.
+*
+* Operation: Writes each move in the notation read by cube_parse_moves,
+*            separated by single spaces.
+******************************************************************************/
+void cube_format_moves(const std::vector<int>& moves, std::string& text)
+{
+    for (size_t ii = 0; ii < moves.size(); ++ii)
+    {
+        if (ii > 0)
+        {
+            text += ' ';
+        }
+        text += move_faces[moves[ii] / 3];
+        text += move_suffixes[moves[ii] % 3];
+    }
+}
@@ -0,0 +1,262 @@
+/******************************************************************************
+* File:    cubetrace.cpp
+*
+* Purpose: Implementation of the CubeTrace class.
+*
+*          Events are timestamped with the time stamp counter, which is
+*          converted to real time only when the trace is written out, by
+*          comparing the counter and the monotonic clock at that point with
+*          their values when the trace was created.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <cubetrace.h>
+
+/******************************************************************************
+* Function:  trace_write_event
+*
+* Purpose:   Writes one event in the Chrome trace event format.
+*
+* Params:    file      - The file to write to.
+*            first     - True for the first event in the file, in which case
+*                        it is set to false.
+*            name      - The name of the event.
+*            start     - The time of the event, in microseconds.
+*            duration  - The length of the event in microseconds, or a
+*                        negative value for an instant event.
+*            thread_id - The thread to show the event against.
+*            arg_name  - The name of the value of the event, or nullptr if
+*                        it has none.
+*            value     - The value of the event.
+*
+* Returns:   Nothing.
+*
+* Operation: Writes a complete event if it has a length, and otherwise an
+*            instant event scoped to the thread.
+******************************************************************************/
+static void trace_write_event(FILE* file, bool& first, const char* name,
+                              double start, double duration, int thread_id,
+                              const char* arg_name, int value)
+{
+    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"solver\",\"pid\":1,"
+                  "\"tid\":%d,\"ts\":%.3f",
+            first ? "" : ",", name, thread_id, start);
+    if (duration >= 0.0)
+    {
+        fprintf(file, ",\"ph\":\"X\",\"dur\":%.3f", duration);
+    }
+    else
+    {
+        fprintf(file, ",\"ph\":\"i\",\"s\":\"t\"");
+    }
+    if (arg_name != nullptr)
+    {
+        fprintf(file, ",\"args\":{\"%s\":%d}", arg_name, value);
+    }
+    fprintf(file, "}");
+    first = false;
+}
+
+/******************************************************************************
+* CubeTrace class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeTrace::CubeTrace
+*
+* Purpose:   Constructor for the CubeTrace class.
+*
+* Params:    log2_events - The base 2 logarithm of the number of events which
+*                          the buffer holds.
+*
+* Returns:   Nothing.
+*
+* Operation: Allocates the buffer, and notes the starting values of the time
+*            stamp counter and of the monotonic clock.
+******************************************************************************/
+CubeTrace::CubeTrace(int log2_events)
+    : events((size_t)1 << log2_events), mask(((size_t)1 << log2_events) - 1),
+      count(0)
+{
+    start_ticks = ticks();
+    start_time = std::chrono::steady_clock::now();
+}
+
+/******************************************************************************
+* Function:  CubeTrace::clear
+*
+* Purpose:   Discards all of the recorded events.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Resets the count, keeping the buffer.
+******************************************************************************/
+void CubeTrace::clear()
+{
+    count = 0;
+}
+
+/******************************************************************************
+* Function:  CubeTrace::size
+*
+* Purpose:   Getter for the number of events held.
+*
+* Params:    None.
+*
+* Returns:   The number of events recorded, up to the size of the buffer.
+*
+* Operation: Simply return the smaller of the two.
+******************************************************************************/
+size_t CubeTrace::size()
+{
+    return (count < events.size()) ? (size_t)count : events.size();
+}
+
+/******************************************************************************
+* Function:  CubeTrace::dropped
+*
+* Purpose:   Getter for the number of events which have been overwritten.
+*
+* Params:    None.
+*
+* Returns:   The number of events recorded beyond the size of the buffer.
+*
+* Operation: Simply subtract the number held from the count.
+******************************************************************************/
+uint64_t CubeTrace::dropped()
+{
+    return count - size();
+}
+
+/******************************************************************************
+* Function:  CubeTrace::write_json
+*
+* Purpose:   Writes the events held out in the Chrome trace event format.
+*
+* Params:    path      - The file to write to.
+*            thread_id - The thread to show the events against, so that the
+*                        traces of several solvers can be told apart.
+*
+* Returns:   True if the file was written, and false otherwise.
+*
+* Operation: Works out the length of a tick from the time elapsed since the
+*            trace was created, and then goes through the events from the
+*            oldest. Each solve, the filling of the tables before it, and
+*            each phase 1 depth are written as complete events lasting until
+*            the event which ends them, and the other events as instants. A
+*            solve or depth which has not ended is taken to last until the
+*            newest event. Events which have been overwritten are lost, so
+*            a solve whose start is missing is shown by an instant at its
+*            end.
+******************************************************************************/
+bool CubeTrace::write_json(const char* path, int thread_id)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    uint64_t end_ticks = ticks();
+    double elapsed_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start_time).count();
+    double us_per_tick = (end_ticks > start_ticks) ?
+                         elapsed_us / (end_ticks - start_ticks) : 0.0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+    double solve_start = -1.0;
+    double depth_start = -1.0;
+    int depth = 0;
+    double now = 0.0;
+
+    for (uint64_t ii = count - size(); ii < count; ++ii)
+    {
+        const Event& event = events[ii & mask];
+        now = (double)(int64_t)(event.ticks - start_ticks) * us_per_tick;
+
+        // Close any phase 1 depth which this event ends.
+        if (depth_start >= 0.0 &&
+            (event.type == CUBE_TRACE_PHASE1_DEPTH ||
+             event.type == CUBE_TRACE_SOLVE_START ||
+             event.type == CUBE_TRACE_FINISH))
+        {
+            trace_write_event(file, first, "phase 1 depth", depth_start,
+                              now - depth_start, thread_id, "depth", depth);
+            depth_start = -1.0;
+        }
+
+        switch (event.type)
+        {
+            case CUBE_TRACE_SOLVE_START:
+                solve_start = now;
+                break;
+            case CUBE_TRACE_TABLES_READY:
+                if (solve_start >= 0.0)
+                {
+                    trace_write_event(file, first, "fill tables", solve_start,
+                                      now - solve_start, thread_id,
+                                      nullptr, 0);
+                }
+                break;
+            case CUBE_TRACE_PHASE1_DEPTH:
+                depth_start = now;
+                depth = event.value;
+                break;
+            case CUBE_TRACE_PHASE2_START:
+                trace_write_event(file, first, "phase 2", now, -1.0,
+                                  thread_id, "phase1_length", event.value);
+                break;
+            case CUBE_TRACE_PHASE2_DEPTH:
+                trace_write_event(file, first, "phase 2 depth", now, -1.0,
+                                  thread_id, "depth", event.value);
+                break;
+            case CUBE_TRACE_SOLUTION:
+                trace_write_event(file, first, "solution", now, -1.0,
+                                  thread_id, "length", event.value);
+                break;
+            case CUBE_TRACE_CANCELLED:
+                trace_write_event(file, first, "cancelled", now, -1.0,
+                                  thread_id, nullptr, 0);
+                break;
+            case CUBE_TRACE_FINISH:
+                if (solve_start >= 0.0)
+                {
+                    trace_write_event(file, first, "solve", solve_start,
+                                      now - solve_start, thread_id,
+                                      "length", event.value);
+                }
+                else
+                {
+                    trace_write_event(file, first, "finish", now, -1.0,
+                                      thread_id, "length", event.value);
+                }
+                solve_start = -1.0;
+                break;
+        }
+    }
+
+    // Close anything still open at the newest event.
+    if (depth_start >= 0.0)
+    {
+        trace_write_event(file, first, "phase 1 depth", depth_start,
+                          now - depth_start, thread_id, "depth", depth);
+    }
+    if (solve_start >= 0.0)
+    {
+        trace_write_event(file, first, "solve", solve_start,
+                          now - solve_start, thread_id, nullptr, 0);
+    }
+
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
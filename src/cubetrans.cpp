@@ -1,97 +1,135 @@
 /******************************************************************************
 * File:    cubetrans.cpp
 *
-* Purpose: Implementation of the CubeTrans class, which represents a single
-*          transition table for a Rubik's cube coordinate.
+* Purpose: Implementation of the CubeTrans class template, which represents a
+*          single transition table for a Rubik's cube coordinate.
 ******************************************************************************/
 
 /******************************************************************************
 * Dependencies
 ******************************************************************************/
-#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
 #include <stack>
 #include <vector>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include <cube.h>
+#include <cubecoord.h>
 #include <cubephase.h>
 #include <cubetrans.h>
 
 /******************************************************************************
-* Cubetrans class implementation
+* CubeTrans class template implementation
 ******************************************************************************/
 
 /******************************************************************************
 * Function:  CubeTrans::CubeTrans
 *
-* Purpose:   Constructor for the CubeTrans class.
+* Purpose:   Constructor for the CubeTrans class template.
 *
-* Params:    phase_desc - Whether this pruning table is relevant in phase 1
-*                         or phase 2 of the two-phase algorithm.
-*            func       - Pointer to Cube member function which calculates the
-*                         value of some coordinate.
-*            range      - The number of values taken by the above coordinate.
+* Params:    None.
 *
 * Returns:   Nothing.
 *
-* Operation: Stores the function pointer as a member variable and allocates
-*            space for the transition table entries. Also stores the moves
-*            allowed for the given phase.
+* Operation: Works out the coordinate value of the solved cube. No space is
+*            allocated for the table entries until it is filled.
 ******************************************************************************/
-CubeTrans::CubeTrans(int phase_desc, std::function<int(Cube&)> func, int range)
+template <class Coord, int Phase>
+CubeTrans<Coord, Phase>::CubeTrans()
 {
-    phase = phase_desc;
-    coord_func = func;
-    table = std::vector<std::vector<int>>(range,
-                                          std::vector<int>(NUM_MOVES, -1));
+    Cube solved_cube;
+    _solved_pos = Coord::value(solved_cube);
 }
 
 /******************************************************************************
-* Function:  CubeTrans::solved_pos
+* Function:  CubeTrans::bytes
 *
-* Purpose:   Getter for the private _solved_pos member variable
+* Purpose:   Calculates the memory used by the table.
 *
 * Params:    None.
 *
-* Returns:   The value of the _solved_pos member.
+* Returns:   The number of bytes allocated for the table, all of which have
+*            been written once it is filled, counting every copy if it has
+*            been replicated across NUMA nodes.
 *
-* Operation: Simply return the value.
+* Operation: Simply return the size of the entries.
 ******************************************************************************/
-int CubeTrans::solved_pos()
+template <class Coord, int Phase>
+size_t CubeTrans<Coord, Phase>::bytes()
 {
-    return _solved_pos;
+    return table.bytes();
 }
 
 /******************************************************************************
-* Function:  CubeTrans::size
+* Function:  CubeTrans::placement
 *
-* Purpose:   Calculates the size of the transition table.
+* Purpose:   Reports which NUMA nodes hold the table.
 *
-* Params:    None.
+* Params:    node_bytes - Array of the number of bytes on each node, which
+*                         the bytes of this table are added to.
 *
-* Returns:   The number of values taken by the coordinate this table describes.
+* Returns:   Nothing.
 *
-* Operation: Simply return the value.
+* Operation: Passes the request on to the entries.
 ******************************************************************************/
-int CubeTrans::size()
+template <class Coord, int Phase>
+void CubeTrans<Coord, Phase>::placement(std::vector<size_t>& node_bytes)
 {
-    return table.size();
+    table.placement(node_bytes);
 }
 
 /******************************************************************************
-* Function:  CubeTrans::operator()
+* Function:  CubeTrans::gather
 *
-* Purpose:   Returns an entry in the transition table.
+* Purpose:   Looks up a batch of entries in the transition table.
 *
-* Params:    position - The coordinate value of the 'from' position
-*            move     - The move to be performed.
+* Params:    positions - The coordinate value of each 'from' position.
+*            moves     - The move to be performed on each position.
+*            count     - The number of positions.
+*            results   - Output array holding the coordinate value of each
+*                        resulting position.
 *
-* Returns:   The coordinate value of the resulting position.
+* Returns:   Nothing.
 *
-* Operation: Simply return the value from the private table.
+* Operation: When built with AVX2, the entries are looked up eight at a time
+*            with a single gather instruction, which reads four bytes from
+*            the start of each entry and masks off any which belong to the
+*            next one. Any entries left over, or all of them without AVX2,
+*            are looked up one at a time.
 ******************************************************************************/
-int CubeTrans::operator()(int position, int move)
+template <class Coord, int Phase>
+void CubeTrans<Coord, Phase>::gather(const int* positions, const int* moves,
+                                     int count, int* results)
 {
-    return table[position][move];
+    int ii = 0;
+
+#ifdef __AVX2__
+    __m256i stride = _mm256_set1_epi32(NUM_MOVES);
+    __m256i entry_mask = _mm256_set1_epi32(
+                             (uint32_t)((1ULL << (8 * sizeof(Entry))) - 1));
+    for ( ; ii + 8 <= count; ii += 8)
+    {
+        __m256i position = _mm256_loadu_si256((const __m256i*)&positions[ii]);
+        __m256i move = _mm256_loadu_si256((const __m256i*)&moves[ii]);
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(position, stride),
+                                         move);
+        __m256i result = _mm256_i32gather_epi32((const int*)table.data(),
+                                                index, sizeof(Entry));
+        result = _mm256_and_si256(result, entry_mask);
+        _mm256_storeu_si256((__m256i*)&results[ii], result);
+    }
+#endif
+
+    for ( ; ii < count; ++ii)
+    {
+        results[ii] = table[positions[ii] * NUM_MOVES + moves[ii]];
+    }
 }
 
 /******************************************************************************
@@ -105,9 +143,12 @@ int CubeTrans::operator()(int position, int move)
 *
 * Operation: Starting from the solved position, uses a depth-first search of
 *            cube positions, visiting each value of the coordinate exactly once
-*            and determining the result of each move on it.
+*            and determining the result of each move on it. The entries are
+*            held in one array, with the results of all the moves from a
+*            position next to each other.
 ******************************************************************************/
-void CubeTrans::fill()
+template <class Coord, int Phase>
+void CubeTrans<Coord, Phase>::fill()
 {
     // Local variables
     Cube curr_cube, next_cube;
@@ -117,39 +158,30 @@ void CubeTrans::fill()
     // an auxiliary array which will keep track of which coordinate values we
     // have already pushed onto the stack, to avoid duplication.
     std::stack<Cube> dfs;
-    std::vector<bool> seen(table.size(), false);
+    std::vector<bool> seen(Coord::range, false);
+    table.assign((size_t)Coord::range * NUM_MOVES + padding,
+                 std::numeric_limits<Entry>::max());
 
-    // Push the solved position onto the stack and record the coordinate value
-    // of the solved cube.
+    // Push the solved position onto the stack.
     Cube solved_cube;
-    _solved_pos = coord_func(solved_cube);
     seen[_solved_pos] = true;
     dfs.push(solved_cube);
 
-    // Work out the available moves
-    if (phase == PHASE_1)
-    {
-        allowed_moves = cube_p1_allowed_moves[NUM_MOVES];
-    }
-    else if (phase == PHASE_2)
-    {
-        allowed_moves = cube_p2_allowed_moves[NUM_MOVES];
-    }
-
     // Perform the depth-first search
     while (!dfs.empty())
     {
         // Get the top cube from the stack, and record the result of each move
         // on the coordinate value.
         curr_cube = dfs.top();
-        curr_coord = coord_func(curr_cube);
+        curr_coord = Coord::value(curr_cube);
         dfs.pop();
 
-        for (int move : allowed_moves)
+        for (uint32_t moves = allowed_moves; moves != 0; )
         {
+            int move = cube_next_move(moves);
             next_cube = curr_cube.perform_move(move);
-            next_coord = coord_func(next_cube);
-            table[curr_coord][move] = next_coord;
+            next_coord = Coord::value(next_cube);
+            table[curr_coord * NUM_MOVES + move] = next_coord;
 
             // Push the resulting cube onto the stack if necessary.
             if (!seen[next_coord])
@@ -160,3 +192,37 @@ void CubeTrans::fill()
         }
     }
 }
+
+/******************************************************************************
+* Function:  CubeTrans::fill_once
+*
+* Purpose:   Fills in the entries of this transition table if they have not
+*            already been filled.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Uses std::call_once, so that the table is filled exactly once
+*            even if several threads ask for it at the same time, and every
+*            caller returns only once it is complete. Once filled, the table
+*            is copied onto each NUMA node if the tables are replicated.
+******************************************************************************/
+template <class Coord, int Phase>
+void CubeTrans<Coord, Phase>::fill_once()
+{
+    std::call_once(filled, [this]() { fill(); table.replicate(); });
+}
+
+/******************************************************************************
+* Explicit instantiations for the tables declared in cubetables.h
+******************************************************************************/
+template class CubeTrans<CubeCoordCO, PHASE_1>;
+template class CubeTrans<CubeCoordEO, PHASE_1>;
+template class CubeTrans<CubeCoordCP, PHASE_1>;
+template class CubeTrans<CubeCoordUDSorted, PHASE_1>;
+template class CubeTrans<CubeCoordRLSorted, PHASE_1>;
+template class CubeTrans<CubeCoordFBSorted, PHASE_1>;
+template class CubeTrans<CubeCoordEP, PHASE_2>;
+template class CubeTrans<CubeCoordUDUnsorted, PHASE_1>;
+template class CubeTrans<CubeCoordUDPerm, PHASE_2>;
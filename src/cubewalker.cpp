@@ -0,0 +1,324 @@
+/******************************************************************************
+* File:    cubewalker.cpp
+*
+* Purpose: Implementation of the CubeWalker class. The walker holds the
+*          stack of a phase 1 search, which is iterative deepening as in
+*          CubeSolver, and a CubeSolver which searches phase 2 from each
+*          phase 1 solution straight away. The caller asks for the next
+*          position to expand, works out its children, and pushes those
+*          which survive the pruning, so that CubeBatch can do the lookups
+*          for several walkers together and CubeSolutions can stop after
+*          any position and carry on later.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <cube.h>
+#include <cubephase.h>
+#include <cubesolver.h>
+#include <cubetables.h>
+#include <cubewalker.h>
+
+/******************************************************************************
+* CubeWalker class implementation
+******************************************************************************/
+
+/******************************************************************************
+* Function:  CubeWalker::CubeWalker
+*
+* Purpose:   Constructor for the CubeWalker class.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Leaves the walker without a search, until start is called.
+******************************************************************************/
+CubeWalker::CubeWalker()
+{
+    solver = nullptr;
+    limit = 0;
+    level = -1;
+    node_level = 0;
+}
+
+/******************************************************************************
+* Function:  CubeWalker::start
+*
+* Purpose:   Prepares the search of a cube.
+*
+* Params:    search   - The solver for the cube, which must outlive the
+*                       search, and which searches phase 2 and keeps the
+*                       best solution and the node counts.
+*            callback - A callback which will be called on each solution as
+*                       it is discovered.
+*
+* Returns:   False if the near-solved table has already solved the cube, so
+*            that there is nothing to search, and true otherwise.
+*
+* Operation: Resets the solver. As in CubeSolver::solve, a cube in the phase
+*            2 subgroup is first searched in phase 2 directly, and otherwise
+*            the phase 1 search at depth 0 is done here. The stack is left
+*            empty, so that next_node will begin the search at depth 1. The
+*            tables must already be filled.
+******************************************************************************/
+bool CubeWalker::start(CubeSolver& search,
+                       std::function<void(std::vector<int>&)> callback)
+{
+    solver = &search;
+    limit = 0;
+    level = -1;
+    node_level = 0;
+
+    if (solver->start_search(callback))
+    {
+        return false;
+    }
+
+    if (solver->in_phase2())
+    {
+        solver->phase2_root();
+    }
+    else
+    {
+        ++solver->num_phase1_nodes;
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function:  CubeWalker::visit_leaf
+*
+* Purpose:   Passes a phase 1 solution on to phase 2.
+*
+* Params:    index - The index of the last move of the solution in the top
+*                    frame of the stack.
+*
+* Returns:   Nothing.
+*
+* Operation: Reads the moves of the solution off the stack into the solver,
+*            which then searches phase 2 from the end of them. As in
+*            CubeSolver, solutions whose last move is a phase 2 move are
+*            skipped, since they are found at a shorter depth.
+******************************************************************************/
+void CubeWalker::visit_leaf(int index)
+{
+    int last_move = frame_move[level][index];
+    if ((cube_p2_allowed_moves[NUM_MOVES] & CUBE_MOVE_BIT(last_move)) != 0)
+    {
+        return;
+    }
+
+    solver->solution.resize(level + 1);
+    for (int ii = 0; ii < level; ++ii)
+    {
+        solver->solution[ii] = frame_move[ii][frame_next[ii] - 1];
+    }
+    solver->solution[level] = last_move;
+    solver->last_move = last_move;
+
+    solver->phase1_leaf();
+}
+
+/******************************************************************************
+* Function:  CubeWalker::next_node
+*
+* Purpose:   Chooses the next position to expand.
+*
+* Params:    co, eo, ud_pos - Output parameters holding the phase 1
+*                             coordinates of the position.
+*            state          - Output parameter holding the state of the
+*                             phase 1 automaton at the position.
+*
+* Returns:   True if there is a position to expand, and false if the search
+*            is over.
+*
+* Operation: Takes the next unvisited child from the top frame of the stack.
+*            Children at the full depth are phase 1 solutions, and are
+*            visited here rather than expanded. When the top frame has no
+*            children left, it is popped, and when the stack is empty, the
+*            search at the current depth is over, so the root is expanded
+*            again at the next depth. The search is over once the depth
+*            passes the bound set by the best solution, or a short enough
+*            solution has been found, or the search has been cancelled.
+******************************************************************************/
+bool CubeWalker::next_node(int& co, int& eo, int& ud_pos, int& state)
+{
+    while (!solver->finished)
+    {
+        if (level < 0)
+        {
+            if (++limit > solver->max_length ||
+                limit > CUBE_WALKER_MAX_DEPTH)
+            {
+                return false;
+            }
+
+            co = solver->curr_co;
+            eo = solver->curr_eo;
+            ud_pos = solver->curr_ud_pos;
+            state = cube_p1_automaton.start();
+            node_level = 0;
+            return true;
+        }
+        else if (frame_next[level] < frame_count[level])
+        {
+            int index = frame_next[level]++;
+            if (limit == level + 1)
+            {
+                visit_leaf(index);
+                continue;
+            }
+
+            co = frame_co[level][index];
+            eo = frame_eo[level][index];
+            ud_pos = frame_ud_pos[level][index];
+            state = frame_state[level][index];
+            node_level = level + 1;
+            return true;
+        }
+        else
+        {
+            --level;
+        }
+    }
+
+    return false;
+}
+
+/******************************************************************************
+* Function:  CubeWalker::child_depth
+*
+* Purpose:   Gives the depth left for the children of the position being
+*            expanded.
+*
+* Params:    None.
+*
+* Returns:   The number of moves within which a child must be able to reach
+*            a phase 1 solution to be pushed.
+*
+* Operation: Takes the level of the position from the current depth.
+******************************************************************************/
+int CubeWalker::child_depth()
+{
+    return limit - node_level - 1;
+}
+
+/******************************************************************************
+* Function:  CubeWalker::count_children
+*
+* Purpose:   Counts the children of the position being expanded.
+*
+* Params:    moves - The moves allowed from the position, one bit per move.
+*
+* Returns:   Nothing.
+*
+* Operation: Counts the nodes as CubeSolver does, once for each child,
+*            whether or not it is then pruned, and once for the root at each
+*            depth. Whenever the count passes a multiple of
+*            CUBE_CANCEL_INTERVAL, checks whether the search has been
+*            cancelled, after which next_node reports that it is over.
+******************************************************************************/
+void CubeWalker::count_children(uint32_t moves)
+{
+    uint64_t old_nodes = solver->num_phase1_nodes;
+    solver->num_phase1_nodes += __builtin_popcount(moves) +
+                                (node_level == 0 ? 1 : 0);
+    if (((old_nodes ^ solver->num_phase1_nodes) &
+         ~(uint64_t)(CUBE_CANCEL_INTERVAL - 1)) != 0)
+    {
+        solver->poll_cancel();
+    }
+}
+
+/******************************************************************************
+* Function:  CubeWalker::begin_frame
+*
+* Purpose:   Pushes an empty frame for the children of the position being
+*            expanded.
+*
+* Params:    None.
+*
+* Returns:   Nothing.
+*
+* Operation: Any frames above the level of the position are finished with,
+*            so the new frame replaces them.
+******************************************************************************/
+void CubeWalker::begin_frame()
+{
+    level = node_level;
+    frame_count[level] = 0;
+    frame_next[level] = 0;
+}
+
+/******************************************************************************
+* Function:  CubeWalker::push_child
+*
+* Purpose:   Adds a child to the top frame of the stack.
+*
+* Params:    co, eo, ud_pos - The phase 1 coordinates of the child.
+*            move           - The move which reaches the child.
+*            state          - The state of the phase 1 automaton at the
+*                             child.
+*
+* Returns:   Nothing.
+*
+* Operation: Stores the child after those already in the frame, so that the
+*            children are visited in the order they are pushed.
+******************************************************************************/
+void CubeWalker::push_child(int co, int eo, int ud_pos, int move, int state)
+{
+    int index = frame_count[level]++;
+    frame_co[level][index] = co;
+    frame_eo[level][index] = eo;
+    frame_ud_pos[level][index] = ud_pos;
+    frame_move[level][index] = move;
+    frame_state[level][index] = state;
+}
+
+/******************************************************************************
+* Function:  CubeWalker::expand
+*
+* Purpose:   Expands the position chosen by next_node on its own.
+*
+* Params:    co, eo, ud_pos - The phase 1 coordinates of the position.
+*            state          - The state of the phase 1 automaton at the
+*                             position.
+*
+* Returns:   Nothing.
+*
+* Operation: Counts the children allowed by the automaton, works out their
+*            coordinates, and pushes those whose pruning values show that
+*            they can still reach a phase 1 solution within the depth left.
+******************************************************************************/
+void CubeWalker::expand(int co, int eo, int ud_pos, int state)
+{
+    uint32_t allowed = cube_p1_automaton.moves(state);
+    count_children(allowed);
+    begin_frame();
+
+    int depth = child_depth();
+    for (uint32_t moves = allowed; moves != 0; )
+    {
+        int move = cube_next_move(moves);
+        int child_co = cube_co_trans(co, move);
+        int child_eo = cube_eo_trans(eo, move);
+        int child_ud_pos = cube_ud_unsorted_trans(ud_pos, move);
+
+        if (std::max({cube_co_eo_prune(child_co, child_eo),
+                      cube_co_ud_prune(child_co, child_ud_pos),
+                      cube_eo_ud_prune(child_eo, child_ud_pos)}) > depth)
+        {
+            continue;
+        }
+
+        push_child(child_co, child_eo, child_ud_pos, move,
+                   cube_p1_automaton.next(state, move));
+    }
+}
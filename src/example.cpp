@@ -10,8 +10,6 @@
 int main()
 {
     // Common initialisation that must be done at startup.
-    std::cout << "Initialising..." << std::endl;
-    cube_create_allowed_moves();
     std::cout << "Generating transition tables..." << std::endl;
     cube_fill_all_trans_tables();
     std::cout << "Generating pruning tables..." << std::endl;
@@ -0,0 +1,484 @@
+/******************************************************************************
+* File:    stream.cpp
+*
+* Purpose: Solves a file of scrambles, one per line, as fast as possible.
+*
+*          The input file is memory mapped and each line is parsed where it
+*          lies, as a string of moves or as a facelet string. The lines are
+*          cut into chunks, which a pool of threads takes in turn and solves,
+*          writing the solutions of each chunk into a buffer of its own. The
+*          buffers are written out with large writes, in the order of the
+*          input, or with --unordered as soon as each chunk is finished, with
+*          each solution preceded by the number of its line.
+*
+*          Each output line holds the solution as a string of moves, or
+*          "invalid" if the scramble could not be read or cannot be solved.
+*
+*          Usage: stream [--threads N] [--target L] [--budget MB]
+*                        [--unordered] [--output FILE] INPUT
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cube.h>
+#include <cubesolver.h>
+#include <cubetables.h>
+#include <cubetext.h>
+
+/******************************************************************************
+* Constants
+*
+* The number of lines in a chunk, the number of chunks for each thread which
+* may be solved ahead of the oldest chunk not yet written in ordered mode,
+* and the amount of output buffered before it is written.
+******************************************************************************/
+#define STREAM_CHUNK_LINES   64
+#define STREAM_WINDOW        4
+#define STREAM_WRITE_BYTES   (1 << 20)
+
+/******************************************************************************
+* A chunk of lines of the input
+******************************************************************************/
+struct StreamChunk
+{
+    size_t begin;
+    size_t end;
+    size_t first_line;
+};
+
+/******************************************************************************
+* State shared between the threads
+******************************************************************************/
+struct StreamState
+{
+    const char* input;
+    std::vector<StreamChunk> chunks;
+    int target;
+    bool unordered;
+    int output_fd;
+
+    std::atomic<size_t> next_chunk;
+    std::mutex lock;
+    std::condition_variable chunk_written;
+    size_t window;
+    size_t num_written;
+    std::vector<std::string> finished;
+    std::vector<bool> is_finished;
+    std::string buffer;
+    bool write_failed;
+};
+
+/******************************************************************************
+* Function:  stream_write
+*
+* Purpose:   Writes out the buffered output.
+*
+* Params:    state - The shared state, whose lock must be held.
+*
+* Returns:   Nothing.
+*
+* Operation: Writes the whole buffer, retrying after partial writes, and
+*            empties it. A failure is recorded, and the rest of the output
+*            is discarded.
+******************************************************************************/
+static void stream_write(StreamState& state)
+{
+    size_t done = 0;
+    while (done < state.buffer.size() && !state.write_failed)
+    {
+        ssize_t written = write(state.output_fd, state.buffer.data() + done,
+                                state.buffer.size() - done);
+        if (written < 0)
+        {
+            state.write_failed = true;
+        }
+        else
+        {
+            done += written;
+        }
+    }
+    state.buffer.clear();
+}
+
+/******************************************************************************
+* Function:  stream_solve_line
+*
+* Purpose:   Solves the scramble on one line of the input.
+*
+* Params:    text   - The start of the line.
+*            length - The number of characters in the line.
+*            target - The target length passed to the solver.
+*            output - The string which the solution is appended to.
+*
+* Returns:   Nothing.
+*
+* Operation: Strips white space from the ends of the line, reads it as a
+*            facelet string if it has that form and as a string of moves
+*            otherwise, and solves the cube from its coordinates. A string of
+*            moves is applied straight to the coordinates, without building
+*            a Cube. Blank lines give blank output.
+******************************************************************************/
+static void stream_solve_line(const char* text, size_t length, int target,
+                              std::string& output)
+{
+    while (length > 0 && (text[length - 1] == '\r' ||
+                          text[length - 1] == ' ' ||
+                          text[length - 1] == '\t'))
+    {
+        --length;
+    }
+    while (length > 0 && (*text == ' ' || *text == '\t'))
+    {
+        ++text;
+        --length;
+    }
+    if (length == 0)
+    {
+        return;
+    }
+
+    CubeCoords coords;
+    if (cube_is_facelets(text, length))
+    {
+        Cube cube;
+        if (!cube_parse_facelets(text, length, cube))
+        {
+            output += "invalid";
+            return;
+        }
+        coords = cube.coords();
+    }
+    else if (!cube_parse_coords(text, length, coords))
+    {
+        output += "invalid";
+        return;
+    }
+
+    CubeSolver solver(coords);
+    solver.set_target_length(target);
+    solver.solve([](std::vector<int>&) {});
+    cube_format_moves(solver.best_solution(), output);
+}
+
+/******************************************************************************
+* Function:  stream_finish_chunk
+*
+* Purpose:   Passes on the output of a chunk which has been solved.
+*
+* Params:    state  - The shared state.
+*            index  - The index of the chunk.
+*            output - The output of the chunk.
+*
+* Returns:   Nothing.
+*
+* Operation: In unordered mode, the output is simply added to the buffer.
+*            Otherwise it is held until every chunk before it has been
+*            added, and then it and any chunks after it which are already
+*            finished are added in turn. The buffer is written out once it
+*            is large enough.
+******************************************************************************/
+static void stream_finish_chunk(StreamState& state, size_t index,
+                                std::string& output)
+{
+    std::lock_guard<std::mutex> guard(state.lock);
+
+    if (state.unordered)
+    {
+        state.buffer += output;
+    }
+    else
+    {
+        size_t slot = index % state.window;
+        state.finished[slot].swap(output);
+        state.is_finished[slot] = true;
+
+        while (state.is_finished[state.num_written % state.window])
+        {
+            slot = state.num_written % state.window;
+            state.buffer += state.finished[slot];
+            state.finished[slot].clear();
+            state.is_finished[slot] = false;
+            ++state.num_written;
+        }
+        state.chunk_written.notify_all();
+    }
+
+    if (state.buffer.size() >= STREAM_WRITE_BYTES)
+    {
+        stream_write(state);
+    }
+}
+
+/******************************************************************************
+* Function:  stream_worker
+*
+* Purpose:   The body of a solving thread.
+*
+* Params:    state - The shared state.
+*
+* Returns:   Nothing.
+*
+* Operation: Repeatedly takes the next chunk, solves each of its lines and
+*            passes on the output. In ordered mode, a thread which gets too
+*            far ahead of the oldest unfinished chunk waits for it, so that
+*            the output held back is bounded.
+******************************************************************************/
+static void stream_worker(StreamState& state)
+{
+    std::string output;
+
+    while (true)
+    {
+        size_t index = state.next_chunk.fetch_add(1);
+        if (index >= state.chunks.size())
+        {
+            break;
+        }
+
+        if (!state.unordered)
+        {
+            std::unique_lock<std::mutex> guard(state.lock);
+            state.chunk_written.wait(guard, [&state, index]()
+            {
+                return index < state.num_written + state.window;
+            });
+        }
+
+        const StreamChunk& chunk = state.chunks[index];
+        size_t line = chunk.first_line;
+        output.clear();
+
+        for (size_t begin = chunk.begin; begin < chunk.end; ++line)
+        {
+            const char* newline = (const char*)memchr(state.input + begin,
+                                                      '\n',
+                                                      chunk.end - begin);
+            size_t end = newline ? newline - state.input : chunk.end;
+
+            if (state.unordered)
+            {
+                output += std::to_string(line);
+                output += '\t';
+            }
+            stream_solve_line(state.input + begin, end - begin, state.target,
+                              output);
+            output += '\n';
+
+            begin = end + 1;
+        }
+
+        stream_finish_chunk(state, index, output);
+    }
+}
+
+/******************************************************************************
+* Function:  stream_split
+*
+* Purpose:   Cuts the input into chunks of lines.
+*
+* Params:    input  - The start of the input.
+*            length - The number of bytes in the input.
+*            chunks - Output array holding the chunks.
+*
+* Returns:   Nothing.
+*
+* Operation: Finds the line breaks with memchr, and starts a new chunk after
+*            every STREAM_CHUNK_LINES of them. A last line without a line
+*            break is included.
+******************************************************************************/
+static void stream_split(const char* input, size_t length,
+                         std::vector<StreamChunk>& chunks)
+{
+    StreamChunk chunk = {0, 0, 1};
+    size_t lines = 0;
+    size_t pos = 0;
+
+    while (pos < length)
+    {
+        const char* newline = (const char*)memchr(input + pos, '\n',
+                                                  length - pos);
+        pos = newline ? newline - input + 1 : length;
+
+        if (++lines == STREAM_CHUNK_LINES || pos == length)
+        {
+            chunk.end = pos;
+            chunks.push_back(chunk);
+            chunk.begin = pos;
+            chunk.first_line += lines;
+            lines = 0;
+        }
+    }
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the stream solver.
+*
+* Params:    argc, argv - The command line options described at the top of
+*                         this file.
+*
+* Returns:   0 on success, 1 if the options are invalid or a file cannot be
+*            read or written.
+*
+* Operation: Fills the tables, maps the input, cuts it into chunks, and runs
+*            the solving threads until every chunk has been written out.
+******************************************************************************/
+int main(int argc, char** argv)
+{
+    int num_threads = std::thread::hardware_concurrency();
+    int target = 21;
+    int budget_mb = -1;
+    bool unordered = false;
+    const char* input_path = nullptr;
+    const char* output_path = nullptr;
+
+    for (int ii = 1; ii < argc; ++ii)
+    {
+        if (strcmp(argv[ii], "--unordered") == 0)
+        {
+            unordered = true;
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--threads") == 0)
+        {
+            num_threads = atoi(argv[++ii]);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--target") == 0)
+        {
+            target = atoi(argv[++ii]);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--budget") == 0)
+        {
+            budget_mb = atoi(argv[++ii]);
+        }
+        else if (ii + 1 < argc && strcmp(argv[ii], "--output") == 0)
+        {
+            output_path = argv[++ii];
+        }
+        else if (argv[ii][0] != '-' && input_path == nullptr)
+        {
+            input_path = argv[ii];
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[ii]);
+            return 1;
+        }
+    }
+    if (input_path == nullptr)
+    {
+        fprintf(stderr, "Usage: stream [--threads N] [--target L] "
+                        "[--budget MB] [--unordered] [--output FILE] INPUT\n");
+        return 1;
+    }
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+
+    // Map the input.
+    int input_fd = open(input_path, O_RDONLY);
+    struct stat input_stat;
+    if (input_fd < 0 || fstat(input_fd, &input_stat) != 0)
+    {
+        fprintf(stderr, "Cannot read %s\n", input_path);
+        return 1;
+    }
+
+    size_t length = input_stat.st_size;
+    const char* input = nullptr;
+    if (length > 0)
+    {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE,
+                            input_fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            fprintf(stderr, "Cannot map %s\n", input_path);
+            return 1;
+        }
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        input = (const char*)mapped;
+    }
+
+    // Open the output.
+    int output_fd = STDOUT_FILENO;
+    if (output_path != nullptr)
+    {
+        output_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd < 0)
+        {
+            fprintf(stderr, "Cannot write %s\n", output_path);
+            return 1;
+        }
+    }
+
+    // Fill the tables before any thread needs them.
+    if (budget_mb >= 0)
+    {
+        cube_fill_for_budget((size_t)budget_mb << 20);
+    }
+    cube_fill_phase1_tables();
+    cube_fill_phase2_tables();
+
+    // Set up the shared state and run the threads.
+    StreamState state;
+    state.input = input;
+    stream_split(input, length, state.chunks);
+    state.target = target;
+    state.unordered = unordered;
+    state.output_fd = output_fd;
+    state.next_chunk.store(0);
+    state.window = STREAM_WINDOW * num_threads;
+    state.num_written = 0;
+    state.finished.resize(state.window);
+    state.is_finished.resize(state.window, false);
+    state.buffer.reserve(2 * STREAM_WRITE_BYTES);
+    state.write_failed = false;
+
+    std::vector<std::thread> threads;
+    for (int ii = 1; ii < num_threads; ++ii)
+    {
+        threads.push_back(std::thread(stream_worker, std::ref(state)));
+    }
+    stream_worker(state);
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    stream_write(state);
+    if (length > 0)
+    {
+        munmap((void*)input, length);
+    }
+    close(input_fd);
+    if (output_path != nullptr && close(output_fd) != 0)
+    {
+        state.write_failed = true;
+    }
+
+    if (state.write_failed)
+    {
+        fprintf(stderr, "Cannot write output\n");
+        return 1;
+    }
+    return 0;
+}
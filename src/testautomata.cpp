@@ -0,0 +1,238 @@
+/******************************************************************************
+* File:    testautomata.cpp
+*
+* Purpose: Checks the move-sequence automata of both phases against brute
+*          force.
+*
+*          Before any are generated, the automata must accept exactly the
+*          sequences which the allowed moves constants do. Once generated to
+*          some depth, they must still reach every cube state that any
+*          sequence of moves reaches in as few moves, and up to that depth
+*          must accept exactly one sequence for each state, so that the
+*          number of sequences of each length matches the number of states
+*          at that distance found by a breadth-first search.
+*
+*          Usage: testautomata
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <cstdio>
+#include <unordered_set>
+#include <vector>
+
+#include <cube.h>
+#include <cubephase.h>
+
+/******************************************************************************
+* Constants
+*
+* The depths to which the automata are generated, and to which the sequences
+* they accept are checked.
+******************************************************************************/
+#define TEST_P1_DEPTH      4
+#define TEST_P2_DEPTH      6
+#define TEST_PLAIN_LENGTH  5
+
+typedef std::unordered_set<CubeKey, CubeKeyHash> TestStates;
+
+/******************************************************************************
+* Function:  test_plain_walk
+*
+* Purpose:   Checks that an automaton which has not been generated accepts
+*            the same sequences as the allowed moves constants.
+*
+* Params:    automaton - The automaton.
+*            allowed   - The allowed moves constants of the same phase.
+*            state     - The state of the automaton so far.
+*            last_move - The last move, or NUM_MOVES at the start.
+*            length    - The number of moves still to make.
+*
+* Returns:   The number of sequences at which the two disagree.
+*
+* Operation: Compares the moves allowed at this point, and recurses into each
+*            of them.
+******************************************************************************/
+static int test_plain_walk(CubeAutomaton& automaton, const uint32_t* allowed,
+                           int state, int last_move, int length)
+{
+    uint32_t moves = automaton.moves(state);
+    if (moves != allowed[last_move])
+    {
+        return 1;
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    int failures = 0;
+    while (moves != 0)
+    {
+        int move = cube_next_move(moves);
+        failures += test_plain_walk(automaton, allowed,
+                                    automaton.next(state, move), move,
+                                    length - 1);
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  test_automaton_walk
+*
+* Purpose:   Collects the cube states reached by the sequences an automaton
+*            accepts.
+*
+* Params:    automaton - The automaton.
+*            state     - The state of the automaton so far.
+*            cube      - The cube reached so far.
+*            length    - The number of moves made so far.
+*            max_len   - The length of the longest sequences to follow.
+*            counts    - The number of sequences of each length, which are
+*                        added to.
+*            reached   - The cube states reached by sequences of each length,
+*                        which are added to.
+*
+* Returns:   Nothing.
+*
+* Operation: Follows every move which the automaton allows.
+******************************************************************************/
+static void test_automaton_walk(CubeAutomaton& automaton, int state, Cube cube,
+                                int length, int max_len,
+                                std::vector<uint64_t>& counts,
+                                std::vector<TestStates>& reached)
+{
+    ++counts[length];
+    reached[length].insert(cube.key());
+    if (length == max_len)
+    {
+        return;
+    }
+
+    for (uint32_t moves = automaton.moves(state); moves != 0; )
+    {
+        int move = cube_next_move(moves);
+        test_automaton_walk(automaton, automaton.next(state, move),
+                            cube.perform_move(move), length + 1, max_len,
+                            counts, reached);
+    }
+}
+
+/******************************************************************************
+* Function:  test_generated
+*
+* Purpose:   Checks a generated automaton against a breadth-first search.
+*
+* Params:    name      - The name of the automaton, for messages.
+*            automaton - The automaton, already generated.
+*            alphabet  - The moves of its phase.
+*            depth     - The depth it was generated to.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Finds the states at each distance from solved up to one more
+*            than the depth by breadth-first search with the moves of the
+*            phase. Up to the depth, the automaton must accept exactly as many
+*            sequences of each length as there are states at that distance,
+*            and at every length the states it reaches within that many moves
+*            must be all of those within that distance.
+******************************************************************************/
+static int test_generated(const char* name, CubeAutomaton& automaton,
+                          uint32_t alphabet, int depth)
+{
+    int max_len = depth + 1;
+
+    // Breadth-first search for the states at each distance.
+    std::vector<std::vector<Cube>> layers(1, std::vector<Cube>(1, Cube()));
+    TestStates seen = {Cube().key()};
+    for (int length = 1; length <= max_len; ++length)
+    {
+        layers.push_back(std::vector<Cube>());
+        for (Cube& cube : layers[length - 1])
+        {
+            for (int move = 0; move < NUM_MOVES; ++move)
+            {
+                if ((alphabet & CUBE_MOVE_BIT(move)) == 0)
+                {
+                    continue;
+                }
+                Cube child = cube.perform_move(move);
+                if (seen.insert(child.key()).second)
+                {
+                    layers[length].push_back(child);
+                }
+            }
+        }
+    }
+
+    std::vector<uint64_t> counts(max_len + 1, 0);
+    std::vector<TestStates> reached(max_len + 1);
+    test_automaton_walk(automaton, automaton.start(), Cube(), 0, max_len,
+                        counts, reached);
+
+    int failures = 0;
+    size_t within = 0;
+    TestStates reached_within;
+    for (int length = 0; length <= max_len; ++length)
+    {
+        within += layers[length].size();
+        reached_within.insert(reached[length].begin(), reached[length].end());
+
+        if (length <= depth && counts[length] != layers[length].size())
+        {
+            printf("FAIL: %s accepts %llu sequences of length %d, but %zu "
+                   "states are at that distance\n", name,
+                   (unsigned long long)counts[length], length,
+                   layers[length].size());
+            ++failures;
+        }
+        if (reached_within.size() != within)
+        {
+            printf("FAIL: %s reaches %zu of the %zu states within %d "
+                   "moves\n", name, reached_within.size(), within, length);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Checks the automata as they start out, and then generates them
+*            and checks them again.
+******************************************************************************/
+int main()
+{
+    int failures = 0;
+
+    if (test_plain_walk(cube_p1_automaton, cube_p1_allowed_moves,
+                        cube_p1_automaton.start(), NUM_MOVES,
+                        TEST_PLAIN_LENGTH) != 0 ||
+        test_plain_walk(cube_p2_automaton, cube_p2_allowed_moves,
+                        cube_p2_automaton.start(), NUM_MOVES,
+                        TEST_PLAIN_LENGTH) != 0)
+    {
+        printf("FAIL: the initial automata differ from the allowed moves\n");
+        ++failures;
+    }
+
+    cube_create_automata(TEST_P1_DEPTH, TEST_P2_DEPTH);
+    failures += test_generated("phase 1 automaton", cube_p1_automaton,
+                               CUBE_P1_MOVES, TEST_P1_DEPTH);
+    failures += test_generated("phase 2 automaton", cube_p2_automaton,
+                               CUBE_P2_MOVES, TEST_P2_DEPTH);
+
+    printf("testautomata: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
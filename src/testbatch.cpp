@@ -0,0 +1,119 @@
+/******************************************************************************
+* File:    testbatch.cpp
+*
+* Purpose: Checks the batch solver against the single-threaded one.
+*
+*          Lists of seeded scrambles are solved by a CubeBatch, and the
+*          solution it gives each cube must solve that cube when applied
+*          move by move, and must be the same length as the solution a
+*          CubeSolver finds with the same target. One list has more cubes
+*          than there are lanes, so that lanes move on to further cubes, and
+*          one has fewer, so that some lanes are never used. The short list
+*          is searched to the end.
+*
+*          Usage: testbatch
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <cube.h>
+#include <cubebatch.h>
+#include <cubesolver.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED          4
+#define TEST_NUM_SHORT     (CUBE_BATCH_LANES - 5)
+#define TEST_SHORT_LENGTH  9
+#define TEST_NUM_LONG      (2 * CUBE_BATCH_LANES + 3)
+#define TEST_LONG_LENGTH   30
+#define TEST_TARGET        21
+
+/******************************************************************************
+* Function:  test_batch
+*
+* Purpose:   Checks the batch solver on a list of cubes.
+*
+* Params:    rng        - The random number generator to scramble with.
+*            num_cubes  - The number of cubes.
+*            scramble   - The number of random moves in each scramble.
+*            target     - The target length, or 0 to search to the end.
+*
+* Returns:   The number of cubes whose solutions failed the checks.
+*
+* Operation: Makes the scrambles, solves them all with one CubeBatch, and
+*            then each with a CubeSolver, and compares the solutions.
+******************************************************************************/
+static int test_batch(std::mt19937& rng, int num_cubes, int scramble,
+                      int target)
+{
+    std::vector<Cube> cubes(num_cubes);
+    for (Cube& cube : cubes)
+    {
+        for (int ii = 0; ii < scramble; ++ii)
+        {
+            cube = cube.perform_move(rng() % NUM_MOVES);
+        }
+    }
+
+    CubeBatch batch;
+    batch.set_target_length(target);
+    std::vector<std::vector<int>> solutions = batch.solve(cubes);
+
+    int failures = 0;
+    for (int test = 0; test < num_cubes; ++test)
+    {
+        Cube cube = cubes[test];
+        for (int move : solutions[test])
+        {
+            cube = cube.perform_move(move);
+        }
+
+        CubeSolver solver(cubes[test]);
+        solver.set_target_length(target);
+        solver.solve([](std::vector<int>&) {});
+        size_t expected = solver.best_solution().size();
+
+        if (!(cube.key() == Cube().key()) || solutions[test].empty() ||
+            solutions[test].size() != expected)
+        {
+            printf("FAIL: cube %d of %d: the batch's solution has %zu moves "
+                   "and %s, and the solver's has %zu\n", test, num_cubes,
+                   solutions[test].size(),
+                   (cube.key() == Cube().key()) ? "solves it"
+                                                : "does not solve it",
+                   expected);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Checks the short list and then the long one.
+******************************************************************************/
+int main()
+{
+    std::mt19937 rng(TEST_SEED);
+    int failures = test_batch(rng, TEST_NUM_SHORT, TEST_SHORT_LENGTH, 0);
+    failures += test_batch(rng, TEST_NUM_LONG, TEST_LONG_LENGTH, TEST_TARGET);
+
+    printf("testbatch: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
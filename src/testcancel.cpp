@@ -0,0 +1,278 @@
+/******************************************************************************
+* File:    testcancel.cpp
+*
+* Purpose: Checks that cancellation tokens stop the solvers promptly.
+*
+*          A search for the shortest solution of a long scramble, which would
+*          otherwise run for a very long time, is started with solve_async
+*          and cancelled once it has found a solution. The future must then
+*          be ready within a deadline, and hold the last solution given to
+*          the callback, which must solve the cube. A CubePipeline and a
+*          CubeBatch given a token which is already cancelled must return
+*          within the deadline, and anything they give must solve the cube.
+*
+*          Usage: testcancel
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <random>
+#include <vector>
+
+#include <cube.h>
+#include <cubebatch.h>
+#include <cubepipeline.h>
+#include <cubesolver.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED            5
+#define TEST_SCRAMBLE_LENGTH 30
+#define TEST_WARM_LENGTH     6
+#define TEST_PRODUCERS       2
+#define TEST_CONSUMERS       2
+#define TEST_CAPACITY        1024
+#define TEST_DEADLINE_MS     2000
+
+/******************************************************************************
+* Function:  test_solves
+*
+* Purpose:   Checks that a solution solves a cube.
+*
+* Params:    cube     - The cube.
+*            solution - The moves of the solution.
+*
+* Returns:   True if applying the moves to the cube leaves it solved.
+*
+* Operation: Performs each move in turn and compares the keys.
+******************************************************************************/
+static bool test_solves(Cube cube, const std::vector<int>& solution)
+{
+    for (int move : solution)
+    {
+        cube = cube.perform_move(move);
+    }
+    return cube.key() == Cube().key();
+}
+
+/******************************************************************************
+* Function:  test_wait
+*
+* Purpose:   Waits for a cancelled search to finish.
+*
+* Params:    name   - The name of the search, for messages.
+*            result - The future of the search.
+*
+* Returns:   Nothing.
+*
+* Operation: Waits up to the deadline. A search which has not finished by
+*            then may never finish, and could not be waited for or destroyed,
+*            so the test fails at once without returning.
+******************************************************************************/
+template <typename T>
+static void test_wait(const char* name, std::future<T>& result)
+{
+    if (result.wait_for(std::chrono::milliseconds(TEST_DEADLINE_MS)) !=
+        std::future_status::ready)
+    {
+        printf("FAIL: %s is still running %d ms after being cancelled\n",
+               name, TEST_DEADLINE_MS);
+        fflush(stdout);
+        std::_Exit(1);
+    }
+}
+
+/******************************************************************************
+* Function:  test_solve_async
+*
+* Purpose:   Checks cancelling a search started with solve_async.
+*
+* Params:    cube - The cube, which must be far from solved.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Searches for the shortest solution, waits for the first
+*            solution to be given to the callback, cancels the token, and
+*            checks the future and the solver.
+******************************************************************************/
+static int test_solve_async(const Cube& cube)
+{
+    CubeCancel token;
+    CubeSolver solver(cube);
+    solver.set_target_length(0);
+    solver.set_cancel(token);
+
+    std::atomic<bool> found(false);
+    std::vector<int> last;
+    std::future<std::vector<int>> result =
+        solver.solve_async([&](std::vector<int>& solution)
+                           {
+                               last = solution;
+                               found = true;
+                           });
+
+    while (!found)
+    {
+        if (result.wait_for(std::chrono::milliseconds(1)) ==
+            std::future_status::ready)
+        {
+            printf("FAIL: solve_async finished the whole search\n");
+            return 1;
+        }
+    }
+    token.cancel();
+    test_wait("solve_async", result);
+
+    std::vector<int> solution = result.get();
+    int failures = 0;
+    if (!solver.cancelled())
+    {
+        printf("FAIL: solve_async: the solver does not say it was "
+               "cancelled\n");
+        ++failures;
+    }
+    if (solution.empty() || solution != last || !test_solves(cube, solution))
+    {
+        printf("FAIL: solve_async: the future holds %zu moves, which %s "
+               "the %zu last given to the callback, and %s\n",
+               solution.size(), (solution == last) ? "are" : "are not",
+               last.size(),
+               test_solves(cube, solution) ? "solve the cube"
+                                           : "do not solve the cube");
+        ++failures;
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  test_pipeline
+*
+* Purpose:   Checks a pipeline given a token which is already cancelled.
+*
+* Params:    cube - The cube, which must be far from solved.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Searches for the shortest solution on another thread, and
+*            checks that it returns, and that what it found solves the cube.
+******************************************************************************/
+static int test_pipeline(const Cube& cube)
+{
+    CubeCancel token;
+    token.cancel();
+    CubePipeline pipeline(cube, TEST_PRODUCERS, TEST_CONSUMERS, TEST_CAPACITY);
+    pipeline.set_target_length(0);
+    pipeline.set_cancel(token);
+
+    std::future<void> result = std::async(std::launch::async, [&]()
+    {
+        pipeline.solve([](std::vector<int>&) {});
+    });
+    test_wait("CubePipeline::solve", result);
+
+    std::vector<int> solution = pipeline.best_solution();
+    if (!solution.empty() && !test_solves(cube, solution))
+    {
+        printf("FAIL: CubePipeline::solve: the solution does not solve the "
+               "cube\n");
+        return 1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function:  test_batch
+*
+* Purpose:   Checks a batch given a token which is already cancelled.
+*
+* Params:    cubes - The cubes, which must be far from solved.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Searches for the shortest solutions on another thread, and
+*            checks that it returns a result for each cube, and that each
+*            result which is not empty solves its cube.
+******************************************************************************/
+static int test_batch(const std::vector<Cube>& cubes)
+{
+    CubeCancel token;
+    token.cancel();
+    CubeBatch batch;
+    batch.set_target_length(0);
+    batch.set_cancel(token);
+
+    std::vector<Cube> input = cubes;
+    std::future<std::vector<std::vector<int>>> result =
+        std::async(std::launch::async, [&]() { return batch.solve(input); });
+    test_wait("CubeBatch::solve", result);
+
+    std::vector<std::vector<int>> solutions = result.get();
+    if (solutions.size() != cubes.size())
+    {
+        printf("FAIL: CubeBatch::solve: %zu results for %zu cubes\n",
+               solutions.size(), cubes.size());
+        return 1;
+    }
+
+    int failures = 0;
+    for (size_t ii = 0; ii < cubes.size(); ++ii)
+    {
+        if (!solutions[ii].empty() && !test_solves(cubes[ii], solutions[ii]))
+        {
+            printf("FAIL: CubeBatch::solve: the solution of cube %zu does not "
+                   "solve it\n", ii);
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Solves a short scramble first, so that the tables are loaded
+*            before any deadline starts, and then makes the long scrambles
+*            and runs each check.
+******************************************************************************/
+int main()
+{
+    std::mt19937 rng(TEST_SEED);
+
+    Cube warm;
+    for (int ii = 0; ii < TEST_WARM_LENGTH; ++ii)
+    {
+        warm = warm.perform_move(rng() % NUM_MOVES);
+    }
+    CubeSolver(warm).solve([](std::vector<int>&) {});
+
+    std::vector<Cube> cubes(CUBE_BATCH_LANES + 1);
+    for (Cube& cube : cubes)
+    {
+        for (int ii = 0; ii < TEST_SCRAMBLE_LENGTH; ++ii)
+        {
+            cube = cube.perform_move(rng() % NUM_MOVES);
+        }
+    }
+
+    int failures = test_solve_async(cubes[0]);
+    failures += test_pipeline(cubes[0]);
+    failures += test_batch(cubes);
+
+    printf("testcancel: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+/******************************************************************************
+* File:    testendgame.cpp
+*
+* Purpose: Checks the end-game table against brute force.
+*
+*          The table is filled to a small depth, and the distance it gives
+*          for each of a number of random phase 2 positions must be the
+*          distance found by trying every sequence of phase 2 moves, or -1
+*          when that is more than the depth. Filling with a budget which
+*          only allows for a smaller depth must fill the table to that
+*          depth, and a budget which allows for nothing must leave the
+*          table as it was.
+*
+*          Usage: testendgame
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <cstdio>
+#include <random>
+
+#include <cube.h>
+#include <cubephase.h>
+#include <cubetables.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED          11
+#define TEST_DEPTH         5
+#define TEST_NUM_POSITIONS 60
+#define TEST_MAX_SCRAMBLE  (TEST_DEPTH + 3)
+
+/******************************************************************************
+* Function:  test_reaches
+*
+* Purpose:   Checks whether a position can be solved in a given number of
+*            phase 2 moves.
+*
+* Params:    cube      - The position.
+*            length    - The number of moves to make.
+*            last_move - The last move, or NUM_MOVES at the start.
+*            solved    - The key of the solved cube.
+*
+* Returns:   True if some sequence of that many moves solves the position.
+*
+* Operation: Tries every move which the phase 2 allowed moves constants
+*            permit after the last one.
+******************************************************************************/
+static bool test_reaches(Cube cube, int length, int last_move,
+                         const CubeKey& solved)
+{
+    if (length == 0)
+    {
+        return cube.key() == solved;
+    }
+
+    for (uint32_t moves = cube_p2_allowed_moves[last_move]; moves != 0; )
+    {
+        int move = cube_next_move(moves);
+        if (test_reaches(cube.perform_move(move), length - 1, move, solved))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function:  test_distance
+*
+* Purpose:   Finds the phase 2 distance of a position by brute force.
+*
+* Params:    cube - The position, which must be in the phase 2 subgroup.
+*
+* Returns:   The number of phase 2 moves needed to solve the position, or -1
+*            if that is more than the depth of the test.
+*
+* Operation: Tries each length in turn, shortest first.
+******************************************************************************/
+static int test_distance(const Cube& cube)
+{
+    for (int length = 0; length <= TEST_DEPTH; ++length)
+    {
+        if (test_reaches(cube, length, NUM_MOVES, Cube().key()))
+        {
+            return length;
+        }
+    }
+    return -1;
+}
+
+/******************************************************************************
+* Function:  test_budget
+*
+* Purpose:   Checks filling the table with a limited budget.
+*
+* Params:    None.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Fills the table with exactly the budget which one move less than
+*            the test depth needs, and then with no budget at all.
+******************************************************************************/
+static int test_budget()
+{
+    int failures = 0;
+    int depth = cube_fill_endgame_table(TEST_DEPTH,
+                                        cube_endgame_bytes(TEST_DEPTH - 1));
+    if (depth != TEST_DEPTH - 1 || cube_endgame_table.depth() != depth)
+    {
+        printf("FAIL: a budget for depth %d filled the table to depth %d, "
+               "and it reports depth %d\n", TEST_DEPTH - 1, depth,
+               cube_endgame_table.depth());
+        ++failures;
+    }
+
+    depth = cube_fill_endgame_table(TEST_DEPTH, 0);
+    if (depth != -1 || cube_endgame_table.depth() != TEST_DEPTH - 1)
+    {
+        printf("FAIL: no budget filled the table to depth %d, and it "
+               "reports depth %d\n", depth, cube_endgame_table.depth());
+        ++failures;
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Fills the table to the test depth, compares it with brute force
+*            on random phase 2 positions, and then checks the budget.
+******************************************************************************/
+int main()
+{
+    int failures = 0;
+    int depth = cube_fill_endgame_table(TEST_DEPTH, SIZE_MAX);
+    if (depth != TEST_DEPTH)
+    {
+        printf("FAIL: the table was filled to depth %d, not %d\n", depth,
+               TEST_DEPTH);
+        ++failures;
+    }
+
+    std::mt19937 rng(TEST_SEED);
+    for (int test = 0; test < TEST_NUM_POSITIONS; ++test)
+    {
+        // Scramble with random moves from those allowed at the start, which
+        // are exactly the phase 2 moves.
+        Cube cube;
+        for (int ii = rng() % (TEST_MAX_SCRAMBLE + 1); ii > 0; --ii)
+        {
+            uint32_t moves = cube_p2_allowed_moves[NUM_MOVES];
+            for (int skip = rng() % __builtin_popcount(moves); skip > 0;
+                 --skip)
+            {
+                cube_next_move(moves);
+            }
+            cube = cube.perform_move(cube_next_move(moves));
+        }
+
+        int expected = test_distance(cube);
+        int found = cube_endgame_table(cube.coord_corner_permutation(),
+                                       cube.coord_edge_permutation(),
+                                       cube.coord_ud_permutation());
+        if (found != expected)
+        {
+            printf("FAIL: position %d: the table gives %d, and brute force "
+                   "%d\n", test, found, expected);
+            ++failures;
+        }
+    }
+
+    failures += test_budget();
+
+    printf("testendgame: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+/******************************************************************************
+* File:    testenumerate.cpp
+*
+* Purpose: Checks the enumeration of every solution of a given length
+*          against brute force.
+*
+*          For short scrambles and lengths, every sequence of moves which the
+*          allowed moves constants permit is tried, and those which solve the
+*          cube must be exactly the solutions the enumerator gives, each
+*          given once. The automata are generated first, since they forbid
+*          sequences which the enumerator must still find, and a limit on
+*          the number of solutions must give exactly that many.
+*
+*          Usage: testenumerate
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <cube.h>
+#include <cubeenumerate.h>
+#include <cubephase.h>
+#include <cubetext.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED            7
+#define TEST_NUM_SCRAMBLES   6
+#define TEST_SCRAMBLE_LENGTH 5
+#define TEST_THREADS         2
+#define TEST_P1_DEPTH        4
+#define TEST_P2_DEPTH        6
+#define TEST_MAX_SOLUTIONS   3
+
+typedef std::set<std::vector<int>> TestSolutions;
+
+/******************************************************************************
+* Scrambles which have several solutions of their own length, some of which
+* the generated automata forbid
+******************************************************************************/
+static const char* test_fixed_scrambles[] =
+{
+    "R2 U2 R2 U2 R2 U2",
+    "R2 L2 U2 D2 F2"
+};
+
+/******************************************************************************
+* Function:  test_brute_force
+*
+* Purpose:   Finds every solution of a given length by brute force.
+*
+* Params:    cube      - The cube reached so far.
+*            length    - The number of moves still to make.
+*            last_move - The last move, or NUM_MOVES at the start.
+*            solved    - The key of the solved cube.
+*            path      - The moves made so far.
+*            found     - The solutions, which are added to.
+*
+* Returns:   Nothing.
+*
+* Operation: Tries every move which the phase 1 allowed moves constants
+*            permit after the last one.
+******************************************************************************/
+static void test_brute_force(Cube cube, int length, int last_move,
+                             const CubeKey& solved, std::vector<int>& path,
+                             TestSolutions& found)
+{
+    if (length == 0)
+    {
+        if (cube.key() == solved)
+        {
+            found.insert(path);
+        }
+        return;
+    }
+
+    for (uint32_t moves = cube_p1_allowed_moves[last_move]; moves != 0; )
+    {
+        int move = cube_next_move(moves);
+        path.push_back(move);
+        test_brute_force(cube.perform_move(move), length - 1, move, solved,
+                         path, found);
+        path.pop_back();
+    }
+}
+
+/******************************************************************************
+* Function:  test_enumerate
+*
+* Purpose:   Checks the enumerator on one cube and length.
+*
+* Params:    name   - A description of the cube, for messages.
+*            cube   - The cube.
+*            length - The length of the solutions.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Compares the solutions found by brute force with those given
+*            by the enumerator, without and then with a limit.
+******************************************************************************/
+static int test_enumerate(const char* name, const Cube& cube, int length)
+{
+    TestSolutions expected;
+    std::vector<int> path;
+    test_brute_force(cube, length, NUM_MOVES, Cube().key(), path, expected);
+
+    TestSolutions found;
+    int repeats = 0;
+    CubeEnumerator enumerator(cube, TEST_THREADS);
+    size_t count = enumerator.enumerate(length,
+                                        [&](std::vector<int>& solution)
+                                        {
+                                            repeats +=
+                                                !found.insert(solution).second;
+                                        });
+
+    int failures = 0;
+    if (found != expected || repeats != 0 || count != expected.size())
+    {
+        printf("FAIL: %s at length %d: %zu solutions by brute force, but %zu "
+               "distinct of %zu enumerated\n", name, length, expected.size(),
+               found.size(), count);
+        ++failures;
+    }
+
+    size_t calls = 0;
+    enumerator.set_max_solutions(TEST_MAX_SOLUTIONS);
+    count = enumerator.enumerate(length,
+                                 [&](std::vector<int>&) { ++calls; });
+    size_t limit = std::min(expected.size(), (size_t)TEST_MAX_SOLUTIONS);
+    if (count != limit || calls != limit)
+    {
+        printf("FAIL: %s at length %d: %zu solutions with a limit of %d\n",
+               name, length, calls, TEST_MAX_SOLUTIONS);
+        ++failures;
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Generates the automata, and checks some scrambles with many
+*            solutions of the same length which they tell apart, and then
+*            random short scrambles at their own length.
+******************************************************************************/
+int main()
+{
+    cube_create_automata(TEST_P1_DEPTH, TEST_P2_DEPTH);
+    int failures = 0;
+
+    std::vector<int> moves;
+    Cube cube;
+    for (const char* text : test_fixed_scrambles)
+    {
+        moves.clear();
+        cube_parse_moves(text, strlen(text), moves);
+        cube = Cube();
+        for (int move : moves)
+        {
+            cube = cube.perform_move(move);
+        }
+        failures += test_enumerate(text, cube, moves.size());
+    }
+
+    std::mt19937 rng(TEST_SEED);
+    for (int test = 0; test < TEST_NUM_SCRAMBLES; ++test)
+    {
+        moves.clear();
+        cube = Cube();
+        for (int ii = 0; ii < TEST_SCRAMBLE_LENGTH; ++ii)
+        {
+            moves.push_back(rng() % NUM_MOVES);
+            cube = cube.perform_move(moves.back());
+        }
+        std::string name;
+        cube_format_moves(moves, name);
+        failures += test_enumerate(name.c_str(), cube, TEST_SCRAMBLE_LENGTH);
+    }
+
+    printf("testenumerate: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+/******************************************************************************
+* File:    testexit.cpp
+*
+* Purpose: Checks that the program exits cleanly once tables have been
+*          filled.
+*
+*          The tables are globals in one file, which free their memory
+*          through the allocator in another when they are destroyed at exit,
+*          and the order in which the globals of different files are
+*          destroyed follows the order in which the files are linked. The
+*          makefile links this test in both orders, and each must exit with
+*          status 0.
+*
+*          Usage: testexit
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <cstdio>
+
+#include <cubetables.h>
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0, unless the exit itself fails.
+*
+* Operation: Fills some transition tables, which take ordinary pages, and a
+*            near-solved table large enough to be put on huge pages, and
+*            returns, leaving the tables to be freed by their destructors.
+******************************************************************************/
+int main()
+{
+    int depth = cube_fill_near_table(4, SIZE_MAX);
+    printf("testexit: near-solved table filled to depth %d\n", depth);
+    return 0;
+}
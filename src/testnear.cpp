@@ -0,0 +1,224 @@
+/******************************************************************************
+* File:    testnear.cpp
+*
+* Purpose: Checks the near-solved table against brute force.
+*
+*          The table is filled to a small depth, and for each of a number of
+*          random positions, the path which it gives must solve the position
+*          when applied move by move to the cube, and must be as long as the
+*          shortest solution found by trying every sequence of moves. A
+*          position further from solved than the depth must not be found.
+*          Filling with a budget which only allows for a smaller depth must
+*          fill the table to that depth, and a budget which allows for
+*          nothing must leave the table as it was.
+*
+*          Usage: testnear
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <cube.h>
+#include <cubephase.h>
+#include <cubetables.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED          13
+#define TEST_DEPTH         4
+#define TEST_NUM_POSITIONS 60
+#define TEST_MAX_SCRAMBLE  (TEST_DEPTH + 2)
+
+/******************************************************************************
+* Function:  test_reaches
+*
+* Purpose:   Checks whether a position can be solved in a given number of
+*            moves.
+*
+* Params:    cube      - The position.
+*            length    - The number of moves to make.
+*            last_move - The last move, or NUM_MOVES at the start.
+*            solved    - The key of the solved cube.
+*
+* Returns:   True if some sequence of that many moves solves the position.
+*
+* Operation: Tries every move which the phase 1 allowed moves constants
+*            permit after the last one.
+******************************************************************************/
+static bool test_reaches(Cube cube, int length, int last_move,
+                         const CubeKey& solved)
+{
+    if (length == 0)
+    {
+        return cube.key() == solved;
+    }
+
+    for (uint32_t moves = cube_p1_allowed_moves[last_move]; moves != 0; )
+    {
+        int move = cube_next_move(moves);
+        if (test_reaches(cube.perform_move(move), length - 1, move, solved))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function:  test_distance
+*
+* Purpose:   Finds the distance of a position from solved by brute force.
+*
+* Params:    cube - The position.
+*
+* Returns:   The number of moves needed to solve the position, or -1 if that
+*            is more than the depth of the test.
+*
+* Operation: Tries each length in turn, shortest first.
+******************************************************************************/
+static int test_distance(const Cube& cube)
+{
+    for (int length = 0; length <= TEST_DEPTH; ++length)
+    {
+        if (test_reaches(cube, length, NUM_MOVES, Cube().key()))
+        {
+            return length;
+        }
+    }
+    return -1;
+}
+
+/******************************************************************************
+* Function:  test_position
+*
+* Purpose:   Checks the path which the table gives for one position.
+*
+* Params:    test - The number of the position, for messages.
+*            cube - The position.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Asks the table for a path, applies it to the cube, and compares
+*            its length with the distance found by brute force.
+******************************************************************************/
+static int test_position(int test, const Cube& cube)
+{
+    Cube copy = cube;
+    CubeCoords coords = copy.coords();
+    std::vector<int> path;
+    bool found = cube_near_table.path_to_solved(coords.co, coords.eo,
+                                                coords.cp, coords.ud_sorted,
+                                                coords.rl_sorted,
+                                                coords.fb_sorted, path);
+    int expected = test_distance(cube);
+
+    if (!found)
+    {
+        if (expected != -1)
+        {
+            printf("FAIL: position %d: not in the table, but %d moves from "
+                   "solved\n", test, expected);
+            return 1;
+        }
+        return 0;
+    }
+
+    Cube solved = cube;
+    for (int move : path)
+    {
+        solved = solved.perform_move(move);
+    }
+    if (!(solved.key() == Cube().key()) || (int)path.size() != expected)
+    {
+        printf("FAIL: position %d: the path has %zu moves and %s, and the "
+               "position is %d moves from solved\n", test, path.size(),
+               (solved.key() == Cube().key()) ? "solves it"
+                                              : "does not solve it",
+               expected);
+        return 1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function:  test_budget
+*
+* Purpose:   Checks filling the table with a limited budget.
+*
+* Params:    None.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Fills the table with exactly the budget which one move less than
+*            the test depth needs, and then with no budget at all.
+******************************************************************************/
+static int test_budget()
+{
+    int failures = 0;
+    int depth = cube_fill_near_table(TEST_DEPTH,
+                                     cube_near_bytes(TEST_DEPTH - 1));
+    if (depth != TEST_DEPTH - 1 || cube_near_table.depth() != depth)
+    {
+        printf("FAIL: a budget for depth %d filled the table to depth %d, "
+               "and it reports depth %d\n", TEST_DEPTH - 1, depth,
+               cube_near_table.depth());
+        ++failures;
+    }
+
+    depth = cube_fill_near_table(TEST_DEPTH, 0);
+    if (depth != -1 || cube_near_table.depth() != TEST_DEPTH - 1)
+    {
+        printf("FAIL: no budget filled the table to depth %d, and it "
+               "reports depth %d\n", depth, cube_near_table.depth());
+        ++failures;
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Fills the table to the test depth, checks it on random
+*            positions, and then checks the budget.
+******************************************************************************/
+int main()
+{
+    int failures = 0;
+    int depth = cube_fill_near_table(TEST_DEPTH, SIZE_MAX);
+    if (depth != TEST_DEPTH)
+    {
+        printf("FAIL: the table was filled to depth %d, not %d\n", depth,
+               TEST_DEPTH);
+        ++failures;
+    }
+
+    std::mt19937 rng(TEST_SEED);
+    for (int test = 0; test < TEST_NUM_POSITIONS; ++test)
+    {
+        Cube cube;
+        for (int ii = rng() % (TEST_MAX_SCRAMBLE + 1); ii > 0; --ii)
+        {
+            cube = cube.perform_move(rng() % NUM_MOVES);
+        }
+        failures += test_position(test, cube);
+    }
+
+    failures += test_budget();
+
+    printf("testnear: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/******************************************************************************
+* File:    testpipeline.cpp
+*
+* Purpose: Checks the pipelined solver against the single-threaded one.
+*
+*          Seeded scrambles are solved by a CubePipeline with two producer
+*          and two consumer threads, and each solution it gives must solve
+*          its cube when applied move by move. Short scrambles are searched
+*          to the end, where both solvers must find solutions of the same,
+*          shortest, length, and long scrambles are searched until a
+*          solution within the target length is found.
+*
+*          Usage: testpipeline
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <cube.h>
+#include <cubepipeline.h>
+#include <cubesolver.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED          3
+#define TEST_PRODUCERS     2
+#define TEST_CONSUMERS     2
+#define TEST_CAPACITY      1024
+#define TEST_NUM_SHORT     8
+#define TEST_SHORT_LENGTH  9
+#define TEST_NUM_LONG      8
+#define TEST_LONG_LENGTH   30
+#define TEST_TARGET        21
+
+/******************************************************************************
+* Function:  test_solves
+*
+* Purpose:   Checks that a solution solves a cube.
+*
+* Params:    cube     - The cube.
+*            solution - The moves of the solution.
+*
+* Returns:   True if applying the moves to the cube leaves it solved.
+*
+* Operation: Performs each move in turn and compares the keys.
+******************************************************************************/
+static bool test_solves(Cube cube, const std::vector<int>& solution)
+{
+    for (int move : solution)
+    {
+        cube = cube.perform_move(move);
+    }
+    return cube.key() == Cube().key();
+}
+
+/******************************************************************************
+* Function:  test_pipeline
+*
+* Purpose:   Checks the pipeline on one cube.
+*
+* Params:    test   - The number of the cube, for messages.
+*            cube   - The cube.
+*            target - The target length, or 0 to search to the end.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Solves the cube with the pipeline and with a CubeSolver. The
+*            pipeline's solution must solve the cube, and must be no longer
+*            than the target, or, when searching to the end, be the same
+*            length as the solver's.
+******************************************************************************/
+static int test_pipeline(int test, const Cube& cube, int target)
+{
+    CubePipeline pipeline(cube, TEST_PRODUCERS, TEST_CONSUMERS, TEST_CAPACITY);
+    pipeline.set_target_length(target);
+    pipeline.solve([](std::vector<int>&) {});
+    std::vector<int> solution = pipeline.best_solution();
+
+    if (!test_solves(cube, solution))
+    {
+        printf("FAIL: cube %d: the pipeline's solution does not solve it\n",
+               test);
+        return 1;
+    }
+
+    if (target > 0)
+    {
+        if ((int)solution.size() > target)
+        {
+            printf("FAIL: cube %d: the pipeline's solution has %zu moves, "
+                   "more than the target of %d\n", test, solution.size(),
+                   target);
+            return 1;
+        }
+        return 0;
+    }
+
+    CubeSolver solver(cube);
+    solver.solve([](std::vector<int>&) {});
+    if (solution.size() != solver.best_solution().size())
+    {
+        printf("FAIL: cube %d: the pipeline's shortest solution has %zu "
+               "moves, and the solver's %zu\n", test, solution.size(),
+               solver.best_solution().size());
+        return 1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Checks each of the short scrambles searched to the end, and
+*            then each of the long scrambles with the target length.
+******************************************************************************/
+int main()
+{
+    std::mt19937 rng(TEST_SEED);
+    int failures = 0;
+
+    for (int test = 0; test < TEST_NUM_SHORT + TEST_NUM_LONG; ++test)
+    {
+        bool is_short = (test < TEST_NUM_SHORT);
+        Cube cube;
+        for (int ii = is_short ? TEST_SHORT_LENGTH : TEST_LONG_LENGTH;
+             ii > 0; --ii)
+        {
+            cube = cube.perform_move(rng() % NUM_MOVES);
+        }
+        failures += test_pipeline(test, cube, is_short ? 0 : TEST_TARGET);
+    }
+
+    printf("testpipeline: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+/******************************************************************************
+* File:    testsolutions.cpp
+*
+* Purpose: Checks that CubeSolutions hands out improving solutions.
+*
+*          For each of a number of seeded scrambles, the solutions which
+*          next gives must each solve the cube when applied move by move,
+*          and must each be shorter than the one before. Once next returns
+*          false it must keep doing so. Short scrambles are searched to the
+*          end, where the last solution must be as short as the one a
+*          CubeSolver finds, and long scrambles until a solution within the
+*          target length is found.
+*
+*          Usage: testsolutions
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <cube.h>
+#include <cubesolutions.h>
+#include <cubesolver.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED          17
+#define TEST_NUM_SHORT     6
+#define TEST_SHORT_LENGTH  9
+#define TEST_NUM_LONG      6
+#define TEST_LONG_LENGTH   30
+#define TEST_TARGET        21
+
+/******************************************************************************
+* Function:  test_solves
+*
+* Purpose:   Checks that a solution solves a cube.
+*
+* Params:    cube     - The cube.
+*            solution - The moves of the solution.
+*
+* Returns:   True if applying the moves to the cube leaves it solved.
+*
+* Operation: Performs each move in turn and compares the keys.
+******************************************************************************/
+static bool test_solves(Cube cube, const std::vector<int>& solution)
+{
+    for (int move : solution)
+    {
+        cube = cube.perform_move(move);
+    }
+    return cube.key() == Cube().key();
+}
+
+/******************************************************************************
+* Function:  test_solutions
+*
+* Purpose:   Checks the solutions handed out for one cube.
+*
+* Params:    test   - The number of the cube, for messages.
+*            cube   - The cube.
+*            target - The target length, or 0 to search to the end.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Calls next until it returns false, checking each solution, and
+*            then compares the last with the target or with a CubeSolver.
+******************************************************************************/
+static int test_solutions(int test, const Cube& cube, int target)
+{
+    CubeSolutions solutions(cube);
+    solutions.set_target_length(target);
+
+    int failures = 0;
+    int count = 0;
+    std::vector<int> solution;
+    std::vector<int> last;
+    while (solutions.next(solution))
+    {
+        if (!test_solves(cube, solution))
+        {
+            printf("FAIL: cube %d: solution %d does not solve it\n", test,
+                   count);
+            ++failures;
+        }
+        if (count > 0 && solution.size() >= last.size())
+        {
+            printf("FAIL: cube %d: solution %d has %zu moves, after one of "
+                   "%zu\n", test, count, solution.size(), last.size());
+            ++failures;
+        }
+        last = solution;
+        ++count;
+    }
+
+    if (solutions.next(solution))
+    {
+        printf("FAIL: cube %d: another solution after the last\n", test);
+        ++failures;
+    }
+
+    if (count == 0)
+    {
+        printf("FAIL: cube %d: no solutions\n", test);
+        return failures + 1;
+    }
+
+    if (target > 0)
+    {
+        if ((int)last.size() > target)
+        {
+            printf("FAIL: cube %d: the last solution has %zu moves, more "
+                   "than the target of %d\n", test, last.size(), target);
+            ++failures;
+        }
+        return failures;
+    }
+
+    CubeSolver solver(cube);
+    solver.solve([](std::vector<int>&) {});
+    if (last.size() != solver.best_solution().size())
+    {
+        printf("FAIL: cube %d: the last solution has %zu moves, and the "
+               "solver's %zu\n", test, last.size(),
+               solver.best_solution().size());
+        ++failures;
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Checks each of the short scrambles searched to the end, and
+*            then each of the long scrambles with the target length.
+******************************************************************************/
+int main()
+{
+    std::mt19937 rng(TEST_SEED);
+    int failures = 0;
+
+    for (int test = 0; test < TEST_NUM_SHORT + TEST_NUM_LONG; ++test)
+    {
+        bool is_short = (test < TEST_NUM_SHORT);
+        Cube cube;
+        for (int ii = is_short ? TEST_SHORT_LENGTH : TEST_LONG_LENGTH;
+             ii > 0; --ii)
+        {
+            cube = cube.perform_move(rng() % NUM_MOVES);
+        }
+        failures += test_solutions(test, cube, is_short ? 0 : TEST_TARGET);
+    }
+
+    printf("testsolutions: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/******************************************************************************
+* File:    testsym.cpp
+*
+* Purpose: Checks the reduction of cubes under symmetry and inversion, and
+*          the solution cache built on it, against brute force.
+*
+*          The canonical cube of each scramble must be the least of all 96 of
+*          its conjugates and their inverses, found here directly from the
+*          symmetry cubes. A solution to the canonical cube must translate
+*          back into a solution to the scramble, and the cache must give
+*          solutions of the same length to every conjugate of a cube, which
+*          for short scrambles must be the optimal length found by a brute
+*          force search.
+*
+*          Usage: testsym
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <cube.h>
+#include <cubecache.h>
+#include <cubesym.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED            1
+#define TEST_NUM_SCRAMBLES   200
+#define TEST_SCRAMBLE_LENGTH 25
+#define TEST_NUM_SHORT       20
+#define TEST_SHORT_LENGTH    5
+
+/******************************************************************************
+* Function:  test_apply
+*
+* Purpose:   Applies a sequence of moves to a cube.
+*
+* Params:    cube  - The cube to start from.
+*            moves - The moves to apply.
+*
+* Returns:   The cube after the moves.
+*
+* Operation: Performs each move in turn.
+******************************************************************************/
+static Cube test_apply(Cube cube, const std::vector<int>& moves)
+{
+    for (int move : moves)
+    {
+        cube = cube.perform_move(move);
+    }
+    return cube;
+}
+
+/******************************************************************************
+* Function:  test_optimal_search
+*
+* Purpose:   Depth first search used by test_optimal_length.
+*
+* Params:    cube      - The cube reached so far.
+*            depth     - The number of moves left.
+*            last_face - The face of the last move, or -1 at the root.
+*            solved    - The key of the solved cube.
+*
+* Returns:   True if the cube can be solved in exactly depth moves.
+*
+* Operation: Tries every move which does not turn the face last turned.
+******************************************************************************/
+static bool test_optimal_search(Cube cube, int depth, int last_face,
+                                const CubeKey& solved)
+{
+    if (depth == 0)
+    {
+        return cube.key() == solved;
+    }
+
+    for (int move = 0; move < NUM_MOVES; ++move)
+    {
+        if (move / 3 != last_face &&
+            test_optimal_search(cube.perform_move(move), depth - 1, move / 3,
+                                solved))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function:  test_optimal_length
+*
+* Purpose:   Finds the length of an optimal solution to a cube by brute force.
+*
+* Params:    cube - The cube to solve, which must be close to solved.
+*
+* Returns:   The number of moves in an optimal solution.
+*
+* Operation: Iterative deepening over every sequence of moves.
+******************************************************************************/
+static int test_optimal_length(Cube cube)
+{
+    CubeKey solved = Cube().key();
+    int depth = 0;
+    while (!test_optimal_search(cube, depth, -1, solved))
+    {
+        ++depth;
+    }
+    return depth;
+}
+
+/******************************************************************************
+* Function:  test_scramble
+*
+* Purpose:   Makes a random scramble.
+*
+* Params:    rng    - The random number generator to use.
+*            length - The number of moves.
+*
+* Returns:   The moves of the scramble.
+*
+* Operation: Picks each move at random.
+******************************************************************************/
+static std::vector<int> test_scramble(std::mt19937& rng, int length)
+{
+    std::vector<int> moves;
+    for (int ii = 0; ii < length; ++ii)
+    {
+        moves.push_back(rng() % NUM_MOVES);
+    }
+    return moves;
+}
+
+/******************************************************************************
+* Function:  test_conjugate
+*
+* Purpose:   Conjugates a cube by a symmetry, and optionally inverts it.
+*
+* Params:    cube   - The cube.
+*            sym    - The symmetry.
+*            invert - True to invert the cube first.
+*
+* Returns:   The conjugated cube.
+*
+* Operation: Works from the symmetry cube and its inverse as computed by the
+*            Cube class, rather than from the tables made by
+*            cube_create_symmetries.
+******************************************************************************/
+static Cube test_conjugate(Cube cube, int sym, bool invert)
+{
+    Cube sym_cube = cube_sym_cubes[sym];
+    return sym_cube.inverse().multiply(invert ? cube.inverse() : cube)
+                   .multiply(sym_cube);
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Checks the symmetries, the canonical form and the translation of
+*            solutions on long random scrambles, and then the cache on short
+*            ones.
+******************************************************************************/
+int main()
+{
+    cube_create_symmetries();
+    CubeKey solved = Cube().key();
+    int failures = 0;
+
+    // The symmetries must be distinct.
+    std::set<CubeKey> sym_keys;
+    for (Cube& sym_cube : cube_sym_cubes)
+    {
+        sym_keys.insert(sym_cube.key());
+    }
+    if (sym_keys.size() != NUM_SYMMETRIES)
+    {
+        printf("FAIL: only %zu distinct symmetries\n", sym_keys.size());
+        ++failures;
+    }
+
+    std::mt19937 rng(TEST_SEED);
+    for (int test = 0; test < TEST_NUM_SCRAMBLES; ++test)
+    {
+        std::vector<int> scramble = test_scramble(rng, TEST_SCRAMBLE_LENGTH);
+        Cube cube = test_apply(Cube(), scramble);
+
+        Cube canonical;
+        int transform = cube_canonical(cube, canonical);
+
+        // The canonical cube must be the least of all the conjugates.
+        CubeKey least = canonical.key();
+        for (int sym = 0; sym < NUM_SYMMETRIES; ++sym)
+        {
+            for (int invert = 0; invert < 2; ++invert)
+            {
+                CubeKey key = test_conjugate(cube, sym, invert).key();
+                if (key < least)
+                {
+                    least = key;
+                }
+            }
+        }
+        if (!(least == canonical.key()) ||
+            !(test_conjugate(cube, transform / 2, transform % 2).key() ==
+              canonical.key()))
+        {
+            printf("FAIL: scramble %d is not reduced to the least conjugate\n",
+                   test);
+            ++failures;
+            continue;
+        }
+
+        // The inverse of the scramble solves the cube, so its conjugate must
+        // solve the canonical cube, and translate back into a solution.
+        std::vector<int> solution;
+        for (int ii = (int)scramble.size() - 1; ii >= 0; --ii)
+        {
+            solution.push_back(inverse_move(scramble[ii]));
+        }
+        std::vector<int> canonical_solution;
+        const std::vector<int>& source = (transform % 2) ? scramble : solution;
+        for (int move : source)
+        {
+            canonical_solution.push_back(
+                cube_sym_move[cube_sym_inverse[transform / 2]][move]);
+        }
+        if (!(test_apply(canonical, canonical_solution).key() == solved))
+        {
+            printf("FAIL: conjugated solution of scramble %d does not solve "
+                   "the canonical cube\n", test);
+            ++failures;
+            continue;
+        }
+        std::vector<int> back =
+            cube_uncanonical_solution(canonical_solution, transform);
+        if (!(test_apply(cube, back).key() == solved))
+        {
+            printf("FAIL: solution of scramble %d is not translated back\n",
+                   test);
+            ++failures;
+        }
+    }
+
+    // Every conjugate of a short scramble must get an optimal solution from
+    // the cache, all but the first from the same entry.
+    CubeCache cache(1000, 4, 0);
+    for (int test = 0; test < TEST_NUM_SHORT; ++test)
+    {
+        Cube cube = test_apply(Cube(), test_scramble(rng, TEST_SHORT_LENGTH));
+        int optimal = test_optimal_length(cube);
+        int sym = rng() % NUM_SYMMETRIES;
+
+        Cube variants[3] = {cube, test_conjugate(cube, sym, false),
+                            test_conjugate(cube, sym, true)};
+        for (Cube& variant : variants)
+        {
+            std::vector<int> solution = cache.solve(variant);
+            if (!(test_apply(variant, solution).key() == solved) ||
+                (int)solution.size() != optimal)
+            {
+                printf("FAIL: cache solved short scramble %d in %zu moves, "
+                       "optimal is %d\n", test, solution.size(), optimal);
+                ++failures;
+            }
+        }
+    }
+    if (cache.misses() > TEST_NUM_SHORT ||
+        cache.hits() + cache.misses() != 3 * TEST_NUM_SHORT)
+    {
+        printf("FAIL: %llu hits and %llu misses\n",
+               (unsigned long long)cache.hits(),
+               (unsigned long long)cache.misses());
+        ++failures;
+    }
+
+    printf("testsym: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+/******************************************************************************
+* File:    testtext.cpp
+*
+* Purpose: Checks the reading and writing of scrambles.
+*
+*          Strings of moves must survive being written and read back, and
+*          cube_parse_coords must give the same coordinates as building the
+*          cube move by move. Facelet strings are written here from random
+*          solvable cubes, and must be read back as the same cube, while
+*          every kind of unsolvable or malformed facelet string must be
+*          rejected.
+*
+*          Usage: testtext
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cube.h>
+#include <cubetext.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED          5
+#define TEST_NUM_CUBES     2000
+#define TEST_MAX_MOVES     30
+
+/******************************************************************************
+* Facelet definitions, as in cubetext.cpp
+*
+* The facelets of each corner and edge position, and the colours of each
+* corner and edge piece, as indexes into test_faces.
+******************************************************************************/
+static const char test_faces[] = "URFDLB";
+
+static const int test_corner_facelets[8][3] =
+{
+    { 8,  9, 20}, { 6, 18, 38}, { 0, 36, 47}, { 2, 45, 11},
+    {29, 26, 15}, {27, 44, 24}, {33, 53, 42}, {35, 17, 51}
+};
+
+static const int test_corner_colours[8][3] =
+{
+    {0, 1, 2}, {0, 2, 4}, {0, 4, 5}, {0, 5, 1},
+    {3, 2, 1}, {3, 4, 2}, {3, 5, 4}, {3, 1, 5}
+};
+
+static const int test_edge_facelets[12][2] =
+{
+    { 7, 19}, { 3, 37}, { 1, 46}, { 5, 10},
+    {28, 25}, {30, 43}, {34, 52}, {32, 16},
+    {23, 12}, {21, 41}, {50, 39}, {48, 14}
+};
+
+static const int test_edge_colours[12][2] =
+{
+    {0, 2}, {0, 4}, {0, 5}, {0, 1}, {3, 2}, {3, 4},
+    {3, 5}, {3, 1}, {2, 1}, {2, 4}, {5, 4}, {5, 1}
+};
+
+/******************************************************************************
+* A cube described by its pieces, which the facelet string is written from
+******************************************************************************/
+struct TestPieces
+{
+    std::vector<int> corner_perm, corner_orient;
+    std::vector<int> edge_perm, edge_orient;
+};
+
+/******************************************************************************
+* Function:  test_parity
+*
+* Purpose:   Works out the parity of a permutation.
+*
+* Params:    perm - The permutation.
+*
+* Returns:   0 if it is even, and 1 if it is odd.
+*
+* Operation: Counts the inversions.
+******************************************************************************/
+static int test_parity(const std::vector<int>& perm)
+{
+    int inversions = 0;
+    for (size_t ii = 0; ii < perm.size(); ++ii)
+    {
+        for (size_t jj = ii + 1; jj < perm.size(); ++jj)
+        {
+            inversions += (perm[ii] > perm[jj]);
+        }
+    }
+    return inversions % 2;
+}
+
+/******************************************************************************
+* Function:  test_random_pieces
+*
+* Purpose:   Makes a random solvable cube.
+*
+* Params:    rng - The random number generator to use.
+*
+* Returns:   The pieces of the cube.
+*
+* Operation: Shuffles the corners and edges, swapping two edges if the
+*            parities of the permutations differ, and twists and flips all
+*            but the last corner and edge at random, with the last making
+*            the totals whole turns.
+******************************************************************************/
+static TestPieces test_random_pieces(std::mt19937& rng)
+{
+    TestPieces pieces;
+    for (int ii = 0; ii < 8; ++ii)
+    {
+        pieces.corner_perm.push_back(ii);
+    }
+    for (int ii = 0; ii < 12; ++ii)
+    {
+        pieces.edge_perm.push_back(ii);
+    }
+    std::shuffle(pieces.corner_perm.begin(), pieces.corner_perm.end(), rng);
+    std::shuffle(pieces.edge_perm.begin(), pieces.edge_perm.end(), rng);
+    if (test_parity(pieces.corner_perm) != test_parity(pieces.edge_perm))
+    {
+        std::swap(pieces.edge_perm[0], pieces.edge_perm[1]);
+    }
+
+    int twist = 0, flip = 0;
+    for (int ii = 0; ii < 7; ++ii)
+    {
+        pieces.corner_orient.push_back(rng() % 3);
+        twist += pieces.corner_orient.back();
+    }
+    pieces.corner_orient.push_back((3 - twist % 3) % 3);
+    for (int ii = 0; ii < 11; ++ii)
+    {
+        pieces.edge_orient.push_back(rng() % 2);
+        flip += pieces.edge_orient.back();
+    }
+    pieces.edge_orient.push_back(flip % 2);
+    return pieces;
+}
+
+/******************************************************************************
+* Function:  test_facelets
+*
+* Purpose:   Writes the facelet string of a cube.
+*
+* Params:    pieces - The pieces of the cube.
+*
+* Returns:   The facelet string.
+*
+* Operation: Colours the centres, and then each facelet of each piece, with
+*            the first colour of a piece on the facelet given by its twist or
+*            flip.
+******************************************************************************/
+static std::string test_facelets(const TestPieces& pieces)
+{
+    std::string text(NUM_FACELETS, ' ');
+    for (int ii = 0; ii < NUM_FACELETS; ++ii)
+    {
+        text[ii] = test_faces[ii / 9];
+    }
+    for (int pos = 0; pos < 8; ++pos)
+    {
+        for (int ii = 0; ii < 3; ++ii)
+        {
+            int facelet = test_corner_facelets[pos]
+                                  [(ii + pieces.corner_orient[pos]) % 3];
+            text[facelet] = test_faces[test_corner_colours
+                                           [pieces.corner_perm[pos]][ii]];
+        }
+    }
+    for (int pos = 0; pos < 12; ++pos)
+    {
+        for (int ii = 0; ii < 2; ++ii)
+        {
+            int facelet = test_edge_facelets[pos]
+                                [(ii + pieces.edge_orient[pos]) % 2];
+            text[facelet] = test_faces[test_edge_colours
+                                           [pieces.edge_perm[pos]][ii]];
+        }
+    }
+    return text;
+}
+
+/******************************************************************************
+* Function:  test_rejected
+*
+* Purpose:   Checks that a facelet string is rejected.
+*
+* Params:    text - The facelet string.
+*
+* Returns:   1 if it was accepted, and 0 otherwise.
+*
+* Operation: Tries to read it.
+******************************************************************************/
+static int test_rejected(const std::string& text)
+{
+    Cube cube;
+    return cube_parse_facelets(text.data(), text.size(), cube) ? 1 : 0;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: For each random cube and random string of moves, makes each of
+*            the checks described at the top of this file.
+******************************************************************************/
+int main()
+{
+    std::mt19937 rng(TEST_SEED);
+    int failures = 0;
+
+    for (int test = 0; test < TEST_NUM_CUBES; ++test)
+    {
+        // Strings of moves.
+        std::vector<int> moves;
+        Cube moved;
+        for (int ii = rng() % (TEST_MAX_MOVES + 1); ii > 0; --ii)
+        {
+            moves.push_back(rng() % NUM_MOVES);
+            moved = moved.perform_move(moves.back());
+        }
+
+        std::string text;
+        cube_format_moves(moves, text);
+        std::vector<int> parsed;
+        CubeCoords coords;
+        CubeCoords expected = moved.coords();
+        if (!cube_parse_moves(text.data(), text.size(), parsed) ||
+            parsed != moves ||
+            !cube_parse_coords(text.data(), text.size(), coords) ||
+            coords.co != expected.co || coords.eo != expected.eo ||
+            coords.cp != expected.cp ||
+            coords.ud_sorted != expected.ud_sorted ||
+            coords.rl_sorted != expected.rl_sorted ||
+            coords.fb_sorted != expected.fb_sorted)
+        {
+            printf("FAIL: moves \"%s\" do not read back\n", text.c_str());
+            ++failures;
+        }
+
+        // Facelet strings of solvable cubes.
+        TestPieces pieces = test_random_pieces(rng);
+        Cube cube(pieces.corner_perm, pieces.corner_orient,
+                  pieces.edge_perm, pieces.edge_orient);
+        std::string facelets = test_facelets(pieces);
+        Cube read;
+        if (!cube_is_facelets(facelets.data(), facelets.size()) ||
+            !cube_parse_facelets(facelets.data(), facelets.size(), read) ||
+            !(read.key() == cube.key()))
+        {
+            printf("FAIL: facelets %s do not read back\n", facelets.c_str());
+            ++failures;
+            continue;
+        }
+
+        // A twisted corner, a flipped edge, two swapped edges, a wrong centre,
+        // and a missing facelet make it unsolvable or malformed.
+        int corner = rng() % 8;
+        int edge = rng() % 12;
+        int other_edge = (edge + 1 + rng() % 11) % 12;
+        std::string bad = facelets;
+        char first = bad[test_corner_facelets[corner][0]];
+        bad[test_corner_facelets[corner][0]] =
+                                        bad[test_corner_facelets[corner][1]];
+        bad[test_corner_facelets[corner][1]] =
+                                        bad[test_corner_facelets[corner][2]];
+        bad[test_corner_facelets[corner][2]] = first;
+        int rejected_failures = test_rejected(bad);
+
+        bad = facelets;
+        std::swap(bad[test_edge_facelets[edge][0]],
+                  bad[test_edge_facelets[edge][1]]);
+        rejected_failures += test_rejected(bad);
+
+        bad = facelets;
+        std::swap(bad[test_edge_facelets[edge][0]],
+                  bad[test_edge_facelets[other_edge][0]]);
+        std::swap(bad[test_edge_facelets[edge][1]],
+                  bad[test_edge_facelets[other_edge][1]]);
+        rejected_failures += test_rejected(bad);
+
+        bad = facelets;
+        bad[4] = bad[13];
+        rejected_failures += test_rejected(bad);
+
+        rejected_failures += test_rejected(facelets.substr(1));
+
+        if (rejected_failures != 0)
+        {
+            printf("FAIL: %d bad variant(s) of %s accepted\n",
+                   rejected_failures, facelets.c_str());
+            ++failures;
+        }
+    }
+
+    printf("testtext: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,442 @@
+/******************************************************************************
+* File:    testtrace.cpp
+*
+* Purpose: Checks the CubeTrace ring buffer and its JSON output.
+*
+*          More events are recorded than the buffer holds, and the buffer
+*          must then hold only the newest, report the rest as dropped, and
+*          write them out oldest first. The output of a small buffer and of
+*          the trace of a real solve must each be well-formed JSON, and the
+*          solve must record the depth of each phase 2 search it makes.
+*
+*          Usage: testtrace
+*
+*          The exit status is 0 if every check passes, and 1 otherwise.
+******************************************************************************/
+
+/******************************************************************************
+* Dependencies
+******************************************************************************/
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cube.h>
+#include <cubesolver.h>
+#include <cubetrace.h>
+
+/******************************************************************************
+* Constants
+******************************************************************************/
+#define TEST_SEED            19
+#define TEST_LOG2_EVENTS     3
+#define TEST_NUM_EVENTS      20
+#define TEST_SOLVE_LOG2      16
+#define TEST_SCRAMBLE_LENGTH 9
+#define TEST_PATH            "testtrace.json"
+
+/******************************************************************************
+* Function:  test_read_file
+*
+* Purpose:   Reads a whole file into a string.
+*
+* Params:    path - The file to read.
+*            text - Output parameter holding the contents of the file.
+*
+* Returns:   True if the file was read, and false otherwise.
+*
+* Operation: Reads the file in blocks until the end.
+******************************************************************************/
+static bool test_read_file(const char* path, std::string& text)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    char buffer[4096];
+    size_t length;
+    text.clear();
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        text.append(buffer, length);
+    }
+    fclose(file);
+    return true;
+}
+
+/******************************************************************************
+* Function:  test_skip_space
+*
+* Purpose:   Skips any white space in JSON text.
+*
+* Params:    text - The text.
+*            pos  - The position to start from, which is moved past the
+*                   white space.
+*
+* Returns:   Nothing.
+*
+* Operation: Steps over spaces, tabs, carriage returns and newlines.
+******************************************************************************/
+static void test_skip_space(const std::string& text, size_t& pos)
+{
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' ||
+                                 text[pos] == '\r' || text[pos] == '\n'))
+    {
+        ++pos;
+    }
+}
+
+/******************************************************************************
+* Function:  test_parse_value
+*
+* Purpose:   Checks that JSON text holds a well-formed value.
+*
+* Params:    text - The text.
+*            pos  - The position of the value, which is moved past it.
+*
+* Returns:   True if the value is well-formed, and false otherwise.
+*
+* Operation: A recursive descent parser for objects, arrays, strings,
+*            numbers and the literals, following the JSON grammar, which
+*            keeps nothing of what it parses.
+******************************************************************************/
+static bool test_parse_value(const std::string& text, size_t& pos)
+{
+    test_skip_space(text, pos);
+    if (pos >= text.size())
+    {
+        return false;
+    }
+
+    char first = text[pos];
+    if (first == '{' || first == '[')
+    {
+        char last = (first == '{') ? '}' : ']';
+        ++pos;
+        test_skip_space(text, pos);
+        if (pos < text.size() && text[pos] == last)
+        {
+            ++pos;
+            return true;
+        }
+
+        while (true)
+        {
+            if (first == '{')
+            {
+                test_skip_space(text, pos);
+                if (pos >= text.size() || text[pos] != '"' ||
+                    !test_parse_value(text, pos))
+                {
+                    return false;
+                }
+                test_skip_space(text, pos);
+                if (pos >= text.size() || text[pos++] != ':')
+                {
+                    return false;
+                }
+            }
+            if (!test_parse_value(text, pos))
+            {
+                return false;
+            }
+            test_skip_space(text, pos);
+            if (pos >= text.size())
+            {
+                return false;
+            }
+            if (text[pos] == last)
+            {
+                ++pos;
+                return true;
+            }
+            if (text[pos++] != ',')
+            {
+                return false;
+            }
+        }
+    }
+
+    if (first == '"')
+    {
+        for (++pos; pos < text.size(); ++pos)
+        {
+            if (text[pos] == '"')
+            {
+                ++pos;
+                return true;
+            }
+            if (text[pos] == '\\')
+            {
+                ++pos;
+            }
+            else if ((unsigned char)text[pos] < 0x20)
+            {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    if (first == '-' || isdigit((unsigned char)first))
+    {
+        pos += (first == '-');
+        size_t digits = pos;
+        while (pos < text.size() && isdigit((unsigned char)text[pos]))
+        {
+            ++pos;
+        }
+        if (pos == digits || (text[digits] == '0' && pos > digits + 1))
+        {
+            return false;
+        }
+        if (pos < text.size() && text[pos] == '.')
+        {
+            size_t fraction = ++pos;
+            while (pos < text.size() && isdigit((unsigned char)text[pos]))
+            {
+                ++pos;
+            }
+            if (pos == fraction)
+            {
+                return false;
+            }
+        }
+        if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E'))
+        {
+            ++pos;
+            if (pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+            {
+                ++pos;
+            }
+            size_t exponent = pos;
+            while (pos < text.size() && isdigit((unsigned char)text[pos]))
+            {
+                ++pos;
+            }
+            if (pos == exponent)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (const char* literal : {"true", "false", "null"})
+    {
+        if (text.compare(pos, strlen(literal), literal) == 0)
+        {
+            pos += strlen(literal);
+            return true;
+        }
+    }
+    return false;
+}
+
+/******************************************************************************
+* Function:  test_parse_json
+*
+* Purpose:   Checks that JSON text is well-formed.
+*
+* Params:    text - The text.
+*
+* Returns:   True if the text is a single well-formed value, and false
+*            otherwise.
+*
+* Operation: Parses one value, and checks that only white space follows.
+******************************************************************************/
+static bool test_parse_json(const std::string& text)
+{
+    size_t pos = 0;
+    if (!test_parse_value(text, pos))
+    {
+        return false;
+    }
+    test_skip_space(text, pos);
+    return pos == text.size();
+}
+
+/******************************************************************************
+* Function:  test_arg_values
+*
+* Purpose:   Finds the values of an argument of the events in a trace.
+*
+* Params:    text - The JSON text of the trace.
+*            name - The name of the events.
+*            arg  - The name of the argument.
+*
+* Returns:   The value of the argument of each event with the name, in the
+*            order they appear.
+*
+* Operation: Searches for each event name, and reads the number after the
+*            argument name which follows it, as write_json lays them out.
+******************************************************************************/
+static std::vector<int> test_arg_values(const std::string& text,
+                                        const char* name, const char* arg)
+{
+    std::vector<int> values;
+    std::string name_key = std::string("\"name\":\"") + name + "\"";
+    std::string arg_key = std::string("\"") + arg + "\":";
+
+    for (size_t pos = text.find(name_key); pos != std::string::npos;
+         pos = text.find(name_key, pos + 1))
+    {
+        size_t end = text.find('}', pos);
+        size_t found = text.find(arg_key, pos);
+        if (found != std::string::npos && found < end)
+        {
+            values.push_back(atoi(text.c_str() + found + arg_key.size()));
+        }
+    }
+    return values;
+}
+
+/******************************************************************************
+* Function:  test_ring
+*
+* Purpose:   Checks the ring buffer once it has wrapped around.
+*
+* Params:    None.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Records more solution events than the buffer holds, each with
+*            its own number as the value, and checks the counts, and that
+*            the output holds exactly the newest events in order. Then
+*            clears the buffer and checks that it is empty.
+******************************************************************************/
+static int test_ring()
+{
+    int failures = 0;
+    CubeTrace trace(TEST_LOG2_EVENTS);
+    size_t capacity = (size_t)1 << TEST_LOG2_EVENTS;
+    for (int ii = 0; ii < TEST_NUM_EVENTS; ++ii)
+    {
+        trace.record(CUBE_TRACE_SOLUTION, ii);
+    }
+
+    if (trace.size() != capacity ||
+        trace.dropped() != TEST_NUM_EVENTS - capacity)
+    {
+        printf("FAIL: after %d events in a buffer of %zu, %zu are held and "
+               "%llu dropped\n", TEST_NUM_EVENTS, capacity, trace.size(),
+               (unsigned long long)trace.dropped());
+        ++failures;
+    }
+
+    std::string text;
+    if (!trace.write_json(TEST_PATH, 1) || !test_read_file(TEST_PATH, text))
+    {
+        printf("FAIL: cannot write and read back %s\n", TEST_PATH);
+        return failures + 1;
+    }
+    if (!test_parse_json(text))
+    {
+        printf("FAIL: the output of the wrapped buffer is not JSON\n");
+        ++failures;
+    }
+
+    std::vector<int> expected;
+    for (int ii = TEST_NUM_EVENTS - (int)capacity; ii < TEST_NUM_EVENTS; ++ii)
+    {
+        expected.push_back(ii);
+    }
+    if (test_arg_values(text, "solution", "length") != expected)
+    {
+        printf("FAIL: the wrapped buffer does not write the newest %zu "
+               "events in order\n", capacity);
+        ++failures;
+    }
+
+    trace.clear();
+    if (trace.size() != 0 || trace.dropped() != 0)
+    {
+        printf("FAIL: after clearing, %zu are held and %llu dropped\n",
+               trace.size(), (unsigned long long)trace.dropped());
+        ++failures;
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  test_solve
+*
+* Purpose:   Checks the trace of a real solve.
+*
+* Params:    None.
+*
+* Returns:   The number of checks which failed.
+*
+* Operation: Solves a seeded scramble with a trace large enough to hold all
+*            of its events, and checks that the output is JSON, and that it
+*            records phase 2 depths, none of them negative.
+******************************************************************************/
+static int test_solve()
+{
+    std::mt19937 rng(TEST_SEED);
+    Cube cube;
+    for (int ii = 0; ii < TEST_SCRAMBLE_LENGTH; ++ii)
+    {
+        cube = cube.perform_move(rng() % NUM_MOVES);
+    }
+
+    CubeTrace trace(TEST_SOLVE_LOG2);
+    CubeSolver solver(cube);
+    solver.set_trace(&trace);
+    solver.solve([](std::vector<int>&) {});
+
+    std::string text;
+    if (!trace.write_json(TEST_PATH, 1) || !test_read_file(TEST_PATH, text))
+    {
+        printf("FAIL: cannot write and read back %s\n", TEST_PATH);
+        return 1;
+    }
+
+    int failures = 0;
+    if (trace.dropped() != 0 || !test_parse_json(text))
+    {
+        printf("FAIL: the trace of a solve, with %llu events dropped, is "
+               "not JSON\n", (unsigned long long)trace.dropped());
+        ++failures;
+    }
+
+    std::vector<int> depths = test_arg_values(text, "phase 2 depth", "depth");
+    if (depths.empty() ||
+        *std::min_element(depths.begin(), depths.end()) < 0)
+    {
+        printf("FAIL: the trace of a solve records %zu phase 2 depths, the "
+               "shallowest %d\n", depths.size(),
+               depths.empty() ? -1 : *std::min_element(depths.begin(),
+                                                       depths.end()));
+        ++failures;
+    }
+    return failures;
+}
+
+/******************************************************************************
+* Function:  main
+*
+* Purpose:   Entry point of the test.
+*
+* Params:    None.
+*
+* Returns:   0 if every check passes, and 1 otherwise.
+*
+* Operation: Runs the checks, and removes the file they write.
+******************************************************************************/
+int main()
+{
+    int failures = test_ring();
+    failures += test_solve();
+    remove(TEST_PATH);
+
+    printf("testtrace: %d failure(s)\n", failures);
+    return (failures > 0) ? 1 : 0;
+}